@@ -0,0 +1,89 @@
+// Scaling benchmark for RpnLineBatch: evaluates the same line-per-program
+// input with 1, 2, 4, ... threads up to the hardware thread count and
+// reports lines per second and speedup over one thread.
+// Build with -DRPNCALC_BUILD_BENCHMARKS=ON and run
+// ./rpn_batch_bench [lines] [max-threads]
+// Links only the rpncore library (no Qt).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rpnlinebatch.h"
+
+namespace {
+
+// Fixed, varied programs: prices with tax and discount, unit conversions,
+// a few trig lines and some that fail, so error lines are part of the mix
+const char *const kPrograms[] = {
+    "19.99 3 * 1.23 * 0.9 *",
+    "72 32 - 5 * 9 /",
+    "1609.344 26.2 * 1000 /",
+    "3 4 dup * swap dup * + 2 1/x ^",
+    "0.5 sin 0.5 cos / 1e-3 +",
+    "1 2 3 4 5 6 7 8 + + + + + + +",
+    "2 10 ^ 1 - 7 /",
+    "100 0 /",
+    "12.5 1.08 1.08 * * 4 root",
+    "pi 2 * 6371 * 360 /",
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long long lines = 2'000'000;
+    if (argc > 1) lines = std::atoll(argv[1]);
+    if (lines <= 0) lines = 2'000'000;
+
+    std::string input;
+    constexpr std::size_t kProgramCount = sizeof(kPrograms) / sizeof(kPrograms[0]);
+    for (long long i = 0; i < lines; ++i) {
+        input += kPrograms[std::size_t(i) % kProgramCount];
+        // Vary the numbers a little so no line is parsed from a warm cache only
+        input += ' ';
+        input += std::to_string(i % 997);
+        input += " +\n";
+    }
+
+    using Clock = std::chrono::steady_clock;
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 2 && std::atoi(argv[2]) > 0) hw = unsigned(std::atoi(argv[2]));
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < hw; t *= 2) counts.push_back(t);
+    counts.push_back(hw);
+
+    std::printf("lines: %lld, input: %.1f MiB, hardware threads: %u\n", lines, input.size() / 1048576.0, hw);
+    std::printf("%-8s %12s %14s %8s\n", "threads", "ms", "lines/s", "speedup");
+
+    std::string reference;
+    double baseline = 0.0;
+    for (unsigned threads : counts) {
+        RpnLineBatch batch(threads);
+        std::string out;
+        std::string errors;
+        out.reserve(input.size());
+        // Best of three, so thread start-up and page faults do not count
+        double best = 0.0;
+        for (int round = 0; round < 3; ++round) {
+            out.clear();
+            errors.clear();
+            const auto start = Clock::now();
+            batch.run(input, out, errors);
+            const double s = std::chrono::duration<double>(Clock::now() - start).count();
+            if (round == 0 || s < best) best = s;
+        }
+        if (reference.empty()) reference = out;
+        else if (out != reference) {
+            std::fprintf(stderr, "output with %u threads differs from 1 thread\n", threads);
+            return 1;
+        }
+        if (threads == 1) baseline = best;
+        std::printf("%-8u %12.1f %14.0f %7.2fx\n", threads, best * 1e3, double(lines) / best, baseline / best);
+    }
+    return 0;
+}
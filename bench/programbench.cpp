@@ -0,0 +1,90 @@
+// Benchmark: compiled RPN program vs. one call per token.
+// Build with -DRPNCALC_BUILD_BENCHMARKS=ON and run ./rpn_program_bench [iterations]
+//
+// "per-call" resolves and applies every token separately through RpnCore
+// (parse, op lookup, depth check, undo step), which is what the engine does
+// for each key press. "compiled" compiles once and runs the bytecode, either
+// through RpnCore::run (one undo step per run) or on a bare vector.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnparse.h"
+#include "rpnprogram.h"
+
+namespace {
+
+// Consumes the value below it, so the stack stays one deep
+constexpr std::string_view kProgram = "3 4 + 5 * 2 / dup * 1 + sin 2 pow 7 swap - neg +";
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+void runPerCall(RpnCore &core, std::string_view source)
+{
+    const char *s = source.data();
+    const char *end = s + source.size();
+    while (s != end) {
+        while (s != end && isSpace(*s)) ++s;
+        const char *start = s;
+        while (s != end && !isSpace(*s)) ++s;
+        if (start == s) break;
+        const std::string_view token(start, std::size_t(s - start));
+        double v = 0.0;
+        if (rpnParseNumber(token, v)) core.push(v);
+        else if (const auto op = rpnOpFromToken(token)) core.apply(*op);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long long iterations = 200'000;
+    if (argc > 1) iterations = std::atoll(argv[1]);
+    if (iterations <= 0) iterations = 200'000;
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [](Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    };
+
+    const auto program = RpnProgram::compile(kProgram);
+    if (!program) {
+        std::fprintf(stderr, "compile failed\n");
+        return 1;
+    }
+    const double tokens = double(program->size()) * double(iterations);
+
+    RpnCore perCall;
+    perCall.push(0.0);
+    auto start = Clock::now();
+    for (long long i = 0; i < iterations; ++i) runPerCall(perCall, kProgram);
+    const long long perCallNs = elapsedNs(start);
+
+    RpnCore compiled;
+    compiled.push(0.0);
+    start = Clock::now();
+    for (long long i = 0; i < iterations; ++i) compiled.run(*program);
+    const long long compiledNs = elapsedNs(start);
+
+    std::vector<double> bare{ 0.0 };
+    start = Clock::now();
+    for (long long i = 0; i < iterations; ++i) program->run(bare);
+    const long long bareNs = elapsedNs(start);
+
+    auto report = [&](const char *name, long long ns, double top) {
+        std::printf("%-18s%9.3f ms  %6.2f ns/token  top=%.17g\n", name, ns / 1e6, ns / tokens, top);
+    };
+    std::printf("program: %.*s (%zu instructions), %lld runs\n",
+                int(kProgram.size()), kProgram.data(), program->size(), iterations);
+    report("per-call", perCallNs, perCall.at(0));
+    report("compiled (core)", compiledNs, compiled.at(0));
+    report("compiled (bare)", bareNs, bare.back());
+    std::printf("speedup: %.1fx (core), %.1fx (bare)\n",
+                double(perCallNs) / double(compiledNs), double(perCallNs) / double(bareNs));
+    return 0;
+}
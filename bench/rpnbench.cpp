@@ -0,0 +1,436 @@
+// Benchmark suite for the hot paths: stack ops, undo, parsing, formatting,
+// model updates, number backends and history. Every case runs at stack depths 10, 1k, 100k
+// and 1M (history cases: history length), with fixed inputs and a fixed
+// seed, so numbers are comparable between commits.
+//
+// Build with -DRPNCALC_BUILD_BENCHMARKS=ON, then:
+//   ./rpn_bench                     table on stdout
+//   ./rpn_bench --json out.json     also write JSON ('-' = stdout, no table)
+//   ./rpn_bench --filter format     only cases whose name contains "format"
+//   ./rpn_bench --quick             depths 10 and 1k, fewer repetitions
+
+#include <QCoreApplication>
+#include <QLocale>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnformatter.h"
+#include "rpnhistorymodel.h"
+#include "rpnparse.h"
+#include "rpnsimd.h"
+#include "rpnstackmodel.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results alive so the optimizer can't drop the measured work
+volatile double g_sink = 0.0;
+
+struct Result {
+    std::string name;
+    long long depth = 0;
+    long long ops = 0;          // operations per repetition
+    double medianNs = 0.0;      // per operation
+    double minNs = 0.0;
+    int repetitions = 0;
+};
+
+struct Options {
+    std::vector<long long> depths{ 10, 1'000, 100'000, 1'000'000 };
+    int repetitions = 5;
+    std::string filter;
+    std::string jsonPath;
+};
+
+class Suite
+{
+public:
+    explicit Suite(const Options &options) : m_options(options) {}
+
+    // `setup` builds fresh state outside the timed region; `body` is timed
+    // and performs `ops` operations on it.
+    template <typename Setup, typename Body>
+    void run(const char *name, long long depth, long long ops, Setup setup, Body body)
+    {
+        if (!m_options.filter.empty() && std::string_view(name).find(m_options.filter) == std::string_view::npos)
+            return;
+
+        std::vector<double> samples;
+        // One untimed warm-up repetition
+        for (int rep = 0; rep <= m_options.repetitions; ++rep) {
+            auto state = setup();
+            const auto start = Clock::now();
+            body(*state);
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            if (rep > 0) samples.push_back(double(ns) / double(ops));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result r;
+        r.name = name;
+        r.depth = depth;
+        r.ops = ops;
+        r.medianNs = samples[samples.size() / 2];
+        r.minNs = samples.front();
+        r.repetitions = int(samples.size());
+        m_results.push_back(r);
+
+        if (m_options.jsonPath != "-") {
+            std::printf("%-26s %9lld %10lld %12.2f %12.2f\n", name, depth, ops, r.medianNs, r.minNs);
+            std::fflush(stdout);
+        }
+    }
+
+    const std::vector<Result> &results() const { return m_results; }
+
+private:
+    const Options &m_options;
+    std::vector<Result> m_results;
+};
+
+// Deterministic values spread over many magnitudes and both signs
+std::vector<double> makeValues(long long n)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> mant(1.0, 10.0);
+    std::uniform_int_distribution<int> exp(-20, 20);
+    std::vector<double> v(static_cast<std::size_t>(n));
+    for (double &x : v) x = ((rng() & 1) ? -1.0 : 1.0) * mant(rng) * std::pow(10.0, exp(rng));
+    return v;
+}
+
+// The same values as users type them ("1,234", "5*10^-3", ...)
+std::vector<std::string> makeInputs(long long n)
+{
+    std::mt19937_64 rng(7);
+    std::vector<std::string> out;
+    out.reserve(std::size_t(n));
+    char buf[64];
+    for (long long i = 0; i < n; ++i) {
+        const double m = double(rng() % 100000) / 1000.0;
+        switch (rng() % 3) {
+            case 0: std::snprintf(buf, sizeof(buf), "%.3f", m); break;
+            case 1: std::snprintf(buf, sizeof(buf), "%.3f", m); *std::strchr(buf, '.') = ','; break;
+            default: std::snprintf(buf, sizeof(buf), "%.3f*10^%d", m, int(rng() % 30) - 15); break;
+        }
+        out.emplace_back(buf);
+    }
+    return out;
+}
+
+template <typename T>
+std::function<std::unique_ptr<T>()> fresh()
+{
+    return [] { return std::make_unique<T>(); };
+}
+
+std::unique_ptr<RpnCore> coreWith(const std::vector<double> &values)
+{
+    auto core = std::make_unique<RpnCore>();
+    core->restore(values);
+    core->takeChanges();
+    return core;
+}
+
+// --- CASES ---
+
+void stackCases(Suite &suite, long long depth, const std::vector<double> &values)
+{
+    suite.run("core.push", depth, depth, fresh<RpnCore>(), [&](RpnCore &core) {
+        for (long long i = 0; i < depth; ++i) core.push(values[std::size_t(i)]);
+    });
+
+    suite.run("core.drop", depth, depth, [&] { return coreWith(values); }, [&](RpnCore &core) {
+        for (long long i = 0; i < depth; ++i) core.apply(RpnOp::Drop);
+    });
+
+    // Cost of one op on top of a deep stack (should not grow with depth)
+    constexpr long long kOps = 100'000;
+    suite.run("core.push+add", depth, kOps, [&] { return coreWith(values); }, [&](RpnCore &core) {
+        for (long long i = 0; i < kOps; ++i) {
+            core.push(1.0);
+            core.apply(RpnOp::Add);
+        }
+    });
+
+    suite.run("core.swap", depth, kOps, [&] { return coreWith(values); }, [&](RpnCore &core) {
+        for (long long i = 0; i < kOps; ++i) core.apply(RpnOp::Swap);
+    });
+
+    suite.run("core.undo+redo", depth, kOps, [&] {
+        auto core = coreWith(values);
+        for (long long i = 0; i < kOps; ++i) core->apply(RpnOp::Dup);
+        return core;
+    }, [&](RpnCore &core) {
+        for (long long i = 0; i < kOps; ++i) core.undo();
+        for (long long i = 0; i < kOps; ++i) core.redo();
+    });
+
+    suite.run("core.sum (simd)", depth, depth, [&] { return coreWith(values); }, [&](RpnCore &core) {
+        core.apply(RpnBulkOp::Sum);
+        g_sink = core.at(0);
+    });
+
+    // Same op with the statistics kept up to date (should not grow with depth)
+    suite.run("core.push+add (stats)", depth, kOps, [&] {
+        auto core = coreWith(values);
+        core->setStatsEnabled(true);
+        return core;
+    }, [&](RpnCore &core) {
+        for (long long i = 0; i < kOps; ++i) {
+            core.push(1.0);
+            core.apply(RpnOp::Add);
+        }
+        g_sink = core.stats().variance();
+    });
+
+    // Engine path: core op + model notification + reading the new top row
+    struct ModelState {
+        std::unique_ptr<RpnCore> core;
+        std::unique_ptr<RpnStackModel> model;
+    };
+    suite.run("model.push+sync+data", depth, kOps, [&] {
+        auto s = std::make_unique<ModelState>();
+        s->core = coreWith(values);
+        s->model = std::make_unique<RpnStackModel>(s->core.get());
+        s->model->setNumberFormat(RpnStackModel::Simple, 15);
+        return s;
+    }, [&](ModelState &s) {
+        for (long long i = 0; i < kOps; ++i) {
+            s.core->push(values[std::size_t(i % depth)]);
+            s.model->sync(s.core->takeChanges());
+            g_sink = double(s.model->data(s.model->index(0), RpnStackModel::ValueRole).toString().size());
+        }
+    });
+
+    // Format switch with a screenful of rows read back; on tall stacks the
+    // rows come back as placeholders and the formatting runs on the worker
+    constexpr int kVisibleRows = 40;
+    suite.run("model.format-switch", depth, kVisibleRows, [&] {
+        auto s = std::make_unique<ModelState>();
+        s->core = coreWith(values);
+        s->model = std::make_unique<RpnStackModel>(s->core.get());
+        s->model->setNumberFormat(RpnStackModel::Simple, 15);
+        for (int row = 0; row < kVisibleRows && row < s->model->rowCount(); ++row)
+            s->model->data(s->model->index(row), RpnStackModel::ValueRole);
+        return s;
+    }, [&](ModelState &s) {
+        s.model->setNumberFormat(RpnStackModel::Engineering, 15);
+        qsizetype chars = 0;
+        for (int row = 0; row < kVisibleRows && row < s.model->rowCount(); ++row)
+            chars += s.model->data(s.model->index(row), RpnStackModel::ValueRole).toString().size();
+        g_sink = double(chars);
+    });
+}
+
+void parseCases(Suite &suite, long long depth, const std::vector<std::string> &inputs,
+                const std::vector<QString> &qinputs, const std::string &column)
+{
+    struct Empty {};
+    auto none = [] { return std::make_unique<Empty>(); };
+
+    suite.run("parse.rpnParseNumber", depth, depth, none, [&](Empty &) {
+        double v = 0.0, sum = 0.0;
+        for (const std::string &s : inputs)
+            if (rpnParseNumber(s, v)) sum += v;
+        g_sink = sum;
+    });
+
+    suite.run("parse.parseInput", depth, depth, none, [&](Empty &) {
+        double sum = 0.0;
+        bool ok = false;
+        for (const QString &s : qinputs) sum += RpnStackModel::parseInput(s, &ok);
+        g_sink = sum;
+    });
+
+    suite.run("parse.bulk", depth, depth, [] { return std::make_unique<std::vector<double>>(); },
+              [&](std::vector<double> &out) {
+        rpnParseNumbers(column, out);
+        g_sink = double(out.size());
+    });
+}
+
+void formatCases(Suite &suite, long long depth, const std::vector<double> &values)
+{
+    static const char *const kNames[] = { "format.scientific", "format.engineering", "format.simple" };
+    for (int mode = 0; mode < 3; ++mode) {
+        suite.run(kNames[mode], depth, depth, [mode] {
+            auto f = std::make_unique<RpnFormatter>(QLocale::c());
+            f->setFormat(mode, 15);
+            return f;
+        }, [&](RpnFormatter &f) {
+            qsizetype total = 0;
+            for (long long i = 0; i < depth; ++i) total += f.format(values[std::size_t(i)]).size();
+            g_sink = double(total);
+        });
+    }
+}
+
+// The same arithmetic on each number backend: x[i] op x[i + 1]
+void backendCases(Suite &suite, long long depth, const std::vector<double> &values)
+{
+    struct Empty {};
+    auto none = [] { return std::make_unique<Empty>(); };
+    const std::size_t n = values.size();
+    const long long ops = std::max<long long>(1, depth - 1);
+    suite.run("backend.double.add", depth, ops, none, [&](Empty &) {
+        for (std::size_t i = 0; i + 1 < n; ++i) g_sink = values[i] + values[i + 1];
+    });
+    suite.run("backend.double.mul", depth, ops, none, [&](Empty &) {
+        for (std::size_t i = 0; i + 1 < n; ++i) g_sink = values[i] * values[i + 1];
+    });
+    suite.run("backend.double.div", depth, ops, none, [&](Empty &) {
+        for (std::size_t i = 0; i + 1 < n; ++i) g_sink = values[i] / values[i + 1];
+    });
+    suite.run("backend.double.sqrt", depth, ops, none, [&](Empty &) {
+        for (std::size_t i = 0; i + 1 < n; ++i) g_sink = std::sqrt(std::abs(values[i]));
+    });
+
+    // Decimal inputs are the shortest decimal text of the same doubles
+    std::vector<RpnDecimal> decimals;
+    decimals.reserve(n);
+    for (double v : values) decimals.push_back(RpnDecimal::fromDouble(v));
+
+    const auto decimalCases = [&](const char *add, const char *mul, const char *div, const char *sqrt,
+                                  const RpnDecimalContext &ctx) {
+        const auto binary = [&](const char *name, auto op) {
+            suite.run(name, depth, ops, none, [&](Empty &) {
+                for (std::size_t i = 0; i + 1 < n; ++i) g_sink = op(decimals[i], decimals[i + 1], ctx).isZero();
+            });
+        };
+        binary(add, RpnDecimal::add);
+        binary(mul, RpnDecimal::mul);
+        binary(div, RpnDecimal::div);
+        suite.run(sqrt, depth, ops, none, [&](Empty &) {
+            for (std::size_t i = 0; i + 1 < n; ++i) g_sink = RpnDecimal::sqrt(decimals[i].abs(), ctx).isZero();
+        });
+    };
+    decimalCases("backend.dec128.add", "backend.dec128.mul", "backend.dec128.div", "backend.dec128.sqrt",
+                 RpnDecimalContext::decimal128());
+    decimalCases("backend.big50.add", "backend.big50.mul", "backend.big50.div", "backend.big50.sqrt",
+                 RpnDecimalContext::arbitrary(50));
+}
+
+void historyCases(Suite &suite, long long length)
+{
+    const QString line = QStringLiteral("1.2345 6.789 + -> 8.0235");
+
+    suite.run("history.add", length, length, fresh<RpnHistoryModel>(), [&](RpnHistoryModel &h) {
+        for (long long i = 0; i < length; ++i) h.add(line);
+    });
+
+    RpnHistoryEntry op;
+    op.kind = RpnHistoryEntry::Kind::Op;
+    op.op = quint8(RpnOp::Add);
+    op.operands[0] = 1.2345;
+    op.operands[1] = 6.789;
+    op.result = 8.0235;
+    suite.run("history.add (op)", length, length, fresh<RpnHistoryModel>(), [&](RpnHistoryModel &h) {
+        for (long long i = 0; i < length; ++i) h.add(op);
+    });
+
+    suite.run("history.text", length, length, [&] {
+        auto h = std::make_unique<RpnHistoryModel>();
+        for (long long i = 0; i < length; ++i) h->add(line);
+        return h;
+    }, [&](RpnHistoryModel &h) {
+        g_sink = double(h.text().size());
+    });
+}
+
+// --- OUTPUT ---
+
+void writeJson(std::FILE *out, const std::vector<Result> &results, const Options &options)
+{
+    std::fprintf(out, "{\n  \"schema\": 1,\n");
+#ifdef NDEBUG
+    std::fprintf(out, "  \"build\": \"release\",\n");
+#else
+    std::fprintf(out, "  \"build\": \"debug\",\n");
+#endif
+#ifdef __VERSION__
+    std::fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    std::fprintf(out, "  \"qt\": \"%s\",\n", qVersion());
+    std::fprintf(out, "  \"simd\": \"%s\",\n", rpnSimdPath());
+    std::fprintf(out, "  \"repetitions\": %d,\n", options.repetitions);
+    std::fprintf(out, "  \"results\": [\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        std::fprintf(out,
+                     "    { \"name\": \"%s\", \"depth\": %lld, \"ops\": %lld, "
+                     "\"median_ns_per_op\": %.3f, \"min_ns_per_op\": %.3f }%s\n",
+                     r.name.c_str(), r.depth, r.ops, r.medianNs, r.minNs,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--quick") {
+            options.depths = { 10, 1'000 };
+            options.repetitions = 3;
+        } else {
+            std::fprintf(stderr, "usage: %s [--json FILE|-] [--filter TEXT] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (options.jsonPath != "-")
+        std::printf("%-26s %9s %10s %12s %12s\n", "case", "depth", "ops", "median ns", "min ns");
+
+    Suite suite(options);
+    for (const long long depth : options.depths) {
+        const std::vector<double> values = makeValues(depth);
+        const std::vector<std::string> inputs = makeInputs(depth);
+        std::vector<QString> qinputs;
+        qinputs.reserve(inputs.size());
+        std::string column;
+        for (const std::string &s : inputs) {
+            qinputs.push_back(QString::fromStdString(s));
+            column += s;
+            column += '\n';
+        }
+
+        stackCases(suite, depth, values);
+        parseCases(suite, depth, inputs, qinputs, column);
+        formatCases(suite, depth, values);
+        backendCases(suite, depth, values);
+        historyCases(suite, depth);
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::FILE *out = options.jsonPath == "-" ? stdout : std::fopen(options.jsonPath.c_str(), "w");
+        if (!out) {
+            std::perror(options.jsonPath.c_str());
+            return 2;
+        }
+        writeJson(out, suite.results(), options);
+        if (out != stdout) std::fclose(out);
+    }
+    return 0;
+}
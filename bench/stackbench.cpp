@@ -0,0 +1,55 @@
+// Micro-benchmark for RpnCore stack storage: push and pop 1M values.
+// Build with -DRPNCALC_BUILD_BENCHMARKS=ON and run ./rpn_stack_bench [count]
+// Links only the rpncore library (no Qt).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "rpncore.h"
+
+int main(int argc, char *argv[])
+{
+    long long count = 1'000'000;
+    if (argc > 1) count = std::atoll(argv[1]);
+    if (count <= 0) count = 1'000'000;
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [](Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    };
+
+    // Undo has its own benchmark; measure the storage alone
+    RpnCore core;
+    core.setUndoEnabled(false);
+
+    auto start = Clock::now();
+    for (long long i = 0; i < count; ++i)
+        core.push(static_cast<double>(i));
+    const long long pushNs = elapsedNs(start);
+
+    start = Clock::now();
+    for (long long i = 0; i < count; ++i) {
+        core.apply(RpnOp::Dup);
+        core.apply(RpnOp::Drop);
+    }
+    const long long dupDropNs = elapsedNs(start);
+
+    double sum = 0.0;
+    start = Clock::now();
+    while (core.has(1)) {
+        sum += core.at(0);
+        core.apply(RpnOp::Drop);
+    }
+    const long long popNs = elapsedNs(start);
+
+    auto report = [&](const char *name, long long ns) {
+        std::printf("%-12s%.3f ms  %.2f ns/op\n", name, ns / 1e6, static_cast<double>(ns) / count);
+    };
+    std::printf("values: %lld\n", count);
+    report("push", pushNs);
+    report("dup+drop", dupDropNs);
+    report("pop", popNs);
+    std::printf("checksum: %.17g\n", sum);
+    return 0;
+}
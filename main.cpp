@@ -6,9 +6,14 @@
 #include <QtQuickControls2/QQuickStyle>
 
 #include "rpnengine.h"
+#include "rpnbatch.h"
 
 int main(int argc, char *argv[])
 {
+    // Headless evaluation (--eval / --batch) never creates the GUI or QML engine
+    if (RpnBatchRunner::isBatchInvocation(argc, argv))
+        return RpnBatchRunner::exec(argc, argv);
+
     QApplication app(argc, argv);
     
     // Set application icon
@@ -6,6 +6,14 @@ QtObject {
     
     property var rpnEngine: null
     property var inputHandler: null
+
+    // Keypad label / key -> op index, resolved once per label
+    property var opCache: ({})
+
+    function opFor(keyLabel) {
+        if (!(keyLabel in opCache)) opCache[keyLabel] = rpnEngine.opForKey(keyLabel);
+        return opCache[keyLabel];
+    }
     
     function execute(keyLabel, keepFocusFn) {
         if (!rpnEngine || !inputHandler) return;
@@ -29,43 +37,12 @@ QtObject {
                 doEnter(keepFocusFn);
                 break;
                 
-            case "+":
-                doOp(keepFocusFn, rpnEngine.add);
-                break;
-            case "-":
-                doOp(keepFocusFn, rpnEngine.sub);
-                break;
-            case "×":
-                doOp(keepFocusFn, rpnEngine.mul);
-                break;
-            case "/":
-                doOp(keepFocusFn, rpnEngine.div);
-                break;
-            case "xʸ":
-                doOp(keepFocusFn, rpnEngine.pow);
-                break;
-            case "ˣ√ᵧ":
-                doOp(keepFocusFn, rpnEngine.root);
-                break;
-                
-            case "±":
-                doOp(keepFocusFn, rpnEngine.neg);
-                break;
-            case "dup":
-                doOp(keepFocusFn, rpnEngine.dup);
-                break;
-            case "drop":
-                doOp(keepFocusFn, rpnEngine.drop);
-                break;
-            case "1/x":
-                doOp(keepFocusFn, rpnEngine.reciprocal);
-                break;
-            case "sin":
-                doOp(keepFocusFn, rpnEngine.sin);
-                break;
-            case "cos":
-                doOp(keepFocusFn, rpnEngine.cos);
+            default: {
+                // Everything else is an operation from the engine's registry
+                const op = opFor(keyLabel);
+                if (op >= 0) doOp(keepFocusFn, function() { rpnEngine.applyOp(op); });
                 break;
+            }
         }
     }
     
@@ -76,18 +53,24 @@ QtObject {
                     inputHandler.clear();
                 }
             } else {
-                rpnEngine.dup();
+                rpnEngine.applyOp(opFor("dup"));
             }
         });
     }
     
+    // Pending input and the op are one undo step and one view update
     function doOp(keepFocusFn, opFn) {
         keepFocusFn(function() {
-            if (inputHandler.text.trim().length > 0) {
-                if (!rpnEngine.enter(inputHandler.text)) return;
-                inputHandler.clear();
+            rpnEngine.beginTransaction();
+            try {
+                if (inputHandler.text.trim().length > 0) {
+                    if (!rpnEngine.enter(inputHandler.text)) return;
+                    inputHandler.clear();
+                }
+                opFn();
+            } finally {
+                rpnEngine.commitTransaction();
             }
-            opFn();
         });
     }
 }
@@ -10,25 +10,15 @@ QtObject {
     signal keypadFocusRequested()
     signal stackEditRequested()
     
+    property var rpnEngine: null
+
+    // Editing keys; operator keys come from the op registry
     readonly property var keyMap: ({
         "BACK": "⌫",
         "ENTER": "ENTER",
         "CLEAR": "CLEAR",
         ".": "DECIMAL",
-        ",": "DECIMAL",
-        "+": "+",
-        "-": "-",
-        "*": "×",
-        "×": "×",
-        "/": "/",
-        "^": "xʸ",
-        "n": "±",
-        "r": "ˣ√ᵧ",
-        "s": "sin",
-        "c": "cos",
-        "d": "dup",
-        "x": "drop",
-        "i": "1/x"
+        ",": "DECIMAL"
     })
     
     function handleKeyEvent(event, isEditing) {
@@ -80,7 +70,10 @@ QtObject {
         // Check if it's a digit
         if (/[0-9]/.test(raw)) return raw;
         
-        // Check mapping
-        return keyMap[lower] || null;
+        if (keyMap[lower]) return keyMap[lower];
+
+        // Operator keys resolve to the keypad label the dispatcher knows
+        if (!rpnEngine) return null;
+        return rpnEngine.opLabel(rpnEngine.opForShortcut(lower)) || null;
     }
 }
@@ -18,11 +18,15 @@ ApplicationWindow {
     RpnEngine {
         id: rpn
         onErrorOccurred: (msg) => ui.showToast(msg)
+        onMacroSaved: (key) => ui.showToast("Macro saved to " + key)
+        // Typed while a job ran, and not a number after all: back to the input line
+        onInputRejected: (text) => { if (inputHandler.text.length === 0) inputHandler.setText(text) }
     }
 
     InputHandler {
         id: inputHandler
         decimalSeparator: rpn.decimalSeparator
+        maxDigits: rpn.maxInputDigits
         onValidationFailed: (msg) => ui.showToast(msg)
     }
     
@@ -32,6 +36,7 @@ ApplicationWindow {
     
     KeyboardController {
         id: keyboardController
+        rpnEngine: rpn
         onKeyPressed: (key) => commandDispatcher.execute(key, keepFocus)
         onNavigationRequested: (delta) => moveSelectedStack(delta)
         onKeypadFocusRequested: ui.focusKeypad()
@@ -48,7 +53,10 @@ ApplicationWindow {
         inputHandler: inputHandler
     }
 
-    Component.onCompleted: rpn.loadSessionState()
+    Component.onCompleted: {
+        rpn.loadSessionState()
+        rpn.perf.watch(win)
+    }
     onClosing: rpn.saveSessionState()
     // =========================================================
     // MENU LOGIC: KDE vs OTHERS
@@ -72,14 +80,42 @@ ApplicationWindow {
             Action { text: "Simple";      checkable: true; checked: rpn.formatMode === 2;
                 ActionGroup.group: fmtGroupQQC; onTriggered: rpn.formatMode = 2 }
         }
+        Menu {
+            title: "Numbers"
+            ActionGroup { id: backendGroupQQC }
+            Action { text: "Double (15 digits)"; checkable: true; checked: rpn.backend === 0;
+                ActionGroup.group: backendGroupQQC; onTriggered: rpn.backend = 0 }
+            Action { text: "Decimal128 (34 digits)"; checkable: true; checked: rpn.backend === 1;
+                ActionGroup.group: backendGroupQQC; onTriggered: rpn.backend = 1 }
+            Action { text: "Arbitrary (" + rpn.arbitraryDigits + " digits)"; checkable: true;
+                checked: rpn.backend === 2; ActionGroup.group: backendGroupQQC; onTriggered: rpn.backend = 2 }
+        }
         Menu {
             title: "History"
             Action { text: "Clear history"; onTriggered: rpn.clearHistory() }
         }
+        Menu {
+            title: "Macros"
+            Action { text: rpn.recordingMacro ? "Cancel recording" : "Record macro";
+                onTriggered: rpn.recordingMacro ? rpn.cancelMacro() : rpn.recordMacro() }
+            MenuSeparator { }
+            Action { text: win.macroActionText("F5"); enabled: win.macroActionEnabled("F5");
+                onTriggered: win.macroKey("F5") }
+            Action { text: win.macroActionText("F6"); enabled: win.macroActionEnabled("F6");
+                onTriggered: win.macroKey("F6") }
+            Action { text: win.macroActionText("F7"); enabled: win.macroActionEnabled("F7");
+                onTriggered: win.macroKey("F7") }
+            Action { text: win.macroActionText("F8"); enabled: win.macroActionEnabled("F8");
+                onTriggered: win.macroKey("F8") }
+        }
         Menu {
             title: "Edit"
             Action { text: "Undo"; shortcut: "Ctrl+Z"; enabled: rpn.canUndo; onTriggered: rpn.undo() }
             Action { text: "Redo"; shortcut: "Ctrl+Shift+Z"; enabled: rpn.canRedo; onTriggered: rpn.redo() }
+            MenuSeparator { }
+            Action { text: "Paste numbers"; shortcut: "Ctrl+Shift+V"; onTriggered: rpn.pasteNumbers() }
+            Action { text: "Import numbers…"; onTriggered: importDialog.open() }
+            Action { text: "Formula…"; shortcut: "Ctrl+F"; onTriggered: formulaDialog.open() }
         }
         Menu {
             title: "Help"
@@ -88,6 +124,10 @@ ApplicationWindow {
             Action { text: "Instructions";
                 onTriggered: Qt.openUrlExternally("https://github.com/marek2001/RpnCalcQuick/#readme") }
             MenuSeparator { }
+            Action { text: "Performance overlay"; checkable: true; checked: rpn.perf.active;
+                enabled: rpn.perf.available; onTriggered: rpn.perf.active = !rpn.perf.active }
+            Action { text: "Dump performance data"; enabled: rpn.perf.available; onTriggered: win.dumpPerf() }
+            MenuSeparator { }
             Action { text: "About"; onTriggered: aboutDialog.open() }
         }
     }
@@ -106,15 +146,43 @@ ApplicationWindow {
                 Native.MenuItem { text: "Simple";      checkable: true; checked: rpn.formatMode === 2;
                     group: fmtGroupNative; onTriggered: rpn.formatMode = 2 }
             }
+            Native.Menu {
+                title: "Numbers"
+                Native.MenuItemGroup { id: backendGroupNative; exclusive: true }
+                Native.MenuItem { text: "Double (15 digits)"; checkable: true; checked: rpn.backend === 0;
+                    group: backendGroupNative; onTriggered: rpn.backend = 0 }
+                Native.MenuItem { text: "Decimal128 (34 digits)"; checkable: true; checked: rpn.backend === 1;
+                    group: backendGroupNative; onTriggered: rpn.backend = 1 }
+                Native.MenuItem { text: "Arbitrary (" + rpn.arbitraryDigits + " digits)"; checkable: true;
+                    checked: rpn.backend === 2; group: backendGroupNative; onTriggered: rpn.backend = 2 }
+            }
             Native.Menu {
                 title: "History"
                 Native.MenuItem { text: "Clear history"; onTriggered: rpn.clearHistory() }
             }
+            Native.Menu {
+                title: "Macros"
+                Native.MenuItem { text: rpn.recordingMacro ? "Cancel recording" : "Record macro";
+                    onTriggered: rpn.recordingMacro ? rpn.cancelMacro() : rpn.recordMacro() }
+                Native.MenuSeparator { }
+                Native.MenuItem { text: win.macroActionText("F5"); enabled: win.macroActionEnabled("F5");
+                    onTriggered: win.macroKey("F5") }
+                Native.MenuItem { text: win.macroActionText("F6"); enabled: win.macroActionEnabled("F6");
+                    onTriggered: win.macroKey("F6") }
+                Native.MenuItem { text: win.macroActionText("F7"); enabled: win.macroActionEnabled("F7");
+                    onTriggered: win.macroKey("F7") }
+                Native.MenuItem { text: win.macroActionText("F8"); enabled: win.macroActionEnabled("F8");
+                    onTriggered: win.macroKey("F8") }
+            }
             Native.Menu {
                 title: "Edit"
                 Native.MenuItem { text: "Undo"; shortcut: "Ctrl+Z"; enabled: rpn.canUndo; onTriggered: rpn.undo() }
                 Native.MenuItem { text: "Redo"; shortcut: "Ctrl+Shift+Z"; enabled: rpn.canRedo;
                     onTriggered: rpn.redo() }
+                Native.MenuSeparator { }
+                Native.MenuItem { text: "Paste numbers"; shortcut: "Ctrl+Shift+V"; onTriggered: rpn.pasteNumbers() }
+                Native.MenuItem { text: "Import numbers…"; onTriggered: importDialog.open() }
+                Native.MenuItem { text: "Formula…"; shortcut: "Ctrl+F"; onTriggered: formulaDialog.open() }
             }
             Native.Menu {
                 title: "Help"
@@ -123,11 +191,23 @@ ApplicationWindow {
                 Native.MenuItem { text: "Instructions";
                     onTriggered: Qt.openUrlExternally("https://github.com/marek2001/RpnCalcQuick/#readme") }
                 Native.MenuSeparator { }
+                Native.MenuItem { text: "Performance overlay"; checkable: true; checked: rpn.perf.active;
+                    visible: rpn.perf.available; onTriggered: rpn.perf.active = !rpn.perf.active }
+                Native.MenuItem { text: "Dump performance data"; visible: rpn.perf.available;
+                    onTriggered: win.dumpPerf() }
+                Native.MenuSeparator { visible: rpn.perf.available }
                 Native.MenuItem { text: "About"; onTriggered: aboutDialog.open() }
             }
         }
     }
 
+    Native.FileDialog {
+        id: importDialog
+        title: "Import numbers"
+        nameFilters: [ "Text files (*.txt *.csv *.tsv)", "All files (*)" ]
+        onAccepted: rpn.importFile(file)
+    }
+
     Native.MessageDialog {
         id: aboutDialog
         title: "About RPN Calculator"
@@ -135,6 +215,31 @@ ApplicationWindow {
         buttons: Native.MessageDialog.Ok
     }
 
+    // Infix entry: the result is pushed as one value (RpnEngine::evaluate)
+    Dialog {
+        id: formulaDialog
+        title: "Formula"
+        modal: true
+        anchors.centerIn: parent
+        width: Math.min(parent.width - 32, 400)
+        standardButtons: Dialog.Ok | Dialog.Cancel
+
+        onOpened: {
+            formulaField.selectAll()
+            formulaField.forceActiveFocus()
+        }
+        onAccepted: rpn.evaluate(formulaField.text)
+        onClosed: ui.forceActiveFocus()
+
+        TextField {
+            id: formulaField
+            anchors.left: parent.left
+            anchors.right: parent.right
+            placeholderText: "(3+4)*sin(pi/6)"
+            onAccepted: formulaDialog.accept()
+        }
+    }
+
 
     MainForm {
         id: ui
@@ -144,10 +249,17 @@ ApplicationWindow {
         inputText: inputHandler.text
         displayText: displayFormatter.formatNumber(inputHandler.text)
         stackModel: rpn.stackModel
-        historyText: rpn.historyText
+        historyModel: rpn.historyModel
         decimalSeparator: rpn.decimalSeparator
         canUndo: rpn.canUndo
         canRedo: rpn.canRedo
+        maxDigits: rpn.maxInputDigits
+        statsVisible: rpn.statsVisible
+        stats: rpn.stats
+        busy: rpn.busy
+        busyText: rpn.busyText
+        busyProgress: rpn.progress
+        busyCancellable: rpn.busyCancellable
 
         onInputTextChanged: {
             if (inputText !== inputHandler.text) {
@@ -161,10 +273,10 @@ ApplicationWindow {
         
         onStackRemoveRequest: (idx) => removeStackAt(idx)
         onStackMoveRequest: (delta) => moveSelectedStack(delta)
-        onStackValueSet: (row, text) => rpn.stackModel.setValueAt(row, text)
+        onStackValueSet: (row, text) => rpn.modifyStackValue(row, text)
 
-        onPushPi: rpn.pushPi()
-        onPushE: rpn.pushE()
+        onPushPi: rpn.applyOp(commandDispatcher.opFor("π"))
+        onPushE: rpn.applyOp(commandDispatcher.opFor("e"))
         onUndoRequest: rpn.undo()
         onRedoRequest: rpn.redo()
 
@@ -172,8 +284,37 @@ ApplicationWindow {
             inputHandler.clear()
             rpn.clearAll()
         }
+        // Pending input is entered first, e.g. the factor for "Scale all by X"
+        onStackOpRequest: (name) => commandDispatcher.doOp(keepFocus, rpn[name])
+        onStatPushRequest: (name) => commandDispatcher.doOp(keepFocus, () => rpn.pushStat(name))
+        onStatsToggleRequest: rpn.statsVisible = !rpn.statsVisible
+        onCancelJobRequest: rpn.cancelJob()
         onClearHistoryRequest: rpn.clearHistory()
+        onCopyHistoryRequest: rpn.copyHistory()
         stackChangeCallback: (row, text) => rpn.modifyStackValue(row, text)
+        shortcutLabel: (key) => rpn.opLabel(rpn.opForShortcut(key))
+    }
+
+    // Latency overlay (Help -> Performance overlay, RPNCALC_PERF builds only)
+    Rectangle {
+        visible: rpn.perf.active
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 6
+        width: perfText.implicitWidth + 12
+        height: perfText.implicitHeight + 12
+        radius: 4
+        color: "#d0000000"
+        z: 100
+
+        Text {
+            id: perfText
+            anchors.centerIn: parent
+            text: rpn.perf.summary
+            color: "white"
+            font.family: "monospace"
+            font.pixelSize: 10
+        }
     }
 
     // --- LOGIC ---
@@ -203,28 +344,39 @@ ApplicationWindow {
                 commandDispatcher.doEnter(keepFocus);
                 break;
             case "op":
-                if (k.value === "add") commandDispatcher.doOp(keepFocus, rpn.add);
-                else if (k.value === "sub") commandDispatcher.doOp(keepFocus, rpn.sub);
-                else if (k.value === "mul") commandDispatcher.doOp(keepFocus, rpn.mul);
-                else if (k.value === "div") commandDispatcher.doOp(keepFocus, rpn.div);
-                else if (k.value === "pow") commandDispatcher.doOp(keepFocus, rpn.pow);
-                else if (k.value === "root") commandDispatcher.doOp(keepFocus, rpn.root);
-                break;
             case "fn":
-                if (k.value === "neg") commandDispatcher.doOp(keepFocus, rpn.neg);
-                else if (k.value === "dup") commandDispatcher.doOp(keepFocus, rpn.dup);
-                else if (k.value === "drop") commandDispatcher.doOp(keepFocus, rpn.drop);
-                else if (k.value === "inv") commandDispatcher.doOp(keepFocus, rpn.reciprocal);
-                else if (k.value === "sin") commandDispatcher.doOp(keepFocus, rpn.sin);
-                else if (k.value === "cos") commandDispatcher.doOp(keepFocus, rpn.cos);
+                commandDispatcher.execute(k.label, keepFocus);
                 break;
         }
     }
 
+    // Macro slots F5-F8: while recording they save it, otherwise they play
+    // (pending input is pushed first, like for an operator)
+    function macroKey(key) {
+        if (rpn.recordingMacro) {
+            rpn.saveMacro(key)
+        } else {
+            commandDispatcher.doOp(keepFocus, function() { rpn.runMacro(key) })
+        }
+    }
+
+    function macroActionText(key) {
+        return rpn.recordingMacro ? "Save as " + key : "Run " + key
+    }
+
+    function macroActionEnabled(key) {
+        return rpn.recordingMacro || rpn.macroKeys.indexOf(key) >= 0
+    }
+
+    function dumpPerf() {
+        const file = rpn.perf.dumpJson()
+        ui.showToast(file.length > 0 ? "Saved " + file : "Could not write performance data")
+    }
+
     function removeStackAt(row) {
         if (row < 0 || row >= ui.stackCount) return
         const cur = ui.stackCurrentIndex
-        rpn.stackModel.removeAt(row)
+        rpn.removeStackAt(row)
         if (ui.stackCount === 0) ui.stackCurrentIndex = -1
         else if (cur >= row) ui.stackCurrentIndex = Math.max(0, cur - 1)
         ui.ensureStackVisible(ui.stackCurrentIndex)
@@ -234,9 +386,9 @@ ApplicationWindow {
         const i = ui.stackCurrentIndex
         if (i < 0) return
         if (delta < 0) {
-            if (rpn.stackModel.moveUp(i)) ui.stackCurrentIndex = i - 1
+            if (rpn.moveStackUp(i)) ui.stackCurrentIndex = i - 1
         } else {
-            if (rpn.stackModel.moveDown(i)) ui.stackCurrentIndex = i + 1
+            if (rpn.moveStackDown(i)) ui.stackCurrentIndex = i + 1
         }
         ui.ensureStackVisible(ui.stackCurrentIndex)
     }
@@ -298,19 +450,9 @@ ApplicationWindow {
     Shortcut { sequences: [StandardKey.Undo]; context: Qt.ApplicationShortcut; onActivated: rpn.undo() }
     Shortcut { sequences: [StandardKey.Redo]; context: Qt.ApplicationShortcut; onActivated: rpn.redo() }
 
-    // 7. Operators (+, -, *, /)
+    // 7. Operator aliases ("=" for +); the keys themselves are in 9.
     Shortcut { sequence: "="; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
         onActivated: ui.simulatePress("+") }
-    Shortcut { sequence: "+"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("+") }
-    Shortcut { sequence: "-"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("-") }
-    Shortcut { sequence: "*"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("*") }
-    Shortcut { sequence: "/"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("/") }
-    Shortcut { sequence: "^"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("^") }
 
     // Numpad words
     Shortcut { sequence: "Multiply"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
@@ -322,19 +464,31 @@ ApplicationWindow {
     Shortcut { sequence: "Subtract"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
         onActivated: ui.simulatePress("-") }
 
-    // 8. Letters / Functions
-    Shortcut { sequence: "s"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("s") }
-    Shortcut { sequence: "c"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("c") }
-    Shortcut { sequence: "n"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("n") }
-    Shortcut { sequence: "d"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("d") }
-    Shortcut { sequence: "x"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("x") }
-    Shortcut { sequence: "r"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("r") }
-    Shortcut { sequence: "i"; context: Qt.ApplicationShortcut; enabled: win.allowGlobalTyping;
-        onActivated: ui.simulatePress("i") }
-}
\ No newline at end of file
+    // 8. Macro slots
+    Repeater {
+        model: [ "F5", "F6", "F7", "F8" ]
+        delegate: Item {
+            visible: false
+            Shortcut {
+                sequence: modelData
+                context: Qt.ApplicationShortcut
+                enabled: win.allowGlobalTyping
+                onActivated: win.macroKey(modelData)
+            }
+        }
+    }
+
+    // 9. Operator and function keys from the op registry
+    Repeater {
+        model: rpn.opShortcuts()
+        delegate: Item {
+            visible: false
+            Shortcut {
+                sequence: modelData
+                context: Qt.ApplicationShortcut
+                enabled: win.allowGlobalTyping
+                onActivated: ui.simulatePress(modelData)
+            }
+        }
+    }
+}
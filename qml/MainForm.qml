@@ -14,12 +14,24 @@ Item {
 
     // ===== API =====
     property var stackModel: null
-    property string historyText: ""
+    property var historyModel: null
     property string decimalSeparator: "."
     property bool canUndo: false
     property bool canRedo: false
+    // Significant digits the number backend keeps
+    property int maxDigits: 15
+    // Stack statistics readout (display text by key, see RpnEngine::stats)
+    property bool statsVisible: false
+    property var stats: ({})
+    // Engine job in progress (progress 0..1, or < 0 while unknown)
+    property bool busy: false
+    property string busyText: ""
+    property real busyProgress: -1
+    property bool busyCancellable: false
 
     property var stackChangeCallback: null
+    // Keyboard key -> keypad label of the op bound to it, "" if none
+    property var shortcutLabel: null
     property string inputText: ""
     property string displayText: ""
 
@@ -37,7 +49,12 @@ Item {
     signal undoRequest()
     signal redoRequest()
     signal clearAllRequest()
+    signal stackOpRequest(string name)
+    signal statPushRequest(string name)
+    signal statsToggleRequest()
+    signal cancelJobRequest()
     signal clearHistoryRequest()
+    signal copyHistoryRequest()
     signal stackRemoveRequest(int index)
     signal stackMoveRequest(int delta)
     signal stackValueSet(int row, string text)
@@ -137,9 +154,74 @@ Item {
             Button { text: "e"; Layout.fillWidth: true; onClicked: root.pushE() }
             Button { text: "↶"; Layout.fillWidth: true; enabled: root.canUndo; onClicked: root.undoRequest() }
             Button { text: "↷"; Layout.fillWidth: true; enabled: root.canRedo; onClicked: root.redoRequest() }
+            Button {
+                text: "Σ"; Layout.fillWidth: true; onClicked: stackOpsMenu.popup()
+                ToolTip.visible: hovered; ToolTip.text: "Whole-stack operations"
+                Menu {
+                    id: stackOpsMenu
+                    MenuItem { text: "Negate all"; onTriggered: root.stackOpRequest("negAll") }
+                    MenuItem { text: "sin of all"; onTriggered: root.stackOpRequest("sinAll") }
+                    MenuItem { text: "cos of all"; onTriggered: root.stackOpRequest("cosAll") }
+                    MenuItem { text: "Scale all by X"; onTriggered: root.stackOpRequest("scaleAll") }
+                    MenuSeparator {}
+                    MenuItem { text: "Sum"; onTriggered: root.stackOpRequest("sumAll") }
+                    MenuItem { text: "Product"; onTriggered: root.stackOpRequest("productAll") }
+                    MenuItem { text: "Mean"; onTriggered: root.stackOpRequest("meanAll") }
+                    MenuItem { text: "Standard deviation"; onTriggered: root.stackOpRequest("stddevAll") }
+                    MenuSeparator {}
+                    MenuItem { text: "Show statistics"; checkable: true; checked: root.statsVisible; onTriggered: root.statsToggleRequest() }
+                }
+            }
             Button { text: "CLR"; Layout.fillWidth: true; onClicked: root.clearAllRequest() }
         }
 
+        // Statistics readout; clicking a value pushes it
+        Flow {
+            Layout.fillWidth: true
+            visible: root.statsVisible
+            spacing: 2
+            Repeater {
+                model: [
+                    { key: "count", label: "n" },
+                    { key: "sum", label: "Σ" },
+                    { key: "mean", label: "x̄" },
+                    { key: "min", label: "min" },
+                    { key: "max", label: "max" },
+                    { key: "variance", label: "s²" }
+                ]
+                delegate: ToolButton {
+                    required property var modelData
+                    text: modelData.label + " " + (root.stats[modelData.key] || "-")
+                    font.pointSize: 9
+                    onClicked: root.statPushRequest(modelData.key)
+                    ToolTip.visible: hovered; ToolTip.text: "Push " + modelData.key
+                }
+            }
+        }
+
+        // Engine job in progress; keys pressed meanwhile run once it is done
+        RowLayout {
+            Layout.fillWidth: true
+            visible: root.busy
+            spacing: 6
+            Label {
+                text: root.busyText
+                elide: Text.ElideRight
+                Layout.maximumWidth: root.width / 2
+            }
+            ProgressBar {
+                Layout.fillWidth: true
+                from: 0; to: 1
+                indeterminate: root.busyProgress < 0
+                value: Math.max(0, root.busyProgress)
+            }
+            ToolButton {
+                text: "Cancel"
+                visible: root.busyCancellable
+                onClicked: root.cancelJobRequest()
+            }
+        }
+
         // SplitView
         SplitView {
             id: panes
@@ -231,7 +313,7 @@ Item {
 
                                     onTextEdited: {
                                         // 1. If text is SHORTER than before (user deletes), ALWAYS allow.
-                                        // This lets you shorten result from 17 digits to 15 and then edit.
+                                        // This lets you shorten a long result to maxDigits and then edit.
                                         if (text.length < previousText.length) {
                                             previousText = text
                                             return
@@ -249,9 +331,9 @@ Item {
 
                                         const digits = contentToCheck.replace(/[^0-9]/g, "").length
 
-                                        if (digits > 15) {
+                                        if (digits > root.maxDigits) {
                                             undo()
-                                            root.showToast("Maximum precision (15 digits)")
+                                            root.showToast("Maximum precision (" + root.maxDigits + " digits)")
                                         } else {
                                             // Accept change
                                             previousText = text
@@ -262,8 +344,6 @@ Item {
                                         let success = false
                                         if (root.stackChangeCallback) {
                                             success = root.stackChangeCallback(index, text)
-                                        } else if (root.stackModel) {
-                                            success = root.stackModel.setValueAt(index, text)
                                         }
 
                                         if (success) {
@@ -316,22 +396,23 @@ Item {
                         Layout.fillWidth: true
                         Label { text: "History"; opacity: 0.85 }
                         Item { Layout.fillWidth: true }
+                        ToolButton { text: "Copy"; enabled: historyList.count > 0; onClicked: root.copyHistoryRequest() }
                         ToolButton { text: "Clear"; onClicked: root.clearHistoryRequest() }
                     }
 
-                    Flickable {
-                        id: historyFlick
+                    // Virtualized: only visible lines get delegates, newest on top
+                    ListView {
+                        id: historyList
                         Layout.fillWidth: true; Layout.fillHeight: true
                         clip: true
                         boundsBehavior: Flickable.StopAtBounds
-                        flickableDirection: Flickable.VerticalFlick
-                        contentWidth: width
-                        contentHeight: historyTextDisplay.implicitHeight
+                        model: root.historyModel
+                        reuseItems: true
 
                         property bool showHistBars: false
-                        Timer { id: histBarTimer; interval: 700; repeat: false; onTriggered: historyFlick.showHistBars = false }
-                        onContentYChanged: { historyFlick.showHistBars = true; histBarTimer.restart() }
-                        onMovementStarted: { historyFlick.showHistBars = true; histBarTimer.restart() }
+                        Timer { id: histBarTimer; interval: 700; repeat: false; onTriggered: historyList.showHistBars = false }
+                        onContentYChanged: { historyList.showHistBars = true; histBarTimer.restart() }
+                        onMovementStarted: { historyList.showHistBars = true; histBarTimer.restart() }
                         onMovementEnded: histBarTimer.restart()
 
                         ScrollBar.vertical: ScrollBar {
@@ -339,20 +420,17 @@ Item {
                             policy: ScrollBar.AsNeeded
                             hoverEnabled: true
                             z: 100; width: 10; padding: 2
-                            readonly property bool needed: historyFlick.contentHeight > historyFlick.height + 1
+                            readonly property bool needed: historyList.contentHeight > historyList.height + 1
                             visible: needed
-                            opacity: (needed && (historyFlick.showHistBars || pressed || hovered)) ? 1 : 0
+                            opacity: (needed && (historyList.showHistBars || pressed || hovered)) ? 1 : 0
                             Behavior on opacity { NumberAnimation { duration: 140 } }
                         }
-                        
 
-                        TextEdit {
-                            id: historyTextDisplay
-                            x: 0; y: 0
-                            text: root.historyText
+                        delegate: TextEdit {
+                            width: historyList.width
+                            text: model.text
                             readOnly: true
                             selectByMouse: true
-                            width: parent.width
                             wrapMode: TextEdit.Wrap
 
                             font.family: "Monospace"
@@ -370,28 +448,20 @@ Item {
                 { label:"4", type:"char", value:"4" }, { label:"5", type:"char", value:"5" }, { label:"6", type:"char", value:"6" }, { label:"×", type:"op", value:"mul" }, { label:"/", type:"op", value:"div" },
                 { label:"1", type:"char", value:"1" }, { label:"2", type:"char", value:"2" }, { label:"3", type:"char", value:"3" }, { label:"ˣ√ᵧ", type:"op", value:"root" }, { label:"xʸ", type:"op", value:"pow" },
                 { label:"0", type:"char", value:"0" }, { label: "DECIMAL", type: "char", value: "DECIMAL" }, { label:"⌫", type:"back", value:"" }, { label:"±", type:"fn", value:"neg" }, { label:"dup", type:"fn", value:"dup" },
+                { label:"tan", type:"fn", value:"tan" }, { label:"ln", type:"fn", value:"ln" }, { label:"eˣ", type:"fn", value:"exp" }, { label:"√x", type:"fn", value:"sqrt" }, { label:"n!", type:"fn", value:"fact" },
                 { label:"sin", type:"fn", value:"sin" }, { label:"cos", type:"fn", value:"cos" }, { label:"1/x", type:"fn", value:"inv" }, { label:"drop", type:"fn", value:"drop" }, { label:"ENTER", type:"enter", value:"" }
             ]
 
             function simulatePress(rawInput) {
                 let targetLabel = ""
+                let isOp = false
                 const lower = rawInput.toLowerCase ? rawInput.toLowerCase() : rawInput
                 if (rawInput === "BACK") targetLabel = "⌫"
                 else if (rawInput === "ENTER") targetLabel = "ENTER"
                 else if (rawInput === "." || rawInput === ",") targetLabel = "DECIMAL"
-                else if (rawInput === "+") targetLabel = "+"
-                else if (rawInput === "-") targetLabel = "-"
-                else if (rawInput === "*" || rawInput === "×") targetLabel = "×"
-                else if (rawInput === "/") targetLabel = "/"
-                else if (rawInput === "^") targetLabel = "xʸ"
-                else if (lower === "n") targetLabel = "±"
-                else if (lower === "r") targetLabel = "ˣ√ᵧ"
-                else if (lower === "s") targetLabel = "sin"
-                else if (lower === "c") targetLabel = "cos"
-                else if (lower === "d") targetLabel = "dup"
-                else if (lower === "x") targetLabel = "drop"
-                else if (lower === "i") targetLabel = "1/x"
                 else if (!isNaN(parseInt(rawInput))) targetLabel = rawInput
+                else if (root.shortcutLabel) { targetLabel = root.shortcutLabel(lower); isOp = true }
+                if (!targetLabel) return false
 
                 for (let i = 0; i < keypadRep.count; i++) {
                     const btn = keypadRep.itemAt(i)
@@ -406,6 +476,11 @@ Item {
                         return true
                     }
                 }
+                // Keyboard-only operations have no button
+                if (isOp) {
+                    root.keypadAction({ label: targetLabel, type: "fn", value: "" })
+                    return true
+                }
                 return false
             }
 
@@ -0,0 +1,339 @@
+#include "rpnbatch.h"
+#include "rpnlinebatch.h"
+#include "rpnparse.h"
+#include "rpnserver.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+int parseFormatName(const QString &name)
+{
+    const QString n = name.toLower();
+    if (n == QStringLiteral("scientific") || n == QStringLiteral("sci")) return RpnFormatter::Scientific;
+    if (n == QStringLiteral("engineering") || n == QStringLiteral("eng")) return RpnFormatter::Engineering;
+    if (n == QStringLiteral("simple")) return RpnFormatter::Simple;
+    return -1;
+}
+
+// --- LINE MODE ---
+
+// Input is read in blocks of this size and evaluated in parallel per block
+constexpr std::size_t kLineBlock = std::size_t(16) << 20;
+
+struct LineTotals {
+    std::size_t lines = 0;
+    std::size_t errors = 0;
+};
+
+void evaluateLines(RpnLineBatch &batch, std::string_view text, LineTotals &totals)
+{
+    std::string out;
+    std::string errors;
+    const RpnLineBatch::Result r = batch.run(text, out, errors, totals.lines + 1);
+    std::fwrite(errors.data(), 1, errors.size(), stderr);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    totals.lines += r.lines;
+    totals.errors += r.errors;
+}
+
+// Whole lines go to the batch; the part after the last line break waits
+// for the next block
+bool evaluateLineFile(RpnLineBatch &batch, std::FILE *in, LineTotals &totals)
+{
+    std::string block;
+    std::size_t n = 0;
+    do {
+        const std::size_t kept = block.size();
+        block.resize(kept + kLineBlock);
+        n = std::fread(block.data() + kept, 1, kLineBlock, in);
+        block.resize(kept + n);
+        const std::size_t cut = n > 0 ? block.rfind('\n') : block.size() - 1;
+        if (cut == std::string::npos) continue;
+        evaluateLines(batch, std::string_view(block).substr(0, cut + 1), totals);
+        block.erase(0, cut + 1);
+    } while (n > 0);
+    return !std::ferror(in);
+}
+
+int execLines(const QStringList &evals, const QStringList &files, int mode, int precision, int jobs)
+{
+    RpnLineBatch batch{ unsigned(jobs) };
+    if (mode >= 0) {
+        RpnFormatter formatter;
+        formatter.setFormat(mode, precision);
+        batch.setFormatter([formatter](double v, std::string &out) {
+            const QByteArray text = formatter.format(v).toUtf8();
+            out.append(text.constData(), std::size_t(text.size()));
+        });
+    }
+
+    LineTotals totals;
+    if (!evals.isEmpty()) {
+        const QByteArray utf8 = evals.join(QLatin1Char('\n')).toUtf8();
+        evaluateLines(batch, std::string_view(utf8.constData(), std::size_t(utf8.size())), totals);
+    }
+
+    int status = 0;
+    for (const QString &file : files) {
+        if (file == QStringLiteral("-")) {
+            if (!evaluateLineFile(batch, stdin, totals)) status = 2;
+            continue;
+        }
+        std::FILE *in = std::fopen(QFile::encodeName(file).constData(), "rb");
+        if (!in) {
+            std::fprintf(stderr, "Cannot open %s: %s\n", qPrintable(file), std::strerror(errno));
+            status = 2;
+            continue;
+        }
+        if (!evaluateLineFile(batch, in, totals)) status = 2;
+        std::fclose(in);
+    }
+    std::fflush(stdout);
+    if (status == 0 && totals.errors > 0) status = 1;
+    return status;
+}
+
+} // namespace
+
+RpnBatchRunner::RpnBatchRunner()
+{
+    // Nothing to undo from the command line
+    m_core.setUndoEnabled(false);
+}
+
+bool RpnBatchRunner::isBatchInvocation(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "-e" || arg == "--eval" || arg.starts_with("--eval=") || arg == "-b" || arg == "--batch"
+            || arg == "-l" || arg == "--lines" || arg == "--serve")
+            return true;
+    }
+    return false;
+}
+
+// --- TOKENS ---
+
+void RpnBatchRunner::feed(std::string_view chunk)
+{
+    const char *p = chunk.data();
+    const char *end = p + chunk.size();
+
+    // Finish a token that started in the previous chunk
+    if (!m_pending.empty() || m_skipping) {
+        const char *q = p;
+        while (q != end && !isSpace(*q)) ++q;
+        if (!m_skipping) {
+            m_pending.append(p, q);
+            if (m_pending.size() > kMaxTokenLength) { m_pending.clear(); m_skipping = true; }
+        }
+        if (q == end) return;
+        if (m_skipping) {
+            ++m_tokens;
+            error("", "Token too long.");
+            m_skipping = false;
+        } else {
+            execToken(m_pending);
+            m_pending.clear();
+        }
+        p = q;
+    }
+
+    while (p != end) {
+        while (p != end && isSpace(*p)) ++p;
+        const char *start = p;
+        while (p != end && !isSpace(*p)) ++p;
+        if (start == p) break;
+        if (p == end) {
+            // May continue in the next chunk
+            m_pending.assign(start, p);
+            if (m_pending.size() > kMaxTokenLength) { m_pending.clear(); m_skipping = true; }
+            break;
+        }
+        execToken(std::string_view(start, std::size_t(p - start)));
+    }
+}
+
+void RpnBatchRunner::finish()
+{
+    if (m_skipping) {
+        ++m_tokens;
+        error("", "Token too long.");
+        m_skipping = false;
+    } else if (!m_pending.empty()) {
+        execToken(m_pending);
+        m_pending.clear();
+    }
+}
+
+bool RpnBatchRunner::runFile(std::FILE *in)
+{
+    std::vector<char> buf(kChunkSize);
+    std::size_t n = 0;
+    while ((n = std::fread(buf.data(), 1, buf.size(), in)) > 0)
+        feed(std::string_view(buf.data(), n));
+    finish();
+    return !std::ferror(in);
+}
+
+// --- OPS ---
+
+void RpnBatchRunner::error(std::string_view token, const char *msg)
+{
+    ++m_errors;
+    if (token.size() > 32) token = token.substr(0, 32);
+    std::fprintf(stderr, "token %llu (%.*s): ERR: %s\n", m_tokens, int(token.size()), token.data(), msg);
+}
+
+void RpnBatchRunner::execToken(std::string_view token)
+{
+    ++m_tokens;
+
+    double v = 0.0;
+    if (rpnParseNumber(token, v)) {
+        m_core.push(v);
+        return;
+    }
+
+    const std::optional<RpnOp> op = rpnOpFromToken(token);
+    if (!op) {
+        error(token, "Invalid number.");
+        return;
+    }
+    const RpnOpResult r = m_core.apply(*op);
+    if (!r.ok()) error(token, rpnErrorText(r).c_str());
+}
+
+// --- OUTPUT ---
+
+void RpnBatchRunner::setFormat(int mode, int precision)
+{
+    m_shortest = mode < 0;
+    if (!m_shortest) m_formatter.setFormat(mode, precision);
+}
+
+void RpnBatchRunner::printStack(std::FILE *out) const
+{
+    // Top of the stack first, like row 1 in the GUI
+    char buf[64];
+    const std::vector<double> &stack = m_core.values();
+    for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
+        if (m_shortest) {
+            const auto res = std::to_chars(buf, buf + sizeof(buf), *it);
+            std::fwrite(buf, 1, std::size_t(res.ptr - buf), out);
+        } else {
+            const QByteArray text = m_formatter.format(*it).toUtf8();
+            std::fwrite(text.constData(), 1, std::size_t(text.size()), out);
+        }
+        std::fputc('\n', out);
+    }
+    std::fflush(out);
+}
+
+// --- COMMAND LINE ---
+
+int RpnBatchRunner::exec(int argc, char *argv[])
+{
+    // Core application only: no GUI, no QML engine
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("marek2001");
+    QCoreApplication::setApplicationName("RpnCalcQuick");
+    QCoreApplication::setApplicationVersion("0.9.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("RPN calculator. Headless mode evaluates whitespace-separated "
+                                     "RPN tokens and prints the final stack, top first.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption evalOpt({ "e", "eval" }, "Evaluate RPN <tokens>. May be repeated.", "tokens");
+    const QCommandLineOption batchOpt({ "b", "batch" }, "Read tokens from FILEs, or stdin when none are given.");
+    const QCommandLineOption formatOpt("format", "Output <mode>: scientific, engineering or simple. "
+                                                 "Default: shortest round-trip value.", "mode");
+    const QCommandLineOption precisionOpt("precision", "Output precision for --format (0-17).", "digits", "15");
+    const QCommandLineOption linesOpt({ "l", "lines" }, "Every line of the FILEs (or stdin), and every --eval, is a "
+                                                       "program of its own. Prints one line per program, in order, "
+                                                       "evaluated on all cores.");
+    const QCommandLineOption jobsOpt({ "j", "jobs" }, "Threads for --lines. Default: one per core.", "count", "0");
+    const QCommandLineOption serveOpt("serve", "Answer requests of scripts on a local socket until stopped "
+                                               "(see the rpnc client).");
+    const QCommandLineOption socketOpt("socket", "Socket <name> or path for --serve.", "name",
+                                       RpnServer::defaultName());
+    parser.addOption(evalOpt);
+    parser.addOption(batchOpt);
+    parser.addOption(linesOpt);
+    parser.addOption(jobsOpt);
+    parser.addOption(serveOpt);
+    parser.addOption(socketOpt);
+    parser.addOption(formatOpt);
+    parser.addOption(precisionOpt);
+    parser.addPositionalArgument("files", "Token files for --batch or --lines ('-' is stdin).", "[FILE...]");
+    parser.process(app);
+
+    RpnBatchRunner runner;
+    int mode = -1;
+    if (parser.isSet(formatOpt)) {
+        mode = parseFormatName(parser.value(formatOpt));
+        if (mode < 0) {
+            std::fprintf(stderr, "Unknown format: %s\n", qPrintable(parser.value(formatOpt)));
+            return 2;
+        }
+        runner.setFormat(mode, parser.value(precisionOpt).toInt());
+    }
+
+    if (parser.isSet(serveOpt)) {
+        RpnServer server;
+        server.setDefaultFormat(mode, parser.value(precisionOpt).toInt());
+        if (!server.listen(parser.value(socketOpt))) {
+            std::fprintf(stderr, "Cannot serve on %s: %s\n", qPrintable(parser.value(socketOpt)),
+                         qPrintable(server.errorString()));
+            return 2;
+        }
+        return app.exec();
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty() && (parser.isSet(batchOpt) || (parser.isSet(linesOpt) && !parser.isSet(evalOpt))))
+        files << QStringLiteral("-");
+    if (parser.isSet(linesOpt)) {
+        return execLines(parser.values(evalOpt), files, mode, parser.value(precisionOpt).toInt(),
+                         std::max(0, parser.value(jobsOpt).toInt()));
+    }
+
+    for (const QString &expr : parser.values(evalOpt)) {
+        const QByteArray utf8 = expr.toUtf8();
+        runner.feed(std::string_view(utf8.constData(), std::size_t(utf8.size())));
+        runner.finish();
+    }
+
+    int status = 0;
+    for (const QString &file : files) {
+        if (file == QStringLiteral("-")) {
+            if (!runner.runFile(stdin)) status = 2;
+            continue;
+        }
+        std::FILE *in = std::fopen(QFile::encodeName(file).constData(), "rb");
+        if (!in) {
+            std::fprintf(stderr, "Cannot open %s: %s\n", qPrintable(file), std::strerror(errno));
+            status = 2;
+            continue;
+        }
+        if (!runner.runFile(in)) status = 2;
+        std::fclose(in);
+    }
+
+    runner.printStack(stdout);
+    if (status == 0 && runner.errorCount() > 0) status = 1;
+    return status;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnformatter.h"
+
+// Headless RPN evaluation: `appRpnCalcQuick --eval "3 4 +"` or
+// `appRpnCalcQuick --batch [FILE...]`. Reads whitespace-separated tokens,
+// streams input in fixed-size chunks (constant memory besides the stack)
+// and runs the tokens through the same RpnCore as the GUI (undo disabled).
+// `--lines` treats every line as a program of its own and evaluates them
+// in parallel (RpnLineBatch).
+class RpnBatchRunner
+{
+public:
+    RpnBatchRunner();
+
+    // True when argv asks for headless mode (checked before any QApplication exists)
+    static bool isBatchInvocation(int argc, char *argv[]);
+    // Command-line entry point for headless mode, returns the exit code
+    static int exec(int argc, char *argv[]);
+
+    // Tokens may be split across calls; finish() flushes the last one
+    void feed(std::string_view chunk);
+    void finish();
+    bool runFile(std::FILE *in);
+
+    // mode < 0 prints shortest round-trip values instead of RpnFormatter output
+    void setFormat(int mode, int precision);
+    void printStack(std::FILE *out) const;
+
+    const std::vector<double> &stack() const { return m_core.values(); }
+    int errorCount() const { return m_errors; }
+
+private:
+    static constexpr std::size_t kChunkSize = 1 << 20;
+    static constexpr std::size_t kMaxTokenLength = 4096;
+
+    void execToken(std::string_view token);
+    void error(std::string_view token, const char *msg);
+
+    RpnCore m_core;
+    std::string m_pending;       // token split across feed() calls
+    bool m_skipping = false;     // inside an over-long token
+    unsigned long long m_tokens = 0;
+    int m_errors = 0;
+
+    RpnFormatter m_formatter;
+    bool m_shortest = true;
+};
@@ -0,0 +1,402 @@
+#include "rpncore.h"
+#include "rpnprogram.h"
+#include "rpnsimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+RpnOpResult fail(RpnError error, int need = 0)
+{
+    RpnOpResult r;
+    r.error = error;
+    r.need = need;
+    return r;
+}
+
+} // namespace
+
+std::string rpnErrorText(RpnError e)
+{
+    switch (e) {
+        case RpnError::None: return {};
+        case RpnError::NotEnoughArgs: return "Not enough arguments on stack.";
+        case RpnError::DivisionByZero: return "Division by zero.";
+        case RpnError::RootDegreeZero: return "Root degree cannot be 0.";
+        case RpnError::InvalidRoot: return "Invalid root result.";
+        case RpnError::ReciprocalOfZero: return "Division by zero (1/x).";
+        case RpnError::EmptyDup: return "Empty stack (dup).";
+        case RpnError::EmptyDrop: return "Empty stack (drop).";
+        case RpnError::InvalidNumber: return "Invalid number.";
+        case RpnError::Cancelled: return "Cancelled.";
+        case RpnError::InvalidLog: return "Logarithm of a number <= 0.";
+        case RpnError::InvalidFactorial:
+            return "Factorial needs a whole number from 0 to " + std::to_string(rpnkernel::kMaxFactorial) + ".";
+    }
+    return {};
+}
+
+std::string rpnErrorText(const RpnOpResult &r)
+{
+    if (r.error == RpnError::NotEnoughArgs)
+        return "Not enough arguments on stack (need " + std::to_string(r.need) + ").";
+    return rpnErrorText(r.error);
+}
+
+std::optional<RpnOp> rpnOpFromToken(std::string_view token)
+{
+    if (token.empty()) return std::nullopt;
+    for (const RpnOpInfo &info : kRpnOps)
+        for (std::string_view name : info.tokens)
+            if (name == token) return info.op;
+    return std::nullopt;
+}
+
+std::string_view rpnOpToken(RpnOp op)
+{
+    return rpnOpInfo(op).tokens[0];
+}
+
+RpnCore::RpnCore() = default;
+
+// --- OPERATIONS ---
+
+RpnOpResult RpnCore::apply(RpnOp op)
+{
+    const RpnOpInfo &info = rpnOpInfo(op);
+    RpnOpResult r;
+    if (info.kind != RpnOpKind::Stack) {
+        const int n = info.arity();
+        if (!has(std::size_t(n))) return fail(RpnError::NotEnoughArgs, n);
+        for (int i = 0; i < n; ++i) r.operands[i] = at(std::size_t(n - 1 - i));
+        if (const RpnError e = info.kernel(r.operands, r.result); e != RpnError::None) return fail(e);
+        r.operandCount = n;
+        commitDerived(op, std::size_t(n), std::span<const double>(r.operands, std::size_t(n)), r.result);
+        return r;
+    }
+
+    switch (op) {
+        case RpnOp::Dup:
+            if (!has(1)) return fail(RpnError::EmptyDup);
+            r.result = at(0);
+            commitDerived(op, 1, {}, r.result);
+            return r;
+
+        case RpnOp::Drop:
+            if (!has(1)) return fail(RpnError::EmptyDrop);
+            r.operandCount = 1;
+            r.operands[0] = at(0);
+            commitTop({r.operands[0]}, {});
+            return r;
+
+        case RpnOp::Swap:
+            if (!has(2)) return fail(RpnError::NotEnoughArgs, 2);
+            moveDown(0);
+            return r;
+
+        case RpnOp::Clear:
+            // Nothing to clear is not an error and leaves no undo step
+            if (m_stack.empty()) return r;
+            depsDrop(0);
+            record({}, m_stack, {});
+            m_stack.clear();
+            statsRebuild();
+            touch(0, 0);
+            return r;
+
+        default:
+            return r;
+    }
+}
+
+RpnOpResult RpnCore::apply(RpnBulkOp op)
+{
+    RpnOpResult r;
+    const std::size_t n = m_stack.size();
+    switch (op) {
+        case RpnBulkOp::Neg: case RpnBulkOp::Sin: case RpnBulkOp::Cos: {
+            if (n == 0) return fail(RpnError::NotEnoughArgs, 1);
+            if (m_undoEnabled) m_stepRemoved.assign(m_stack.begin(), m_stack.end());
+            double *d = m_stack.data();
+            if (op == RpnBulkOp::Neg) {
+                rpnSimdNegate(d, n);
+            } else {
+                // libm per value, so results match the single-value sin/cos
+                for (std::size_t i = 0; i < n; ++i) d[i] = (op == RpnBulkOp::Sin) ? std::sin(d[i]) : std::cos(d[i]);
+            }
+            r.operandCount = int(n);
+            statsRebuild();
+            depsDrop(0);
+            depsTake(0);
+            touch(0, n);
+            record({}, m_stepRemoved, m_stack);
+            return r;
+        }
+
+        case RpnBulkOp::Scale: {
+            if (n < 2) return fail(RpnError::NotEnoughArgs, 2);
+            if (m_undoEnabled) m_stepRemoved.assign(m_stack.begin(), m_stack.end());
+            r.result = m_stack.back();
+            m_stack.pop_back();
+            rpnSimdScale(m_stack.data(), m_stack.size(), r.result);
+            r.operandCount = int(m_stack.size());
+            statsRebuild();
+            depsDrop(0);
+            depsTake(0);
+            touch(0, m_stack.size());
+            record({}, m_stepRemoved, m_stack);
+            return r;
+        }
+
+        case RpnBulkOp::Sum: case RpnBulkOp::Product:
+        case RpnBulkOp::Mean: case RpnBulkOp::StdDev: {
+            const std::size_t need = (op == RpnBulkOp::StdDev) ? 2 : 1;
+            if (n < need) return fail(RpnError::NotEnoughArgs, int(need));
+            const double *d = m_stack.data();
+            if (op == RpnBulkOp::Product) {
+                r.result = rpnSimdProduct(d, n);
+            } else {
+                r.result = rpnSimdSum(d, n);
+                if (op != RpnBulkOp::Sum) r.result /= double(n);
+                if (op == RpnBulkOp::StdDev)
+                    r.result = std::sqrt(rpnSimdSquaredDeviation(d, n, r.result) / double(n - 1));
+            }
+            r.operandCount = int(n);
+            // Whole stack in one undo step, then a single value on top
+            depsDrop(0);
+            record({}, m_stack, std::span<const double>(&r.result, 1));
+            m_stack.clear();
+            m_stack.push_back(r.result);
+            statsRebuild();
+            depsTake(0);
+            touch(0, 1);
+            return r;
+        }
+    }
+    return r;
+}
+
+RpnOpResult RpnCore::edit(std::size_t row, double v)
+{
+    if (row >= size()) return fail(RpnError::NotEnoughArgs, int(row) + 1);
+    std::size_t updated = 0;
+    const RpnError e = editValue(row, v, [](RpnOp op, const double *in, double &out) {
+        if (op != RpnOp::Dup) return rpnOpInfo(op).kernel(in, out);
+        out = in[0];
+        return RpnError::None;
+    }, updated);
+    if (e != RpnError::None) return fail(e);
+    RpnOpResult r;
+    r.operandCount = int(updated);
+    r.result = v;
+    return r;
+}
+
+RpnRunResult RpnCore::run(const RpnProgram &program)
+{
+    // A program only reaches the top inputs() values (all of them after a clear)
+    const std::size_t window = program.usesWholeStack() ? m_stack.size()
+                                                        : std::min(program.inputs(), m_stack.size());
+    const std::size_t base = m_stack.size() - window;
+    if (m_undoEnabled) m_stepRemoved.assign(m_stack.end() - std::ptrdiff_t(window), m_stack.end());
+
+    statsDrop(base);
+    const RpnRunResult res = program.run(m_stack);
+    statsTake(base);
+    if (res.executed == 0) return res;
+
+    depsDrop(base);
+    depsTake(base);
+    touch(base, m_stack.size());
+    record({}, m_stepRemoved, std::span<const double>(m_stack).subspan(base));
+    return res;
+}
+
+// --- DECIMAL CORE ---
+
+RpnDecimalCore::RpnDecimalCore(RpnDecimalContext context) : m_context(context) {}
+
+RpnOpResult RpnDecimalCore::apply(RpnOp op)
+{
+    const RpnOpInfo &info = rpnOpInfo(op);
+    RpnOpResult r;
+    if (info.kind != RpnOpKind::Stack) {
+        const int n = info.arity();
+        if (!has(std::size_t(n))) return fail(RpnError::NotEnoughArgs, n);
+        RpnDecimal in[2];
+        for (int i = 0; i < n; ++i) in[i] = at(std::size_t(n - 1 - i));
+        RpnDecimal result;
+        if (const RpnError e = info.decimal(in, m_context, result); e != RpnError::None) return fail(e);
+        r.operandCount = n;
+        for (int i = 0; i < n; ++i) r.operands[i] = in[i].toDouble();
+        r.result = result.toDouble();
+        commitDerived(op, std::size_t(n), std::span<const RpnDecimal>(in, std::size_t(n)), result);
+        return r;
+    }
+
+    switch (op) {
+        case RpnOp::Dup:
+            if (!has(1)) return fail(RpnError::EmptyDup);
+            r.result = at(0).toDouble();
+            // A copy: the push may move the stack
+            commitDerived(op, 1, {}, RpnDecimal(at(0)));
+            return r;
+
+        case RpnOp::Drop:
+            if (!has(1)) return fail(RpnError::EmptyDrop);
+            r.operandCount = 1;
+            r.operands[0] = at(0).toDouble();
+            commitTop({at(0)}, {});
+            return r;
+
+        case RpnOp::Swap:
+            if (!has(2)) return fail(RpnError::NotEnoughArgs, 2);
+            moveDown(0);
+            return r;
+
+        case RpnOp::Clear:
+            if (m_stack.empty()) return r;
+            depsDrop(0);
+            record({}, m_stack, {});
+            m_stack.clear();
+            statsRebuild();
+            touch(0, 0);
+            return r;
+
+        default:
+            return r;
+    }
+}
+
+RpnOpResult RpnDecimalCore::edit(std::size_t row, RpnDecimal v)
+{
+    if (row >= size()) return fail(RpnError::NotEnoughArgs, int(row) + 1);
+    RpnOpResult r;
+    r.result = v.toDouble();
+    std::size_t updated = 0;
+    const RpnError e = editValue(row, std::move(v), [this](RpnOp op, const RpnDecimal *in, RpnDecimal &out) {
+        if (op != RpnOp::Dup) return rpnOpInfo(op).decimal(in, m_context, out);
+        out = in[0];
+        return RpnError::None;
+    }, updated);
+    if (e != RpnError::None) return fail(e);
+    r.operandCount = int(updated);
+    return r;
+}
+
+RpnOpResult RpnDecimalCore::apply(RpnBulkOp op)
+{
+    return applyBulk(computeBulk(op, m_job));
+}
+
+RpnDecimalCore::BulkResult RpnDecimalCore::computeBulk(RpnBulkOp op, RpnJobControl *job) const
+{
+    const RpnDecimalContext &ctx = m_context;
+    BulkResult bulk;
+    RpnOpResult &r = bulk.result;
+    const std::size_t n = m_stack.size();
+    switch (op) {
+        case RpnBulkOp::Neg: case RpnBulkOp::Sin: case RpnBulkOp::Cos: {
+            if (n == 0) return { fail(RpnError::NotEnoughArgs, 1), {} };
+            bulk.values.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                if (!jobStep(job, i, n)) return { fail(RpnError::Cancelled), {} };
+                const RpnDecimal &v = m_stack[i];
+                if (op == RpnBulkOp::Neg) bulk.values.push_back(-v);
+                else bulk.values.push_back((op == RpnBulkOp::Sin) ? RpnDecimal::sin(v, ctx) : RpnDecimal::cos(v, ctx));
+            }
+            r.operandCount = int(n);
+            return bulk;
+        }
+
+        case RpnBulkOp::Scale: {
+            if (n < 2) return { fail(RpnError::NotEnoughArgs, 2), {} };
+            const RpnDecimal &factor = m_stack.back();
+            bulk.values.reserve(n - 1);
+            for (std::size_t i = 0; i + 1 < n; ++i) {
+                if (!jobStep(job, i, n - 1)) return { fail(RpnError::Cancelled), {} };
+                bulk.values.push_back(RpnDecimal::mul(m_stack[i], factor, ctx));
+            }
+            r.result = factor.toDouble();
+            r.operandCount = int(n - 1);
+            return bulk;
+        }
+
+        case RpnBulkOp::Sum: case RpnBulkOp::Product:
+        case RpnBulkOp::Mean: case RpnBulkOp::StdDev: {
+            const std::size_t need = (op == RpnBulkOp::StdDev) ? 2 : 1;
+            if (n < need) return { fail(RpnError::NotEnoughArgs, int(need)), {} };
+            RpnDecimal value;
+            if (const RpnError e = reduce(op, value, false, job); e != RpnError::None) return { fail(e), {} };
+            r.result = value.toDouble();
+            r.operandCount = int(n);
+            bulk.values.push_back(std::move(value));
+            return bulk;
+        }
+    }
+    return bulk;
+}
+
+RpnOpResult RpnDecimalCore::applyBulk(BulkResult bulk)
+{
+    if (!bulk.result.ok()) return bulk.result;
+    // Whole stack in one undo step, old values out and new ones in
+    const std::vector<RpnDecimal> old = std::exchange(m_stack, std::move(bulk.values));
+    statsRebuild();
+    depsDrop(0);
+    depsTake(0);
+    touch(0, m_stack.size());
+    record({}, old, m_stack);
+    return bulk.result;
+}
+
+// --- STATISTICS ---
+
+RpnError RpnDecimalCore::reduce(RpnBulkOp op, RpnDecimal &out, bool squared, RpnJobControl *job) const
+{
+    const RpnDecimalContext &ctx = m_context;
+    const std::size_t n = m_stack.size();
+    // StdDev walks the stack twice
+    const std::size_t passes = (op == RpnBulkOp::StdDev) ? 2 : 1;
+    RpnDecimal value = (op == RpnBulkOp::Product) ? RpnDecimal::fromInt(1) : RpnDecimal();
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!jobStep(job, i, n * passes)) return RpnError::Cancelled;
+        const RpnDecimal &v = m_stack[i];
+        value = (op == RpnBulkOp::Product) ? RpnDecimal::mul(value, v, ctx) : RpnDecimal::add(value, v, ctx);
+    }
+    if (op == RpnBulkOp::Mean || op == RpnBulkOp::StdDev)
+        value = RpnDecimal::div(value, RpnDecimal::fromInt(std::int64_t(n)), ctx);
+    if (op == RpnBulkOp::StdDev) {
+        RpnDecimal squares;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!jobStep(job, n + i, n * passes)) return RpnError::Cancelled;
+            const RpnDecimal d = RpnDecimal::sub(m_stack[i], value, ctx);
+            squares = RpnDecimal::add(squares, RpnDecimal::mul(d, d, ctx), ctx);
+        }
+        value = RpnDecimal::div(squares, RpnDecimal::fromInt(std::int64_t(n - 1)), ctx);
+        if (!squared) value = RpnDecimal::sqrt(value, ctx);
+    }
+    out = std::move(value);
+    return RpnError::None;
+}
+
+const RpnDecimal *RpnDecimalCore::extreme(bool largest) const
+{
+    // -inf < finite < +inf; compare() orders the finite ones
+    const auto rank = [](const RpnDecimal &v) { return v.isFinite() ? 0 : v.isNegative() ? -1 : 1; };
+    const RpnDecimal *best = nullptr;
+    for (const RpnDecimal &v : m_stack) {
+        if (v.isNaN()) continue;
+        if (!best) {
+            best = &v;
+            continue;
+        }
+        const int rv = rank(v);
+        const int rb = rank(*best);
+        const int order = rv != rb ? (rv < rb ? -1 : 1) : rv == 0 ? v.compare(*best) : 0;
+        if (largest ? order > 0 : order < 0) best = &v;
+    }
+    return best;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpndecimal.h"
+#include "rpnops.h"
+#include "rpnstackcore.h"
+
+class RpnProgram;
+struct RpnRunResult;
+
+// Plain C++ calculation core: stack, operations and undo.
+// No Qt and no signals; RpnEngine / RpnStackModel are adapters that call
+// into it and publish what changed (see takeChanges()) in one batch.
+// RpnCore works on doubles, RpnDecimalCore on RpnDecimal; both take the
+// same ops (kRpnOps in rpnops.h) and report the same errors.
+
+// Operations over the whole stack (one undo step each)
+enum class RpnBulkOp : std::uint8_t {
+    Neg, Sin, Cos,          // every value in place
+    Scale,                  // top value multiplies all the others
+    Sum, Product, Mean,     // whole stack -> one value
+    StdDev                  // sample standard deviation, needs 2 values
+};
+
+struct RpnOpResult {
+    RpnError error = RpnError::None;
+    int need = 0;                 // NotEnoughArgs: required depth
+    int operandCount = 0;         // bulk ops: number of values processed
+    double operands[2] = {};      // values the op consumed, bottom first
+    double result = 0.0;
+
+    bool ok() const { return error == RpnError::None; }
+};
+
+// User-facing message, e.g. "Not enough arguments on stack (need 2)."
+std::string rpnErrorText(const RpnOpResult &r);
+std::string rpnErrorText(RpnError e);
+
+// Token names used by scripts and the headless mode ("+", "dup", "1/x", ...)
+std::optional<RpnOp> rpnOpFromToken(std::string_view token);
+// Name rpnOpFromToken() maps back to `op` (the first one listed for it)
+std::string_view rpnOpToken(RpnOp op);
+
+class RpnCore : public RpnStackCore<double>
+{
+public:
+    RpnCore();
+
+    // --- OPERATIONS (each one undo step; failed ops change nothing) ---
+    RpnOpResult apply(RpnOp op);
+    RpnOpResult apply(RpnBulkOp op);
+    // Sets the value at `row` and, with tracking on, recomputes the values
+    // derived from it (see editValue()); operandCount is how many values on
+    // the stack were recomputed
+    RpnOpResult edit(std::size_t row, double v);
+    // Runs a compiled program as one undo step (see RpnProgram::run)
+    RpnRunResult run(const RpnProgram &program);
+};
+
+// Same operations on decimal numbers, rounded to a context (decimal128 or
+// a fixed number of digits). sin/cos/pi/e are computed to full precision;
+// pow with a non-integer exponent goes through double. Whole-stack ops
+// report to the job control, and a cancelled one changes nothing.
+class RpnDecimalCore : public RpnStackCore<RpnDecimal>
+{
+public:
+    explicit RpnDecimalCore(RpnDecimalContext context = RpnDecimalContext::decimal128());
+
+    const RpnDecimalContext &context() const { return m_context; }
+    // Applies to later results; values already on the stack keep their digits
+    void setContext(const RpnDecimalContext &context) { m_context = context; }
+
+    // --- OPERATIONS (each one undo step; failed ops change nothing) ---
+    // RpnOpResult carries the operands and result converted to double
+    RpnOpResult apply(RpnOp op);
+    RpnOpResult apply(RpnBulkOp op);
+    RpnOpResult edit(std::size_t row, RpnDecimal v);
+
+    // A whole-stack op in two halves, so the slow one can run on another
+    // thread: computeBulk() only reads the stack and reports to `job`,
+    // applyBulk() then puts its values on the stack as one undo step. The
+    // stack must not change in between. apply() is the two in a row.
+    struct BulkResult {
+        RpnOpResult result;
+        std::vector<RpnDecimal> values; // the new stack
+    };
+    BulkResult computeBulk(RpnBulkOp op, RpnJobControl *job) const;
+    RpnOpResult applyBulk(BulkResult bulk);
+
+    // --- STATISTICS (full precision; the stack is left as it is) ---
+    // What apply() of Sum, Product, Mean or StdDev would push; `squared`
+    // stops StdDev before the root (the sample variance). Callers check
+    // the stack depth. Fails only when `job` is cancelled.
+    RpnError reduce(RpnBulkOp op, RpnDecimal &out, bool squared = false, RpnJobControl *job = nullptr) const;
+    // Smallest or largest value on the stack, NaN aside; nullptr if none
+    const RpnDecimal *extreme(bool largest) const;
+
+private:
+    RpnDecimalContext m_context;
+};
@@ -0,0 +1,1127 @@
+#include "rpndecimal.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <system_error>
+
+namespace {
+
+constexpr std::uint32_t kBase = 1000000000u;
+constexpr std::uint32_t kPow10[10] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+constexpr std::uint64_t kPow10U64[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+// Exponents kept well inside int32 so exponent arithmetic never overflows
+constexpr int kExponentLimit = 999999999;
+
+// --- LIMB ARENA ---
+
+// Bump allocator for the temporaries of one operation. A Scope hands back
+// everything allocated while it was alive, so chunks are reused and the
+// steady state does not allocate at all.
+class LimbArena
+{
+public:
+    struct Mark {
+        std::size_t chunk = 0;
+        std::size_t used = 0;
+    };
+
+    Mark mark() const { return { m_chunk, m_used }; }
+    void release(Mark m)
+    {
+        m_chunk = m.chunk;
+        m_used = m.used;
+    }
+
+    std::uint32_t *alloc(std::size_t n)
+    {
+        if (m_chunks.empty() || m_used + n > m_chunks[m_chunk].size) {
+            if (!m_chunks.empty()) ++m_chunk;
+            m_used = 0;
+            // Chunks past the current one are free; replace one that is too small
+            if (m_chunk < m_chunks.size() && m_chunks[m_chunk].size < n) m_chunks[m_chunk] = Chunk(n);
+            if (m_chunk == m_chunks.size()) m_chunks.emplace_back(n);
+        }
+        std::uint32_t *p = m_chunks[m_chunk].data.get() + m_used;
+        m_used += n;
+        std::memset(p, 0, n * sizeof(std::uint32_t));
+        return p;
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(LimbArena &arena) : m_arena(arena), m_mark(arena.mark()) {}
+        ~Scope() { m_arena.release(m_mark); }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        LimbArena &m_arena;
+        Mark m_mark;
+    };
+
+private:
+    static constexpr std::size_t kChunkLimbs = 16384;
+
+    struct Chunk {
+        explicit Chunk(std::size_t n)
+            : size(std::max(n, kChunkLimbs)), data(std::make_unique<std::uint32_t[]>(size)) {}
+        std::size_t size;
+        std::unique_ptr<std::uint32_t[]> data;
+    };
+
+    std::vector<Chunk> m_chunks;
+    std::size_t m_chunk = 0;
+    std::size_t m_used = 0;
+};
+
+thread_local LimbArena t_arena;
+
+// --- NATURAL NUMBERS (base 10^9, least significant limb first) ---
+
+struct Nat {
+    std::uint32_t *d = nullptr;
+    std::size_t n = 0; // no leading zero limbs once trimmed; 0 means zero
+};
+
+Nat alloc(std::size_t n)
+{
+    return { t_arena.alloc(n), n };
+}
+
+void trim(Nat &a)
+{
+    while (a.n > 0 && a.d[a.n - 1] == 0) --a.n;
+}
+
+int limbDigits(std::uint32_t x)
+{
+    int k = 1;
+    while (k < 9 && x >= kPow10[k]) ++k;
+    return k;
+}
+
+int u64Digits(std::uint64_t x)
+{
+    int k = 1;
+    while (k < 20 && x >= kPow10U64[k]) ++k;
+    return k;
+}
+
+std::int64_t digits(const Nat &a)
+{
+    return a.n == 0 ? 0 : std::int64_t(a.n - 1) * 9 + limbDigits(a.d[a.n - 1]);
+}
+
+Nat natFromU64(std::uint64_t v, std::uint32_t (&buf)[3])
+{
+    Nat a{ buf, 0 };
+    while (v > 0) {
+        buf[a.n++] = std::uint32_t(v % kBase);
+        v /= kBase;
+    }
+    return a;
+}
+
+bool natToU64(const Nat &a, std::uint64_t &out)
+{
+    if (a.n > 3) return false;
+    std::uint64_t v = 0;
+    for (std::size_t i = a.n; i-- > 0;) {
+        if (v > (std::numeric_limits<std::uint64_t>::max() - a.d[i]) / kBase) return false;
+        v = v * kBase + a.d[i];
+    }
+    out = v;
+    return true;
+}
+
+int cmp(const Nat &a, const Nat &b)
+{
+    if (a.n != b.n) return a.n < b.n ? -1 : 1;
+    for (std::size_t i = a.n; i-- > 0;)
+        if (a.d[i] != b.d[i]) return a.d[i] < b.d[i] ? -1 : 1;
+    return 0;
+}
+
+Nat add(const Nat &a, const Nat &b)
+{
+    const Nat &lo = a.n < b.n ? a : b;
+    const Nat &hi = a.n < b.n ? b : a;
+    Nat r = alloc(hi.n + 1);
+    std::uint32_t carry = 0;
+    for (std::size_t i = 0; i < hi.n; ++i) {
+        std::uint32_t s = hi.d[i] + (i < lo.n ? lo.d[i] : 0) + carry;
+        carry = s >= kBase;
+        if (carry) s -= kBase;
+        r.d[i] = s;
+    }
+    r.d[hi.n] = carry;
+    trim(r);
+    return r;
+}
+
+// a - b for a >= b
+Nat sub(const Nat &a, const Nat &b)
+{
+    Nat r = alloc(a.n);
+    std::int64_t borrow = 0;
+    for (std::size_t i = 0; i < a.n; ++i) {
+        std::int64_t s = std::int64_t(a.d[i]) - (i < b.n ? b.d[i] : 0) - borrow;
+        borrow = s < 0;
+        if (borrow) s += kBase;
+        r.d[i] = std::uint32_t(s);
+    }
+    trim(r);
+    return r;
+}
+
+Nat mul(const Nat &a, const Nat &b)
+{
+    if (a.n == 0 || b.n == 0) return {};
+    Nat r = alloc(a.n + b.n);
+    for (std::size_t i = 0; i < a.n; ++i) {
+        std::uint64_t carry = 0;
+        const std::uint64_t x = a.d[i];
+        for (std::size_t j = 0; j < b.n; ++j) {
+            const std::uint64_t t = r.d[i + j] + x * b.d[j] + carry;
+            r.d[i + j] = std::uint32_t(t % kBase);
+            carry = t / kBase;
+        }
+        r.d[i + b.n] = std::uint32_t(carry);
+    }
+    trim(r);
+    return r;
+}
+
+// a /= m (m < kBase), returns the remainder
+std::uint32_t divSmallInPlace(Nat &a, std::uint32_t m)
+{
+    std::uint64_t rem = 0;
+    for (std::size_t i = a.n; i-- > 0;) {
+        const std::uint64_t cur = rem * kBase + a.d[i];
+        a.d[i] = std::uint32_t(cur / m);
+        rem = cur % m;
+    }
+    trim(a);
+    return std::uint32_t(rem);
+}
+
+// a * 10^k
+Nat shiftUp(const Nat &a, std::int64_t k)
+{
+    if (a.n == 0 || k == 0) return a;
+    const std::size_t limbs = std::size_t(k / 9);
+    const std::uint64_t m = kPow10[k % 9];
+    Nat r = alloc(a.n + limbs + 1);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < a.n; ++i) {
+        const std::uint64_t t = a.d[i] * m + carry;
+        r.d[limbs + i] = std::uint32_t(t % kBase);
+        carry = t / kBase;
+    }
+    r.d[limbs + a.n] = std::uint32_t(carry);
+    trim(r);
+    return r;
+}
+
+// floor(a / 10^k), with one spare limb so a rounding carry fits
+Nat shiftDown(const Nat &a, std::int64_t k)
+{
+    const std::size_t limbs = std::size_t(k / 9);
+    if (limbs >= a.n) return alloc(1);
+    Nat r = alloc(a.n - limbs + 1);
+    std::memcpy(r.d, a.d + limbs, (a.n - limbs) * sizeof(std::uint32_t));
+    r.n = a.n - limbs;
+    if (k % 9) divSmallInPlace(r, kPow10[k % 9]);
+    return r;
+}
+
+int digitAt(const Nat &a, std::int64_t pos)
+{
+    const std::size_t limb = std::size_t(pos / 9);
+    if (limb >= a.n) return 0;
+    return int(a.d[limb] / kPow10[pos % 9] % 10);
+}
+
+bool nonZeroBelow(const Nat &a, std::int64_t pos)
+{
+    const std::size_t limb = std::min(std::size_t(pos / 9), a.n);
+    for (std::size_t i = 0; i < limb; ++i)
+        if (a.d[i]) return true;
+    return limb < a.n && a.d[limb] % kPow10[pos % 9] != 0;
+}
+
+std::int64_t trailingZeros(const Nat &a)
+{
+    std::size_t i = 0;
+    while (i < a.n && a.d[i] == 0) ++i;
+    if (i == a.n) return 0;
+    std::int64_t z = std::int64_t(i) * 9;
+    for (std::uint32_t x = a.d[i]; x % 10 == 0; x /= 10) ++z;
+    return z;
+}
+
+void increment(Nat &a)
+{
+    for (std::size_t i = 0;; ++i) {
+        if (i == a.n) {
+            a.d[a.n++] = 1; // the spare limb from shiftDown()
+            return;
+        }
+        if (++a.d[i] < kBase) return;
+        a.d[i] = 0;
+    }
+}
+
+// a / 10^drop rounded half to even; `sticky` = something non-zero lies below a
+Nat roundDrop(const Nat &a, std::int64_t drop, bool sticky)
+{
+    if (drop <= 0) return a;
+    if (drop > digits(a)) return alloc(1); // below half of the last kept digit
+    const int first = digitAt(a, drop - 1);
+    const bool rest = sticky || nonZeroBelow(a, drop - 1);
+    Nat q = shiftDown(a, drop);
+    const bool odd = q.n > 0 && (q.d[0] & 1u);
+    if (first > 5 || (first == 5 && (rest || odd))) increment(q);
+    return q;
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1, algorithm D
+void divmod(const Nat &a, const Nat &b, Nat &q, Nat &r)
+{
+    if (cmp(a, b) < 0) {
+        q = {};
+        r = a;
+        return;
+    }
+    if (b.n == 1) {
+        q = alloc(a.n);
+        std::memcpy(q.d, a.d, a.n * sizeof(std::uint32_t));
+        const std::uint32_t rem = divSmallInPlace(q, b.d[0]);
+        r = alloc(1);
+        r.d[0] = rem;
+        trim(r);
+        return;
+    }
+
+    const std::size_t n = b.n;
+    const std::size_t m = a.n - n;
+    const std::uint64_t norm = kBase / (std::uint64_t(b.d[n - 1]) + 1);
+
+    Nat u = alloc(a.n + 1);
+    Nat v = alloc(n);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < a.n; ++i) {
+        const std::uint64_t t = a.d[i] * norm + carry;
+        u.d[i] = std::uint32_t(t % kBase);
+        carry = t / kBase;
+    }
+    u.d[a.n] = std::uint32_t(carry);
+    carry = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::uint64_t t = b.d[i] * norm + carry;
+        v.d[i] = std::uint32_t(t % kBase);
+        carry = t / kBase;
+    }
+
+    q = alloc(m + 1);
+    const std::uint64_t vTop = v.d[n - 1];
+    const std::uint64_t vNext = v.d[n - 2];
+    for (std::size_t j = m + 1; j-- > 0;) {
+        const std::uint64_t num = std::uint64_t(u.d[j + n]) * kBase + u.d[j + n - 1];
+        std::uint64_t qhat = num / vTop;
+        std::uint64_t rhat = num % vTop;
+        while (qhat >= kBase || qhat * vNext > rhat * kBase + u.d[j + n - 2]) {
+            --qhat;
+            rhat += vTop;
+            if (rhat >= kBase) break;
+        }
+
+        // u[j .. j+n] -= qhat * v
+        std::uint64_t mulCarry = 0;
+        std::int64_t borrow = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::uint64_t p = qhat * v.d[i] + mulCarry;
+            mulCarry = p / kBase;
+            std::int64_t t = std::int64_t(u.d[i + j]) - std::int64_t(p % kBase) - borrow;
+            borrow = t < 0;
+            if (borrow) t += kBase;
+            u.d[i + j] = std::uint32_t(t);
+        }
+        std::int64_t t = std::int64_t(u.d[j + n]) - std::int64_t(mulCarry) - borrow;
+        borrow = t < 0;
+        if (borrow) t += kBase;
+        u.d[j + n] = std::uint32_t(t);
+
+        // qhat was one too large: add v back
+        if (borrow) {
+            --qhat;
+            std::uint32_t c = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                std::uint32_t s = u.d[i + j] + v.d[i] + c;
+                c = s >= kBase;
+                if (c) s -= kBase;
+                u.d[i + j] = s;
+            }
+            u.d[j + n] = (u.d[j + n] + c) % kBase;
+        }
+        q.d[j] = std::uint32_t(qhat);
+    }
+    trim(q);
+
+    r = { u.d, n };
+    trim(r);
+    divSmallInPlace(r, std::uint32_t(norm));
+}
+
+void appendDigits(std::string &out, const Nat &a)
+{
+    if (a.n == 0) {
+        out += '0';
+        return;
+    }
+    char buf[16];
+    auto res = std::to_chars(buf, buf + sizeof(buf), a.d[a.n - 1]);
+    out.append(buf, res.ptr);
+    for (std::size_t i = a.n - 1; i-- > 0;) {
+        res = std::to_chars(buf, buf + sizeof(buf), a.d[i]);
+        out.append(std::size_t(9 - (res.ptr - buf)), '0');
+        out.append(buf, res.ptr);
+    }
+}
+
+bool negligible(const RpnDecimal &term, const RpnDecimal &sum, int digits)
+{
+    return term.isZero() || term.adjustedExponent() < std::min(sum.adjustedExponent(), 0) - digits;
+}
+
+RpnDecimalContext working(const RpnDecimalContext &ctx, int extra)
+{
+    RpnDecimalContext w = ctx;
+    w.digits = ctx.digits + extra;
+    return w;
+}
+
+} // namespace
+
+// --- INTERNALS ---
+
+// Everything that needs the representation; a friend of RpnDecimal
+struct RpnDecimalOps
+{
+    static Nat coefficient(const RpnDecimal &x, std::uint32_t (&buf)[3])
+    {
+        if (x.m_limbs.empty()) return natFromU64(x.m_small, buf);
+        return { const_cast<std::uint32_t *>(x.m_limbs.data()), x.m_limbs.size() };
+    }
+
+    static RpnDecimal zero() { return {}; }
+
+    static RpnDecimal special(RpnDecimal::Kind kind, bool negative)
+    {
+        RpnDecimal r;
+        r.m_kind = kind;
+        r.m_negative = kind == RpnDecimal::Kind::Infinity && negative;
+        return r;
+    }
+
+    // Range check and store; `c` is rounded and has no trailing zeros
+    static RpnDecimal store(bool negative, std::int64_t exp, const Nat &c, const RpnDecimalContext &ctx)
+    {
+        if (c.n == 0) return zero();
+        const std::int64_t adj = exp + digits(c) - 1;
+        if (adj > ctx.maxExponent) return special(RpnDecimal::Kind::Infinity, negative);
+        if (adj < ctx.minExponent) return zero();
+
+        RpnDecimal r;
+        r.m_negative = negative;
+        r.m_exponent = std::int32_t(exp);
+        if (!natToU64(c, r.m_small)) {
+            r.m_small = 0;
+            r.m_limbs.assign(c.d, c.d + c.n);
+        }
+        return r;
+    }
+
+    // Rounds `c` * 10^exp to ctx. `sticky` = the exact value is a little
+    // above `c` (a division or root that did not come out even).
+    static RpnDecimal finish(bool negative, std::int64_t exp, Nat c, bool sticky, const RpnDecimalContext &ctx)
+    {
+        trim(c);
+        if (c.n == 0) return zero();
+        const std::int64_t n = digits(c);
+        if (n > ctx.digits) {
+            const std::int64_t drop = n - ctx.digits;
+            c = roundDrop(c, drop, sticky);
+            exp += drop;
+            // Rounded up to 10^digits
+            if (digits(c) > ctx.digits) {
+                c = shiftDown(c, 1);
+                exp += 1;
+            }
+        }
+        if (const std::int64_t z = trailingZeros(c); z > 0) {
+            c = shiftDown(c, z);
+            exp += z;
+        }
+        return store(negative, exp, c, ctx);
+    }
+
+    // Fast path: a coefficient that fits 64 bits
+    static RpnDecimal finishSmall(bool negative, std::int64_t exp, std::uint64_t c, const RpnDecimalContext &ctx)
+    {
+        if (c == 0) return zero();
+        if (u64Digits(c) > ctx.digits) {
+            LimbArena::Scope scope(t_arena);
+            std::uint32_t buf[3];
+            return finish(negative, exp, natFromU64(c, buf), false, ctx);
+        }
+        while (c % 10 == 0) {
+            c /= 10;
+            ++exp;
+        }
+        const std::int64_t adj = exp + u64Digits(c) - 1;
+        if (adj > ctx.maxExponent) return special(RpnDecimal::Kind::Infinity, negative);
+        if (adj < ctx.minExponent) return zero();
+        RpnDecimal r;
+        r.m_negative = negative;
+        r.m_exponent = std::int32_t(exp);
+        r.m_small = c;
+        return r;
+    }
+
+    static RpnDecimal rounded(const RpnDecimal &x, const RpnDecimalContext &ctx)
+    {
+        if (!x.isFinite()) return x;
+        if (x.digitCount() <= ctx.digits) {
+            const int adj = x.adjustedExponent();
+            if (adj > ctx.maxExponent) return special(RpnDecimal::Kind::Infinity, x.m_negative);
+            if (adj < ctx.minExponent) return zero();
+            return x;
+        }
+        LimbArena::Scope scope(t_arena);
+        std::uint32_t buf[3];
+        return finish(x.m_negative, x.m_exponent, coefficient(x, buf), false, ctx);
+    }
+
+    static RpnDecimal viaDouble(double v, const RpnDecimalContext &ctx)
+    {
+        return rounded(RpnDecimal::fromDouble(v), ctx);
+    }
+
+    // Toward zero
+    static RpnDecimal truncated(const RpnDecimal &x)
+    {
+        if (!x.isFinite() || x.m_exponent >= 0) return x;
+        LimbArena::Scope scope(t_arena);
+        std::uint32_t buf[3];
+        const Nat c = coefficient(x, buf);
+        return finish(x.m_negative, 0, shiftDown(c, -std::int64_t(x.m_exponent)), false,
+                      RpnDecimalContext::arbitrary(RpnDecimalContext::kMaxDigits));
+    }
+
+    static bool toInt64(const RpnDecimal &x, std::int64_t &out)
+    {
+        if (!x.isInteger() || !x.m_limbs.empty() || x.adjustedExponent() > 17) return false;
+        const std::int64_t v = std::int64_t(x.m_small * kPow10U64[x.m_exponent]);
+        out = x.m_negative ? -v : v;
+        return true;
+    }
+
+    static RpnDecimal addSigned(const RpnDecimal &a, const RpnDecimal &b, bool negateB, const RpnDecimalContext &ctx)
+    {
+        const bool bNeg = b.m_negative != negateB;
+        if (!a.isFinite() || !b.isFinite()) {
+            const double y = negateB ? -b.toDouble() : b.toDouble();
+            return viaDouble(a.toDouble() + y, ctx);
+        }
+        if (b.isZero()) return rounded(a, ctx);
+        if (a.isZero()) return rounded(negateB ? -b : b, ctx);
+
+        // Fast path: both coefficients (aligned) fit 64 bits
+        const std::int64_t e = std::min(a.m_exponent, b.m_exponent);
+        const std::int64_t sa = a.m_exponent - e;
+        const std::int64_t sb = b.m_exponent - e;
+        if (a.m_limbs.empty() && b.m_limbs.empty() && sa < 20 && sb < 20
+            && a.m_small <= std::numeric_limits<std::uint64_t>::max() / kPow10U64[sa]
+            && b.m_small <= std::numeric_limits<std::uint64_t>::max() / kPow10U64[sb]) {
+            const std::uint64_t x = a.m_small * kPow10U64[sa];
+            const std::uint64_t y = b.m_small * kPow10U64[sb];
+            if (a.m_negative != bNeg) {
+                if (x >= y) return finishSmall(a.m_negative, e, x - y, ctx);
+                return finishSmall(bNeg, e, y - x, ctx);
+            }
+            if (x <= std::numeric_limits<std::uint64_t>::max() - y) return finishSmall(a.m_negative, e, x + y, ctx);
+        }
+
+        LimbArena::Scope scope(t_arena);
+        std::uint32_t bufA[3], bufB[3];
+        Nat ca = coefficient(a, bufA);
+        Nat cb = coefficient(b, bufB);
+        std::int64_t ea = a.m_exponent;
+        std::int64_t eb = b.m_exponent;
+
+        // A much smaller operand only decides the rounding: stand in a single
+        // digit well below the last kept digit of the larger one
+        const std::int64_t adjA = ea + digits(ca) - 1;
+        const std::int64_t adjB = eb + digits(cb) - 1;
+        const std::int64_t gap = std::int64_t(ctx.digits) + 2;
+        std::uint32_t one[1] = { 1 };
+        if (adjA - adjB > gap && adjA - adjB > digits(ca)) {
+            cb = { one, 1 };
+            eb = std::min(ea, adjA - gap) - 1;
+        } else if (adjB - adjA > gap && adjB - adjA > digits(cb)) {
+            ca = { one, 1 };
+            ea = std::min(eb, adjB - gap) - 1;
+        }
+
+        const std::int64_t exp = std::min(ea, eb);
+        const Nat x = shiftUp(ca, ea - exp);
+        const Nat y = shiftUp(cb, eb - exp);
+        if (a.m_negative != bNeg) {
+            const int c = cmp(x, y);
+            if (c == 0) return zero();
+            if (c > 0) return finish(a.m_negative, exp, sub(x, y), false, ctx);
+            return finish(bNeg, exp, sub(y, x), false, ctx);
+        }
+        return finish(a.m_negative, exp, add(x, y), false, ctx);
+    }
+
+    static RpnDecimal powInt(const RpnDecimal &a, std::int64_t n, const RpnDecimalContext &ctx)
+    {
+        if (n == 0) return RpnDecimal::fromInt(1);
+        const RpnDecimalContext w = working(ctx, 10 + u64Digits(std::uint64_t(n < 0 ? -n : n)));
+        RpnDecimal result = RpnDecimal::fromInt(1);
+        RpnDecimal base = a;
+        std::uint64_t k = std::uint64_t(n < 0 ? -n : n);
+        while (k) {
+            if (k & 1) result = RpnDecimal::mul(result, base, w);
+            k >>= 1;
+            if (k) base = RpnDecimal::mul(base, base, w);
+            if (!result.isFinite() && !base.isFinite()) break;
+        }
+        if (n < 0) result = RpnDecimal::div(RpnDecimal::fromInt(1), result, w);
+        return rounded(result, ctx);
+    }
+
+    // 1/x as a series: atan(1/x) = sum (-1)^k / ((2k+1) x^(2k+1))
+    static RpnDecimal atanInverse(int x, const RpnDecimalContext &w)
+    {
+        const RpnDecimal x2 = RpnDecimal::fromInt(std::int64_t(x) * x);
+        RpnDecimal power = RpnDecimal::div(RpnDecimal::fromInt(1), RpnDecimal::fromInt(x), w);
+        RpnDecimal sum = power;
+        for (std::int64_t k = 1;; ++k) {
+            power = RpnDecimal::div(power, x2, w);
+            const RpnDecimal term = RpnDecimal::div(power, RpnDecimal::fromInt(2 * k + 1), w);
+            if (negligible(term, sum, w.digits)) break;
+            sum = (k & 1) ? RpnDecimal::sub(sum, term, w) : RpnDecimal::add(sum, term, w);
+        }
+        return sum;
+    }
+
+    // x reduced to [-pi, pi]
+    static RpnDecimal reduce(const RpnDecimal &x, RpnDecimalContext &w)
+    {
+        w.digits += std::max(0, x.adjustedExponent()) + 2;
+        const RpnDecimal pi = RpnDecimal::pi(w);
+        const RpnDecimal twoPi = RpnDecimal::mul(RpnDecimal::fromInt(2), pi, w);
+        const RpnDecimal turns = truncated(RpnDecimal::div(x, twoPi, w));
+        RpnDecimal r = RpnDecimal::sub(x, RpnDecimal::mul(turns, twoPi, w), w);
+        if (r.compare(pi) > 0) r = RpnDecimal::sub(r, twoPi, w);
+        else if (r.compare(-pi) < 0) r = RpnDecimal::add(r, twoPi, w);
+        return r;
+    }
+
+    // Taylor series of sin or cos for r in [-pi, pi]
+    static RpnDecimal taylor(const RpnDecimal &r, bool sine, const RpnDecimalContext &w)
+    {
+        const RpnDecimal r2 = RpnDecimal::mul(r, r, w);
+        RpnDecimal term = sine ? r : RpnDecimal::fromInt(1);
+        RpnDecimal sum = term;
+        for (std::int64_t k = 1;; ++k) {
+            const std::int64_t f = sine ? 2 * k * (2 * k + 1) : (2 * k - 1) * (2 * k);
+            term = -RpnDecimal::div(RpnDecimal::mul(term, r2, w), RpnDecimal::fromInt(f), w);
+            if (negligible(term, sum, w.digits)) break;
+            sum = RpnDecimal::add(sum, term, w);
+        }
+        return sum;
+    }
+};
+
+// --- CONSTRUCTION ---
+
+RpnDecimalContext RpnDecimalContext::arbitrary(int digits)
+{
+    RpnDecimalContext ctx;
+    ctx.digits = std::clamp(digits, 1, kMaxDigits);
+    ctx.minExponent = -kExponentLimit + kMaxDigits;
+    ctx.maxExponent = kExponentLimit - kMaxDigits;
+    return ctx;
+}
+
+RpnDecimal RpnDecimal::fromInt(std::int64_t v)
+{
+    const std::uint64_t mag = v < 0 ? std::uint64_t(0) - std::uint64_t(v) : std::uint64_t(v);
+    return RpnDecimalOps::finishSmall(v < 0, 0, mag, RpnDecimalContext::arbitrary(RpnDecimalContext::kMaxDigits));
+}
+
+RpnDecimal RpnDecimal::fromDouble(double v)
+{
+    if (std::isnan(v)) return nan();
+    if (std::isinf(v)) return infinity(v < 0);
+    char buf[64];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    RpnDecimal out;
+    fromChars(std::string_view(buf, std::size_t(res.ptr - buf)), out,
+              RpnDecimalContext::arbitrary(RpnDecimalContext::kMaxDigits));
+    return out;
+}
+
+RpnDecimal RpnDecimal::infinity(bool negative)
+{
+    return RpnDecimalOps::special(Kind::Infinity, negative);
+}
+
+RpnDecimal RpnDecimal::nan()
+{
+    return RpnDecimalOps::special(Kind::NaN, false);
+}
+
+bool RpnDecimal::fromChars(std::string_view text, RpnDecimal &out, const RpnDecimalContext &ctx)
+{
+    bool negative = false;
+    std::string_view s = text;
+    if (!s.empty() && (s.front() == '+' || s.front() == '-')) {
+        negative = s.front() == '-';
+        s.remove_prefix(1);
+    }
+    if (s == "NaN" && s.size() == text.size()) {
+        out = nan();
+        return true;
+    }
+    if (s == "Infinity") {
+        out = infinity(negative);
+        return true;
+    }
+
+    // Significant digits (leading zeros skipped) and where the point was
+    std::size_t i = 0;
+    std::size_t digitsSeen = 0;
+    std::int64_t fraction = 0;
+    bool point = false;
+    std::string coef;
+    coef.reserve(s.size());
+    for (; i < s.size(); ++i) {
+        const char c = s[i];
+        if (c >= '0' && c <= '9') {
+            ++digitsSeen;
+            if (point) ++fraction;
+            if (c != '0' || !coef.empty()) coef += c;
+        } else if (c == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (digitsSeen == 0) return false;
+
+    std::int64_t exp = 0;
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        bool expNegative = false;
+        if (i < s.size() && (s[i] == '+' || s[i] == '-')) expNegative = s[i++] == '-';
+        const std::size_t start = i;
+        for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i)
+            exp = std::min<std::int64_t>(exp * 10 + (s[i] - '0'), std::int64_t(kExponentLimit) * 4);
+        if (i == start) return false;
+        if (expNegative) exp = -exp;
+    }
+    if (i != s.size()) return false;
+
+    LimbArena::Scope scope(t_arena);
+    Nat c = alloc(coef.size() / 9 + 1);
+    c.n = 0;
+    for (std::size_t end = coef.size(); end > 0;) {
+        const std::size_t start = end >= 9 ? end - 9 : 0;
+        std::uint32_t limb = 0;
+        for (std::size_t k = start; k < end; ++k) limb = limb * 10 + std::uint32_t(coef[k] - '0');
+        c.d[c.n++] = limb;
+        end = start;
+    }
+    out = RpnDecimalOps::finish(negative, exp - fraction, c, false, ctx);
+    return true;
+}
+
+// --- PROPERTIES ---
+
+int RpnDecimal::digitCount() const
+{
+    if (!m_limbs.empty()) return int(m_limbs.size() - 1) * 9 + limbDigits(m_limbs.back());
+    return u64Digits(m_small);
+}
+
+int RpnDecimal::adjustedExponent() const
+{
+    if (!isFinite() || isZero()) return 0;
+    return m_exponent + digitCount() - 1;
+}
+
+int RpnDecimal::compare(const RpnDecimal &other) const
+{
+    const int sa = isZero() ? 0 : (m_negative ? -1 : 1);
+    const int sb = other.isZero() ? 0 : (other.m_negative ? -1 : 1);
+    if (sa != sb || sa == 0) return sa < sb ? -1 : (sa > sb ? 1 : 0);
+
+    int mag = 0;
+    const int adjA = adjustedExponent();
+    const int adjB = other.adjustedExponent();
+    if (adjA != adjB) {
+        mag = adjA < adjB ? -1 : 1;
+    } else {
+        LimbArena::Scope scope(t_arena);
+        std::uint32_t bufA[3], bufB[3];
+        const std::int64_t e = std::min(m_exponent, other.m_exponent);
+        mag = cmp(shiftUp(RpnDecimalOps::coefficient(*this, bufA), m_exponent - e),
+                  shiftUp(RpnDecimalOps::coefficient(other, bufB), other.m_exponent - e));
+    }
+    return sa < 0 ? -mag : mag;
+}
+
+RpnDecimal RpnDecimal::roundedTo(const RpnDecimalContext &ctx) const
+{
+    return RpnDecimalOps::rounded(*this, ctx);
+}
+
+RpnDecimal RpnDecimal::scaledByPow10(int n) const
+{
+    RpnDecimal r = *this;
+    if (isFinite() && !isZero())
+        r.m_exponent = std::int32_t(std::clamp<std::int64_t>(std::int64_t(m_exponent) + n,
+                                                             -kExponentLimit, kExponentLimit));
+    return r;
+}
+
+RpnDecimal RpnDecimal::operator-() const
+{
+    RpnDecimal r = *this;
+    if (!isZero() && !isNaN()) r.m_negative = !m_negative;
+    return r;
+}
+
+RpnDecimal RpnDecimal::abs() const
+{
+    RpnDecimal r = *this;
+    r.m_negative = false;
+    return r;
+}
+
+// --- CONVERSION ---
+
+double RpnDecimal::toDouble() const
+{
+    if (isNaN()) return std::numeric_limits<double>::quiet_NaN();
+    if (m_kind == Kind::Infinity)
+        return m_negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+
+    // Both parts exact in a double, so one multiply/divide rounds correctly
+    static constexpr double kExact[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (m_limbs.empty() && m_small < (1ull << 53) && m_exponent >= -22 && m_exponent <= 22) {
+        double v = double(m_small);
+        if (m_exponent >= 0) v *= kExact[m_exponent];
+        else v /= kExact[-m_exponent];
+        return m_negative ? -v : v;
+    }
+
+    const std::string s = toString();
+    double v = 0.0;
+    const auto res = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (res.ec == std::errc::result_out_of_range)
+        v = adjustedExponent() > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+    if (res.ec == std::errc::result_out_of_range && m_negative) v = -v;
+    return v;
+}
+
+std::string RpnDecimal::toString() const
+{
+    if (isNaN()) return "NaN";
+    if (m_kind == Kind::Infinity) return m_negative ? "-Infinity" : "Infinity";
+
+    std::string out;
+    if (m_negative) out += '-';
+    LimbArena::Scope scope(t_arena);
+    std::uint32_t buf[3];
+    appendDigits(out, RpnDecimalOps::coefficient(*this, buf));
+    if (m_exponent != 0) out += 'E' + std::to_string(m_exponent);
+    return out;
+}
+
+std::string RpnDecimal::toFixed(int decimals) const
+{
+    if (!isFinite()) return toString();
+    decimals = std::max(decimals, 0);
+
+    LimbArena::Scope scope(t_arena);
+    std::uint32_t buf[3];
+    Nat c = RpnDecimalOps::coefficient(*this, buf);
+    std::int64_t exp = m_exponent;
+    if (exp < -decimals) {
+        c = roundDrop(c, -decimals - exp, false);
+        trim(c);
+        exp = -decimals;
+    }
+
+    std::string digitsText;
+    appendDigits(digitsText, c);
+    if (exp > 0) digitsText.append(std::size_t(exp), '0');
+    const std::size_t fraction = exp < 0 ? std::size_t(-exp) : 0;
+    if (digitsText.size() <= fraction) digitsText.insert(0, fraction + 1 - digitsText.size(), '0');
+
+    std::string out;
+    out.reserve(digitsText.size() + std::size_t(decimals) + 2);
+    if (m_negative) out += '-';
+    out.append(digitsText, 0, digitsText.size() - fraction);
+    if (decimals > 0) {
+        out += '.';
+        out.append(digitsText, digitsText.size() - fraction, fraction);
+        out.append(std::size_t(decimals) - fraction, '0');
+    }
+    return out;
+}
+
+// --- ARITHMETIC ---
+
+RpnDecimal RpnDecimal::add(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx)
+{
+    return RpnDecimalOps::addSigned(a, b, false, ctx);
+}
+
+RpnDecimal RpnDecimal::sub(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx)
+{
+    return RpnDecimalOps::addSigned(a, b, true, ctx);
+}
+
+RpnDecimal RpnDecimal::mul(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx)
+{
+    if (!a.isFinite() || !b.isFinite()) return RpnDecimalOps::viaDouble(a.toDouble() * b.toDouble(), ctx);
+    if (a.isZero() || b.isZero()) return {};
+
+    const bool negative = a.m_negative != b.m_negative;
+    const std::int64_t exp = std::int64_t(a.m_exponent) + b.m_exponent;
+    if (a.m_limbs.empty() && b.m_limbs.empty()
+        && a.m_small <= std::numeric_limits<std::uint64_t>::max() / b.m_small)
+        return RpnDecimalOps::finishSmall(negative, exp, a.m_small * b.m_small, ctx);
+
+    LimbArena::Scope scope(t_arena);
+    std::uint32_t bufA[3], bufB[3];
+    return RpnDecimalOps::finish(negative, exp,
+                                 ::mul(RpnDecimalOps::coefficient(a, bufA), RpnDecimalOps::coefficient(b, bufB)),
+                                 false, ctx);
+}
+
+RpnDecimal RpnDecimal::div(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx)
+{
+    if (!a.isFinite() || !b.isFinite() || b.isZero())
+        return RpnDecimalOps::viaDouble(a.toDouble() / b.toDouble(), ctx);
+    if (a.isZero()) return {};
+
+    const bool negative = a.m_negative != b.m_negative;
+    const std::int64_t exp = std::int64_t(a.m_exponent) - b.m_exponent;
+
+    // Fast path: the quotient is exact after scaling by at most 10^19
+    if (a.m_limbs.empty() && b.m_limbs.empty()) {
+        std::uint64_t x = a.m_small;
+        for (int k = 0; k < 20; ++k) {
+            if (x % b.m_small == 0) return RpnDecimalOps::finishSmall(negative, exp - k, x / b.m_small, ctx);
+            if (x > std::numeric_limits<std::uint64_t>::max() / 10) break;
+            x *= 10;
+        }
+    }
+
+    LimbArena::Scope scope(t_arena);
+    std::uint32_t bufA[3], bufB[3];
+    const Nat ca = RpnDecimalOps::coefficient(a, bufA);
+    const Nat cb = RpnDecimalOps::coefficient(b, bufB);
+    // Enough digits in the quotient to round correctly
+    const std::int64_t shift = std::max<std::int64_t>(0, ctx.digits + 2 + digits(cb) - digits(ca));
+    Nat q, r;
+    divmod(shiftUp(ca, shift), cb, q, r);
+    return RpnDecimalOps::finish(negative, exp - shift, q, r.n > 0, ctx);
+}
+
+RpnDecimal RpnDecimal::pow(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx)
+{
+    std::int64_t n = 0;
+    if (a.isFinite() && RpnDecimalOps::toInt64(b, n) && n >= -1000000000 && n <= 1000000000)
+        return RpnDecimalOps::powInt(a, n, ctx);
+    return RpnDecimalOps::viaDouble(std::pow(a.toDouble(), b.toDouble()), ctx);
+}
+
+RpnDecimal RpnDecimal::root(const RpnDecimal &a, const RpnDecimal &degree, const RpnDecimalContext &ctx)
+{
+    std::int64_t n = 0;
+    // Newton needs a double start value of the scaled operand: keep n small
+    if (!a.isFinite() || !RpnDecimalOps::toInt64(degree, n) || n == 0 || n > 300 || n < -300)
+        return RpnDecimalOps::viaDouble(std::pow(a.toDouble(), 1.0 / degree.toDouble()), ctx);
+    if (n < 0) {
+        const RpnDecimalContext w = working(ctx, 5);
+        return RpnDecimalOps::rounded(div(fromInt(1), root(a, fromInt(-n), w), w), ctx);
+    }
+    if (a.isZero()) return {};
+    if (a.isNegative()) {
+        if (n % 2 == 0) return nan();
+        return -root(-a, degree, ctx);
+    }
+    if (n == 1) return RpnDecimalOps::rounded(a, ctx);
+
+    // Start from the double root of a / 10^(k*n), then x = ((n-1)x + a/x^(n-1)) / n
+    const RpnDecimalContext w = working(ctx, 6);
+    const int adj = a.adjustedExponent();
+    const int k = (adj >= 0 ? adj : adj - int(n) + 1) / int(n);
+    const double m = a.scaledByPow10(-k * int(n)).toDouble();
+    RpnDecimal x = fromDouble(std::pow(m, 1.0 / double(n))).scaledByPow10(k);
+
+    const RpnDecimal degreeValue = fromInt(n);
+    const RpnDecimal degreeLess = fromInt(n - 1);
+    const RpnDecimalContext check = working(ctx, 2);
+    for (int i = 0; i < 100; ++i) {
+        const RpnDecimal xp = RpnDecimalOps::powInt(x, n - 1, w);
+        const RpnDecimal next = div(add(mul(degreeLess, x, w), div(a, xp, w), w), degreeValue, w);
+        const bool done = rpnSameValue(RpnDecimalOps::rounded(next, check), RpnDecimalOps::rounded(x, check));
+        x = next;
+        if (done) break;
+    }
+    return RpnDecimalOps::rounded(x, ctx);
+}
+
+RpnDecimal RpnDecimal::sqrt(const RpnDecimal &a, const RpnDecimalContext &ctx)
+{
+    return root(a, fromInt(2), ctx);
+}
+
+RpnDecimal RpnDecimal::sin(const RpnDecimal &x, const RpnDecimalContext &ctx)
+{
+    // Reduction needs as many extra digits as x has integer digits
+    if (!x.isFinite() || x.adjustedExponent() > RpnDecimalContext::kMaxDigits)
+        return RpnDecimalOps::viaDouble(std::sin(x.toDouble()), ctx);
+    RpnDecimalContext w = working(ctx, 8);
+    const RpnDecimal r = RpnDecimalOps::reduce(x, w);
+    return RpnDecimalOps::rounded(RpnDecimalOps::taylor(r, true, w), ctx);
+}
+
+RpnDecimal RpnDecimal::cos(const RpnDecimal &x, const RpnDecimalContext &ctx)
+{
+    if (!x.isFinite() || x.adjustedExponent() > RpnDecimalContext::kMaxDigits)
+        return RpnDecimalOps::viaDouble(std::cos(x.toDouble()), ctx);
+    RpnDecimalContext w = working(ctx, 8);
+    const RpnDecimal r = RpnDecimalOps::reduce(x, w);
+    return RpnDecimalOps::rounded(RpnDecimalOps::taylor(r, false, w), ctx);
+}
+
+RpnDecimal RpnDecimal::tan(const RpnDecimal &x, const RpnDecimalContext &ctx)
+{
+    if (!x.isFinite() || x.adjustedExponent() > RpnDecimalContext::kMaxDigits)
+        return RpnDecimalOps::viaDouble(std::tan(x.toDouble()), ctx);
+    RpnDecimalContext w = working(ctx, 8);
+    const RpnDecimal r = RpnDecimalOps::reduce(x, w);
+    return RpnDecimalOps::rounded(div(RpnDecimalOps::taylor(r, true, w), RpnDecimalOps::taylor(r, false, w), w), ctx);
+}
+
+RpnDecimal RpnDecimal::exp(const RpnDecimal &x, const RpnDecimalContext &ctx)
+{
+    // Past 10^6 the result leaves any exponent range a context has in practice
+    if (!x.isFinite() || x.adjustedExponent() >= 6) return RpnDecimalOps::viaDouble(std::exp(x.toDouble()), ctx);
+    if (x.isZero()) return fromInt(1);
+
+    // exp(x) = exp(x / 2^k)^(2^k) with |x / 2^k| <= 1/2; every squaring
+    // doubles the relative error, so k/3 more digits cover them
+    int k = 0;
+    for (double m = std::fabs(x.toDouble()); m > 0.5; m /= 2) ++k;
+    const RpnDecimalContext w = working(ctx, 10 + k / 3);
+    const RpnDecimal r = div(x, fromInt(std::int64_t(1) << k), w);
+
+    RpnDecimal term = fromInt(1);
+    RpnDecimal sum = term;
+    for (std::int64_t n = 1;; ++n) {
+        term = div(mul(term, r, w), fromInt(n), w);
+        if (negligible(term, sum, w.digits)) break;
+        sum = add(sum, term, w);
+    }
+    for (int i = 0; i < k && sum.isFinite(); ++i) sum = mul(sum, sum, w);
+    return RpnDecimalOps::rounded(sum, ctx);
+}
+
+RpnDecimal RpnDecimal::ln(const RpnDecimal &x, const RpnDecimalContext &ctx)
+{
+    if (x.isNaN() || x.isNegative() || x.isZero()) return nan();
+    if (!x.isFinite()) return x;
+    if (x.compare(fromInt(1)) == 0) return {};
+
+    // Halley on exp(y) = x from the double logarithm of m * 10^adj;
+    // every step triples the correct digits
+    const RpnDecimalContext w = working(ctx, 10);
+    const int adj = x.adjustedExponent();
+    const double m = x.scaledByPow10(-adj).toDouble();
+    RpnDecimal y = fromDouble(std::log(m) + adj * std::log(10.0));
+    for (int good = 14;; good *= 3) {
+        const RpnDecimal ey = exp(y, w);
+        y = add(y, div(mul(fromInt(2), sub(x, ey, w), w), add(x, ey, w), w), w);
+        if (good * 3 > w.digits) break;
+    }
+    return RpnDecimalOps::rounded(y, ctx);
+}
+
+RpnDecimal RpnDecimal::factorial(std::int64_t n, const RpnDecimalContext &ctx)
+{
+    // One rounding per factor: a few guard digits more than n has
+    const RpnDecimalContext w = working(ctx, 5 + u64Digits(std::uint64_t(n)));
+    RpnDecimal result = fromInt(1);
+    for (std::int64_t i = 2; i <= n && result.isFinite(); ++i) result = mul(result, fromInt(i), w);
+    return RpnDecimalOps::rounded(result, ctx);
+}
+
+RpnDecimal RpnDecimal::pi(const RpnDecimalContext &ctx)
+{
+    // Machin: pi = 16 atan(1/5) - 4 atan(1/239); the last result is kept
+    thread_local int cachedDigits = 0;
+    thread_local RpnDecimal cached;
+    if (cachedDigits < ctx.digits + 5) {
+        const RpnDecimalContext w = working(RpnDecimalContext::arbitrary(ctx.digits), 10);
+        cached = sub(mul(fromInt(16), RpnDecimalOps::atanInverse(5, w), w),
+                     mul(fromInt(4), RpnDecimalOps::atanInverse(239, w), w), w);
+        cachedDigits = w.digits;
+    }
+    return RpnDecimalOps::rounded(cached, ctx);
+}
+
+RpnDecimal RpnDecimal::e(const RpnDecimalContext &ctx)
+{
+    thread_local int cachedDigits = 0;
+    thread_local RpnDecimal cached;
+    if (cachedDigits < ctx.digits + 5) {
+        const RpnDecimalContext w = working(RpnDecimalContext::arbitrary(ctx.digits), 10);
+        RpnDecimal term = fromInt(1);
+        RpnDecimal sum = term;
+        for (std::int64_t k = 1;; ++k) {
+            term = div(term, fromInt(k), w);
+            if (negligible(term, sum, w.digits)) break;
+            sum = add(sum, term, w);
+        }
+        cached = sum;
+        cachedDigits = w.digits;
+    }
+    return RpnDecimalOps::rounded(cached, ctx);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Precision and exponent range that decimal results are rounded to
+// (round half to even). Exponents are adjusted exponents, i.e. the
+// position of the leading digit: 1234.5 has adjusted exponent 3.
+struct RpnDecimalContext {
+    static constexpr int kMaxDigits = 1000;
+
+    int digits = 34;
+    int minExponent = -6143;
+    int maxExponent = 6144;
+
+    // IEEE 754 decimal128: 34 digits, exponents -6143..6144
+    static RpnDecimalContext decimal128() { return {}; }
+    // `digits` significant digits (clamped to 1..kMaxDigits), huge range
+    static RpnDecimalContext arbitrary(int digits);
+
+    bool operator==(const RpnDecimalContext &) const = default;
+};
+
+// Decimal floating point number: (-1)^negative * coefficient * 10^exponent.
+//
+// Coefficients below 2^64 are kept inline, and add/sub/mul/exact div of
+// two of them run on plain 64-bit integers when the result fits (the
+// small-value fast path). Larger coefficients are base-10^9 limbs; the
+// temporaries of an operation come from a per-thread limb arena, so only
+// a result that does not fit 64 bits allocates.
+//
+// Values are canonical (no trailing zeros in the coefficient, zero is +0),
+// so equal numbers have equal representations.
+class RpnDecimal
+{
+public:
+    RpnDecimal() = default; // 0
+
+    static RpnDecimal fromInt(std::int64_t v);
+    // Shortest decimal that reads back as `v` (0.1 -> 0.1, not 0.1000000000000000055...)
+    static RpnDecimal fromDouble(double v);
+    static RpnDecimal infinity(bool negative);
+    static RpnDecimal nan();
+
+    // Plain C syntax: [+-]digits[.digits][(e|E)[+-]digits], "Infinity" or
+    // "NaN" (what toString() writes). Rounded to `ctx`.
+    static bool fromChars(std::string_view text, RpnDecimal &out, const RpnDecimalContext &ctx);
+
+    bool isFinite() const { return m_kind == Kind::Finite; }
+    bool isNaN() const { return m_kind == Kind::NaN; }
+    bool isZero() const { return m_kind == Kind::Finite && m_limbs.empty() && m_small == 0; }
+    bool isNegative() const { return m_negative; }
+    bool isInteger() const { return m_kind == Kind::Finite && m_exponent >= 0; }
+    // Position of the leading digit; 0 for zero
+    int adjustedExponent() const;
+    int digitCount() const;
+    // Numeric order of two finite values: -1, 0 or 1
+    int compare(const RpnDecimal &other) const;
+
+    double toDouble() const;
+    // Exact, e.g. "12345E-3"; fromChars() reads it back
+    std::string toString() const;
+    // Rounded to `decimals` places: "-12.3400"
+    std::string toFixed(int decimals) const;
+
+    // Rounded to the precision and range of `ctx`
+    RpnDecimal roundedTo(const RpnDecimalContext &ctx) const;
+    // Multiplies by 10^n (exact)
+    RpnDecimal scaledByPow10(int n) const;
+    RpnDecimal operator-() const;
+    RpnDecimal abs() const;
+
+    friend bool rpnSameValue(const RpnDecimal &a, const RpnDecimal &b)
+    {
+        return a.m_kind == b.m_kind && a.m_negative == b.m_negative && a.m_exponent == b.m_exponent
+               && a.m_small == b.m_small && a.m_limbs == b.m_limbs;
+    }
+
+    friend double rpnToDouble(const RpnDecimal &v) { return v.toDouble(); }
+
+    // --- ARITHMETIC (rounded to ctx) ---
+    static RpnDecimal add(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx);
+    static RpnDecimal sub(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx);
+    static RpnDecimal mul(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx);
+    // x / 0 gives an infinity (0 / 0 NaN); callers report division by zero first
+    static RpnDecimal div(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx);
+    // Exact for integer `b`; other exponents go through double
+    static RpnDecimal pow(const RpnDecimal &a, const RpnDecimal &b, const RpnDecimalContext &ctx);
+    // n-th root for integer n (Newton), other degrees through double.
+    // NaN for an even root of a negative number.
+    static RpnDecimal root(const RpnDecimal &a, const RpnDecimal &n, const RpnDecimalContext &ctx);
+    static RpnDecimal sqrt(const RpnDecimal &a, const RpnDecimalContext &ctx);
+    static RpnDecimal sin(const RpnDecimal &x, const RpnDecimalContext &ctx);
+    static RpnDecimal cos(const RpnDecimal &x, const RpnDecimalContext &ctx);
+    static RpnDecimal tan(const RpnDecimal &x, const RpnDecimalContext &ctx);
+    static RpnDecimal exp(const RpnDecimal &x, const RpnDecimalContext &ctx);
+    // Natural logarithm; NaN for x <= 0
+    static RpnDecimal ln(const RpnDecimal &x, const RpnDecimalContext &ctx);
+    // n! for n >= 0, an infinity once it leaves the exponent range
+    static RpnDecimal factorial(std::int64_t n, const RpnDecimalContext &ctx);
+    static RpnDecimal pi(const RpnDecimalContext &ctx);
+    static RpnDecimal e(const RpnDecimalContext &ctx);
+
+private:
+    enum class Kind : std::uint8_t { Finite, Infinity, NaN };
+
+    friend struct RpnDecimalOps;
+
+    Kind m_kind = Kind::Finite;
+    bool m_negative = false;
+    std::int32_t m_exponent = 0;
+    std::uint64_t m_small = 0;           // the coefficient while m_limbs is empty
+    std::vector<std::uint32_t> m_limbs;  // base 10^9, least significant first
+};
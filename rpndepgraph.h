@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "rpnops.h"
+#include "rpnundolog.h"
+#include "rpnvalue.h"
+
+// Where stack values came from, so an edit can recompute what was derived
+// from the edited value (RpnStackCore::setTrackingEnabled()).
+//
+// A value produced by a registry op or dup is a node that remembers the op
+// and its input nodes. Inputs taken off the stack stay alive as long as
+// something depends on them, so the nodes form a DAG. Numbers typed,
+// imported or produced by whole-stack ops and programs are plain (node 0)
+// until an op takes them as input. Inputs are always older than the nodes
+// using them, so creation order is a topological order.
+//
+// recompute() walks only downstream of the edited node, oldest first; a
+// node whose result comes out bitwise unchanged is not followed further.
+// An edited node keeps its new value (it is pinned) but also its formula,
+// so undo can bring both back.
+//
+// Every undo step has a journal step in lockstep with it: the node ids of
+// the slots it removed and inserted, or the node states an edit changed.
+// Undo and redo restore links along with values. Nodes that neither the
+// stack nor the journal can reach are collected once the node count has
+// doubled since the last collection, and when a new step drops the redo side.
+template <typename Value>
+class RpnDepGraph
+{
+public:
+    using Id = std::uint32_t;  // 0: a plain number
+
+    // Journal entry: a slot's node (ReplaceTop, Remove) or a node's state (SetValue)
+    struct Entry {
+        Id id = 0;
+        bool pinned = false;
+        Value value{};
+    };
+
+    bool enabled() const { return m_enabled; }
+
+    // Drops all nodes and the journal; `count` plain numbers are on the stack
+    void reset(bool enabled, std::size_t count)
+    {
+        m_enabled = enabled;
+        m_nodes.clear();
+        m_free.clear();
+        m_ids.assign(enabled ? count : 0, 0);
+        m_collectAt = kMinCollect;
+        clearJournal();
+    }
+
+    void clearJournal()
+    {
+        m_log.clear();
+        discard();
+    }
+
+    void setLimit(std::size_t limit) { m_log.setLimit(limit); }
+
+    Id idAt(std::size_t index) const { return m_enabled ? m_ids[index] : 0; }
+
+    // --- SLOTS (index counted from the bottom) ---
+    // Changes are collected for the next record()
+
+    // Slots [from, end) left the stack
+    void drop(std::size_t from)
+    {
+        if (!m_enabled || from >= m_ids.size()) return;
+        const auto first = m_ids.begin() + std::ptrdiff_t(from);
+        // Plain numbers only: nothing to journal
+        if (std::any_of(first, m_ids.end(), [](Id id) { return id != 0; })) {
+            for (auto it = first; it != m_ids.end(); ++it) {
+                m_before.push_back(Entry{ *it });
+                if (*it) node(*it).slot = 0;
+            }
+        }
+        m_ids.erase(first, m_ids.end());
+    }
+
+    // Slots [from, stack.size()) are new; `ids` are their nodes, if any
+    void take(std::size_t from, std::span<const Value> stack, std::span<const Entry> ids = {})
+    {
+        if (!m_enabled) return;
+        m_ids.resize(stack.size(), 0);
+        const std::size_t n = std::min(ids.size(), stack.size() - from);
+        for (std::size_t i = 0; i < n; ++i) {
+            const Id id = ids[i].id;
+            if (id && node(id).slot) continue;  // already on the stack elsewhere: stays plain
+            m_ids[from + i] = id;
+            if (!id) continue;
+            Node &nd = node(id);
+            nd.slot = Id(from + i + 1);
+            nd.value = stack[from + i];
+        }
+        if (std::any_of(ids.begin(), ids.begin() + std::ptrdiff_t(n), [](const Entry &e) { return e.id != 0; }))
+            m_after.insert(m_after.end(), ids.begin(), ids.begin() + std::ptrdiff_t(n));
+    }
+
+    void insert(std::size_t index, const Value &v, Id id)
+    {
+        if (!m_enabled) return;
+        if (id && node(id).slot) id = 0;
+        m_ids.insert(m_ids.begin() + std::ptrdiff_t(index), id);
+        renumber(index);
+        if (id) node(id).value = v;
+    }
+
+    void erase(std::size_t index)
+    {
+        if (!m_enabled) return;
+        const Id id = m_ids[index];
+        if (id) {
+            m_before.push_back(Entry{ id });
+            node(id).slot = 0;
+        }
+        m_ids.erase(m_ids.begin() + std::ptrdiff_t(index));
+        renumber(index);
+    }
+
+    void swap(std::size_t index)
+    {
+        if (!m_enabled) return;
+        std::swap(m_ids[index], m_ids[index + 1]);
+        renumber(index, index + 2);
+    }
+
+    // Keeps a slot's node in step with a value written to it
+    void sync(std::size_t index, const Value &v)
+    {
+        if (const Id id = idAt(index)) node(id).value = v;
+    }
+
+    // A registry op or dup on the top `inputs` of `stack`; returns the node
+    // for its result (0 without inputs). Plain inputs become nodes here.
+    Id derive(RpnOp op, std::size_t inputs, std::span<const Value> stack)
+    {
+        if (!m_enabled || inputs == 0) return 0;
+        Id in[2] = {};
+        const std::size_t base = stack.size() - inputs;
+        for (std::size_t i = 0; i < inputs; ++i) {
+            Id &id = m_ids[base + i];
+            if (!id) {
+                id = allocate();
+                Node &leaf = node(id);
+                leaf.value = stack[base + i];
+                leaf.slot = Id(base + i + 1);
+            }
+            in[i] = id;
+        }
+        const Id id = allocate();
+        Node &nd = node(id);
+        nd.op = op;
+        nd.arity = std::uint8_t(inputs);
+        for (std::size_t i = 0; i < inputs; ++i) {
+            nd.in[i] = in[i];
+            // Distinct slots hold distinct nodes, so each user is listed once
+            node(in[i]).users.push_back(id);
+        }
+        return id;
+    }
+
+    // --- EDITS ---
+
+    // A value written over a node without recomputing its users
+    void pin(std::size_t index, const Value &v)
+    {
+        const Id id = idAt(index);
+        if (!id) return;
+        Node &nd = node(id);
+        m_before.push_back(Entry{ id, nd.pinned, nd.value });
+        nd.pinned = nd.arity > 0;
+        nd.value = v;
+        m_after.push_back(Entry{ id, nd.pinned, nd.value });
+    }
+
+    // New values for the node at `index` and everything downstream of it,
+    // into fresh() (edited node first, then in topological order). Nothing
+    // changes yet; an op that fails on its new inputs returns its error.
+    // `eval(op, in, out)` computes one op.
+    template <typename Eval>
+    RpnError recompute(std::size_t index, const Value &v, Eval &&eval)
+    {
+        m_fresh.clear();
+        const Id id = idAt(index);
+        if (!id || node(id).users.empty()) return RpnError::None;
+
+        ++m_epoch;
+        markFresh(id, v);
+        m_heap.clear();
+        enqueueUsers(id);
+        while (!m_heap.empty()) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+            const Id u = m_heap.back().second;
+            m_heap.pop_back();
+            Node &nd = node(u);
+            if (nd.stamp == m_epoch) continue;  // reached through another input
+            nd.stamp = m_epoch;
+            nd.fresh = kNone;
+            if (nd.pinned) continue;
+
+            Value in[2];
+            for (int i = 0; i < nd.arity; ++i) in[i] = valueOf(nd.in[i]);
+            Value out;
+            if (const RpnError e = eval(nd.op, static_cast<const Value *>(in), out); e != RpnError::None) {
+                m_fresh.clear();
+                return e;
+            }
+            if (rpnSameValue(out, nd.value)) continue;
+            markFresh(u, std::move(out));
+            enqueueUsers(u);
+        }
+        return RpnError::None;
+    }
+
+    // (node, new value) from the last recompute(); empty if nothing depends on it
+    const std::vector<std::pair<Id, Value>> &fresh() const { return m_fresh; }
+    // Stack index of a node, or -1 when it is off the stack
+    std::ptrdiff_t slotOf(Id id) const { return std::ptrdiff_t(node(id).slot) - 1; }
+
+    // Writes fresh() into the nodes; the edited one is pinned
+    void commit()
+    {
+        for (std::size_t i = 0; i < m_fresh.size(); ++i) {
+            Node &nd = node(m_fresh[i].first);
+            m_before.push_back(Entry{ m_fresh[i].first, nd.pinned, nd.value });
+            if (i == 0) nd.pinned = nd.arity > 0;
+            nd.value = m_fresh[i].second;
+            m_after.push_back(Entry{ m_fresh[i].first, nd.pinned, nd.value });
+        }
+        m_fresh.clear();
+    }
+
+    // Node states from a journal step
+    void restore(std::span<const Entry> states)
+    {
+        for (const Entry &e : states) {
+            Node &nd = node(e.id);
+            nd.pinned = e.pinned;
+            nd.value = e.value;
+        }
+    }
+
+    // --- JOURNAL (one step per RpnUndoLog step) ---
+
+    // `joined` as in the undo log's step, so both trim the same groups
+    void record(bool joined)
+    {
+        if (m_enabled) {
+            // Nodes only redo could bring back are gone with it
+            const bool branched = m_log.canRedo();
+            typename Journal::Step step;
+            step.joined = joined;
+            m_log.record(std::move(step), m_before, m_after);
+            if (branched) collect();
+        }
+        discard();
+    }
+
+    // Before an edit that will branch off the redo side: its walk should
+    // not reach nodes that only redo needs
+    void clearRedo()
+    {
+        if (!m_enabled || !m_log.canRedo()) return;
+        m_log.clearRedo();
+        collect();
+    }
+
+    // Changes made by undo/redo are not journaled again
+    void discard()
+    {
+        m_before.clear();
+        m_after.clear();
+    }
+
+    // Load the step's entries into before() / after()
+    void undo()
+    {
+        if (m_enabled) m_log.undo(m_stepBefore, m_stepAfter);
+    }
+
+    void redo()
+    {
+        if (m_enabled) m_log.redo(m_stepBefore, m_stepAfter);
+    }
+
+    const std::vector<Entry> &before() const { return m_stepBefore; }
+    const std::vector<Entry> &after() const { return m_stepAfter; }
+
+    static Id idIn(std::span<const Entry> entries, std::size_t i) { return i < entries.size() ? entries[i].id : 0; }
+
+private:
+    static constexpr std::size_t kMinCollect = 1024;
+    static constexpr Id kNone = std::numeric_limits<Id>::max();
+
+    struct Node {
+        Value value{};
+        std::uint64_t order = 0;  // creation order, 0 while free
+        std::uint64_t stamp = 0;  // recompute() that visited it last
+        Id in[2] = {};
+        Id slot = 0;              // stack index + 1, 0 off the stack
+        Id fresh = kNone;         // index into m_fresh while stamped
+        RpnOp op = RpnOp::Dup;
+        std::uint8_t arity = 0;   // 0: a plain number
+        bool pinned = false;
+        std::vector<Id> users;
+    };
+
+    struct Tag {};
+    using Journal = RpnUndoLog<Tag, Entry>;
+
+    Node &node(Id id) { return m_nodes[id - 1]; }
+    const Node &node(Id id) const { return m_nodes[id - 1]; }
+
+    const Value &valueOf(Id id) const
+    {
+        const Node &nd = node(id);
+        return nd.stamp == m_epoch && nd.fresh != kNone ? m_fresh[nd.fresh].second : nd.value;
+    }
+
+    void markFresh(Id id, Value v)
+    {
+        Node &nd = node(id);
+        nd.stamp = m_epoch;
+        nd.fresh = Id(m_fresh.size());
+        m_fresh.emplace_back(id, std::move(v));
+    }
+
+    void enqueueUsers(Id id)
+    {
+        for (const Id u : node(id).users) {
+            m_heap.emplace_back(node(u).order, u);
+            std::push_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+        }
+    }
+
+    // Slots from `from` moved; their nodes learn the new index
+    void renumber(std::size_t from, std::size_t to = std::numeric_limits<std::size_t>::max())
+    {
+        to = std::min(to, m_ids.size());
+        for (std::size_t i = from; i < to; ++i)
+            if (m_ids[i]) node(m_ids[i]).slot = Id(i + 1);
+    }
+
+    Id allocate()
+    {
+        if (m_free.empty() && m_nodes.size() >= m_collectAt) collect();
+        Id id = 0;
+        if (!m_free.empty()) {
+            id = m_free.back();
+            m_free.pop_back();
+        } else {
+            m_nodes.emplace_back();
+            id = Id(m_nodes.size());
+        }
+        node(id).order = ++m_order;
+        return id;
+    }
+
+    // Mark and sweep from the stack and both sides of the journal
+    void collect()
+    {
+        std::vector<bool> live(m_nodes.size() + 1, false);
+        std::vector<Id> pending;
+        const auto reach = [&](Id id) {
+            if (id && !live[id]) {
+                live[id] = true;
+                pending.push_back(id);
+            }
+        };
+        for (const Id id : m_ids) reach(id);
+        m_log.forEachValue([&](const Entry &e) { reach(e.id); });
+        for (const Entry &e : m_before) reach(e.id);
+        for (const Entry &e : m_after) reach(e.id);
+        while (!pending.empty()) {
+            const Node &nd = node(pending.back());
+            pending.pop_back();
+            for (int i = 0; i < nd.arity; ++i) reach(nd.in[i]);
+        }
+
+        std::size_t alive = 0;
+        for (Id id = 1; id <= Id(m_nodes.size()); ++id) {
+            Node &nd = node(id);
+            if (live[id]) {
+                ++alive;
+                std::erase_if(nd.users, [&](Id u) { return !live[u]; });
+            } else if (nd.order != 0) {
+                nd = Node{};
+                m_free.push_back(id);
+            }
+        }
+        m_collectAt = std::max(kMinCollect, alive * 2);
+    }
+
+    bool m_enabled = false;
+    std::vector<Node> m_nodes;
+    std::vector<Id> m_free;
+    std::vector<Id> m_ids;  // node of every stack slot, bottom to top
+    std::uint64_t m_order = 0;
+    std::size_t m_collectAt = kMinCollect;
+
+    Journal m_log;
+    std::vector<Entry> m_before;  // changes for the next record()
+    std::vector<Entry> m_after;
+    std::vector<Entry> m_stepBefore;  // entries of the step being undone/redone
+    std::vector<Entry> m_stepAfter;
+
+    std::uint64_t m_epoch = 0;
+    std::vector<std::pair<Id, Value>> m_fresh;
+    std::vector<std::pair<std::uint64_t, Id>> m_heap;
+};
@@ -1,38 +1,131 @@
 #include "rpnengine.h"
+#include "rpnparse.h"
+#include "rpnperf.h"
 #include <QLocale>
-#include <cmath>
 #include <QSettings>
+#include <QGuiApplication>
+#include <QClipboard>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <cmath>
+#include <span>
+
+namespace {
+
+QString bulkName(RpnBulkOp op)
+{
+    switch (op) {
+        case RpnBulkOp::Neg: return QStringLiteral("neg");
+        case RpnBulkOp::Sin: return QStringLiteral("sin");
+        case RpnBulkOp::Cos: return QStringLiteral("cos");
+        case RpnBulkOp::Scale: return QStringLiteral("scale");
+        case RpnBulkOp::Sum: return QStringLiteral("sum");
+        case RpnBulkOp::Product: return QStringLiteral("product");
+        case RpnBulkOp::Mean: return QStringLiteral("mean");
+        case RpnBulkOp::StdDev: return QStringLiteral("stddev");
+    }
+    return {};
+}
+
+// Values are converted, not recomputed: double -> decimal keeps the
+// shortest text of each double (0.1 stays 0.1). Only the active core holds
+// values. False when `job` was cancelled.
+bool convertStack(std::span<const double> doubles, std::span<const RpnDecimal> decimals, bool toDouble,
+                  const RpnDecimalContext &ctx, std::vector<double> &outDoubles,
+                  std::vector<RpnDecimal> &outDecimals, RpnJobControl *job)
+{
+    const std::size_t total = doubles.size() + decimals.size();
+    std::size_t done = 0;
+    const auto step = [&] { return !job || (done++ & 63) != 0 || job->step(done - 1, total); };
+    if (toDouble) {
+        outDoubles.assign(doubles.begin(), doubles.end());
+        for (const RpnDecimal &v : decimals) {
+            if (!step()) return false;
+            outDoubles.push_back(v.toDouble());
+        }
+    } else {
+        outDecimals.reserve(total);
+        for (double v : doubles) {
+            if (!step()) return false;
+            outDecimals.push_back(RpnDecimal::fromDouble(v).roundedTo(ctx));
+        }
+        for (const RpnDecimal &v : decimals) {
+            if (!step()) return false;
+            outDecimals.push_back(v.roundedTo(ctx));
+        }
+    }
+    return true;
+}
+
+// Where a field ends at or after `pos`, so big inputs parse in slices
+std::size_t fieldBoundary(std::string_view text, std::size_t pos)
+{
+    while (pos < text.size() && text[pos] != '\n' && text[pos] != '\t' && text[pos] != ';') ++pos;
+    return pos;
+}
+
+} // namespace
 
 QString RpnEngine::topAsString() const
 {
-    if (!m_model.has(1)) return QStringLiteral("-");
-    return m_model.data(m_model.index(0), RpnStackModel::ValueRole).toString();
+    // From the core: inside a transaction the model has not caught up yet
+    if (withCore([](const auto &core) { return core.size(); }) == 0) return QStringLiteral("-");
+    return m_model.textAt(0);
 }
 
-RpnEngine::RpnEngine(QObject *parent) : QObject(parent) {
+RpnEngine::RpnEngine(QObject *parent) : QObject(parent), m_model(&m_core) {
     m_model.setNumberFormat(m_formatMode, m_precision);
+    m_history.setNumberFormat(m_formatMode, m_precision);
+    // Anything appended to the history after a step is recorded belongs to it
+    m_core.setTagSource([this] { return m_history.mark(); });
+    m_decimal.setTagSource([this] { return m_history.mark(); });
+    // Edits recompute what was derived from the edited value
+    m_core.setTrackingEnabled(true);
+    m_decimal.setTrackingEnabled(true);
+
+    m_progressTimer.setInterval(100);
+    connect(&m_progressTimer, &QTimer::timeout, this, &RpnEngine::updateProgress);
+}
+
+RpnEngine::~RpnEngine()
+{
+    // m_worker waits for the job when it goes
+    if (m_job) m_job->cancel();
 }
 
 // --- HISTORY & ERRORS ---
 
 void RpnEngine::appendHistoryLine(const QString &line)
 {
-    if (m_historyText.isEmpty()) {
-        m_historyText = line;
-    } else {
-        // Newest on top
-        m_historyText = line + '\n' + m_historyText;
-    }
-    emit historyTextChanged();
+    appendHistory(RpnHistoryEntry::line(line));
+}
+
+void RpnEngine::appendHistory(const RpnHistoryEntry &entry)
+{
+    RPN_PERF_SCOPE("engine.history");
+    m_history.add(entry);
+    m_session.recordHistoryAdd(entry);
+    historyChanged();
 }
 
 void RpnEngine::clearHistory()
 {
-    if (m_historyText.isEmpty()) return; 
-    saveState();
+    if (deferWhileBusy([this] { clearHistory(); })) return;
+    if (m_history.rowCount() == 0) return;
+    const quint64 first = m_history.firstMark();
     m_history.clear();
-    m_historyText.clear();
-    emit historyTextChanged();
+    m_session.recordHistoryClear();
+    withCore([&](auto &core) { core.recordMarker(first); });
+    publish();
+    historyChanged();
+}
+
+void RpnEngine::copyHistory() const
+{
+    if (QClipboard *clipboard = QGuiApplication::clipboard())
+        clipboard->setText(m_history.text());
 }
 
 void RpnEngine::error(const QString &msg)
@@ -41,30 +134,198 @@ void RpnEngine::error(const QString &msg)
     emit errorOccurred(msg);
 }
 
-bool RpnEngine::require(int n)
+// --- CORE BRIDGE ---
+
+void RpnEngine::publish()
+{
+    if (m_transactionDepth > 0 || m_flushQueued) return;
+    flushChanges();
+}
+
+void RpnEngine::flushChanges()
+{
+    RPN_PERF_SCOPE("engine.publish");
+    const bool stackChanged = withCore([this](auto &core) {
+        const RpnStackChanges changes = core.takeChanges();
+        m_model.sync(changes);
+        {
+            RPN_PERF_SCOPE("session.journal");
+            m_session.recordStack(changes, core.values());
+        }
+        if (m_session.needsCompaction()) {
+            RPN_PERF_SCOPE("session.compact");
+            m_session.save(core.values(), m_history.lines());
+        }
+        return !changes.empty();
+    });
+
+    // A new step drops everything that could be redone
+    if (!canRedo()) m_redoLines.clear();
+
+    if (m_publishedUndo != canUndo()) {
+        m_publishedUndo = canUndo();
+        RPN_PERF_COUNT("engine.notify");
+        emit canUndoChanged();
+    }
+    if (m_publishedRedo != canRedo()) {
+        m_publishedRedo = canRedo();
+        RPN_PERF_COUNT("engine.notify");
+        emit canRedoChanged();
+    }
+    if (m_historyDirty) {
+        m_historyDirty = false;
+        RPN_PERF_COUNT("engine.notify");
+        emit historyTextChanged();
+    }
+    if (stackChanged && m_statsVisible) {
+        RPN_PERF_COUNT("engine.notify");
+        emit statsChanged();
+    }
+}
+
+void RpnEngine::historyChanged()
 {
-    if (!m_model.has(n)) {
-        error(QString("Not enough arguments on stack (need %1).").arg(n));
+    if (m_transactionDepth > 0 || m_flushQueued) {
+        m_historyDirty = true;
+        return;
+    }
+    RPN_PERF_COUNT("engine.notify");
+    emit historyTextChanged();
+}
+
+void RpnEngine::beginTransaction()
+{
+    if (deferWhileBusy([this] { beginTransaction(); }, 1)) return;
+    if (m_transactionDepth++ > 0) return;
+    // Both cores, so the group survives a backend switch inside it
+    m_core.beginGroup();
+    m_decimal.beginGroup();
+}
+
+void RpnEngine::commitTransaction()
+{
+    if (deferWhileBusy([this] { commitTransaction(); }, -1)) return;
+    if (m_transactionDepth == 0 || --m_transactionDepth > 0) return;
+    m_core.endGroup();
+    m_decimal.endGroup();
+
+    // Later transactions in the same tick ride along with this flush
+    if (m_flushQueued) return;
+    m_flushQueued = true;
+    QTimer::singleShot(0, this, [this] {
+        m_flushQueued = false;
+        flushChanges();
+    });
+}
+
+bool RpnEngine::run(RpnOp op)
+{
+    if (deferWhileBusy([this, op] { run(op); })) return true;
+    RPN_PERF_SCOPE("engine.op");
+    const RpnOpResult r = withCore([op](auto &core) { return core.apply(op); });
+    if (!r.ok()) {
+        error(QString::fromStdString(rpnErrorText(r)));
         return false;
     }
+    publish();
+    appendHistory(historyEntry(op, r));
+    if (m_recording) {
+        const std::string_view token = rpnOpToken(op);
+        recordToken(QString::fromLatin1(token.data(), qsizetype(token.size())));
+    }
     return true;
 }
 
-bool RpnEngine::pop2(double &a, double &b)
+bool RpnEngine::run(RpnBulkOp op)
 {
-    if (!require(2)) return false;
-    if (!m_model.pop(b)) return false;
-    if (!m_model.pop(a)) return false;
+    if (deferWhileBusy([this, op] { run(op); })) return true;
+    if (m_backend != DoubleBackend && m_decimal.size() >= kJobValues && canStartJob()) {
+        // The worker only computes the new values: the GUI keeps showing the
+        // stack as it was, and a cancelled op leaves it alone. They go on
+        // the stack as one step when done.
+        auto bulk = std::make_shared<RpnDecimalCore::BulkResult>();
+        startJob(QString("%1 over %2 values").arg(bulkName(op)).arg(m_decimal.size()), true,
+                 [this, bulk, op](RpnJobControl &job) { *bulk = m_decimal.computeBulk(op, &job); },
+                 [this, bulk, op] { finishBulk(op, m_decimal.applyBulk(std::move(*bulk))); });
+        return true;
+    }
+
+    RPN_PERF_SCOPE("engine.bulk");
+    return finishBulk(op, withCore([op](auto &core) { return core.apply(op); }));
+}
+
+bool RpnEngine::finishBulk(RpnBulkOp op, const RpnOpResult &r)
+{
+    if (!r.ok()) {
+        error(QString::fromStdString(rpnErrorText(r)));
+        return false;
+    }
+    breakRecording(QStringLiteral("A whole-stack operation"));
+    publish();
+    appendHistory(historyEntry(op, r));
     return true;
 }
 
+RpnHistoryEntry RpnEngine::historyEntry(RpnBulkOp op, const RpnOpResult &r) const
+{
+    RpnHistoryEntry e;
+    e.kind = RpnHistoryEntry::Kind::Bulk;
+    e.op = quint8(op);
+    e.count = r.operandCount;
+    switch (op) {
+        case RpnBulkOp::Neg: case RpnBulkOp::Sin: case RpnBulkOp::Cos:
+            break;
+        case RpnBulkOp::Scale:
+            e.result = r.result; // the factor
+            break;
+        case RpnBulkOp::Sum: case RpnBulkOp::Product:
+        case RpnBulkOp::Mean: case RpnBulkOp::StdDev:
+            setHistoryTop(e);
+            break;
+    }
+    return e;
+}
+
+RpnHistoryEntry RpnEngine::historyEntry(RpnOp op, const RpnOpResult &r) const
+{
+    RpnHistoryEntry e;
+    e.kind = RpnHistoryEntry::Kind::Op;
+    e.op = quint8(op);
+    e.operands[0] = r.operands[0];
+    e.operands[1] = r.operands[1];
+    if (op != RpnOp::Drop && op != RpnOp::Swap && op != RpnOp::Clear) setHistoryTop(e);
+    return e;
+}
+
+void RpnEngine::setHistoryTop(RpnHistoryEntry &entry) const
+{
+    // A double carries the value as is; decimal results keep their digits as text
+    if (m_backend != DoubleBackend) entry.text = topAsString();
+    else if (m_core.size() > 0) entry.result = m_core.at(0);
+}
+
 // --- CORE OPS ---
 
 bool RpnEngine::enter(const QString &text)
 {
+    const auto replay = [this, text] {
+        if (enter(text)) return;
+        dropDeferredTransaction();
+        emit inputRejected(text);
+    };
+    if (deferWhileBusy(replay)) return true;
+    RPN_PERF_SCOPE("engine.enter");
     bool ok = false;
-    // Use unified parser
-    const double v = RpnStackModel::parseInput(text, &ok);
+    if (m_backend == DoubleBackend) {
+        // Use unified parser
+        const double v = RpnStackModel::parseInput(text, &ok);
+        if (ok) m_core.push(v);
+    } else {
+        const QByteArray utf8 = text.toUtf8();
+        RpnDecimal v;
+        ok = rpnParseDecimal(std::string_view(utf8.constData(), std::size_t(utf8.size())), v, m_decimal.context());
+        if (ok) m_decimal.push(std::move(v));
+    }
 
     if (!ok) {
         if (!text.trimmed().isEmpty()) {
@@ -72,212 +333,678 @@ bool RpnEngine::enter(const QString &text)
         }
         return false;
     }
-    
-    saveState();
-    m_model.push(v);
+
+    publish();
     appendHistoryLine(QString("push %1").arg(text.trimmed()));
+    recordTop();
     return true;
 }
 
-void RpnEngine::add()
+void RpnEngine::recordTop()
 {
-    if (!require(2)) return;
-    saveState();
-    double a,b; pop2(a,b); 
-    m_model.push(a + b);
-    appendHistoryLine(QString("%1 %2 + -> %3").arg(a).arg(b).arg(topAsString()));
+    if (!m_recording) return;
+    const bool finite = m_backend == DoubleBackend ? std::isfinite(m_core.at(0)) : m_decimal.at(0).isFinite();
+    if (!finite) {
+        breakRecording(QStringLiteral("An infinite or NaN result"));
+        return;
+    }
+    recordToken(topToken());
 }
 
-void RpnEngine::sub()
+QString RpnEngine::topToken() const
 {
-    if (!require(2)) return;
-    saveState();
-    double a,b; pop2(a,b);
-    m_model.push(a - b);
-    appendHistoryLine(QString("%1 %2 - -> %3").arg(a).arg(b).arg(topAsString()));
+    // Normalised, so grouping spaces or a decimal comma survive a replay
+    return m_backend == DoubleBackend ? QString::number(m_core.at(0), 'g', 17)
+                                      : QString::fromStdString(m_decimal.at(0).toString());
 }
 
-void RpnEngine::mul()
+bool RpnEngine::evaluate(const QString &formula)
 {
-    if (!require(2)) return;
-    saveState();
-    double a,b; pop2(a,b);
-    m_model.push(a * b);
-    appendHistoryLine(QString("%1 %2 * -> %3").arg(a).arg(b).arg(topAsString()));
+    if (deferWhileBusy([this, formula] { evaluate(formula); })) return true;
+    RPN_PERF_SCOPE("engine.formula");
+    const QString key = formula.trimmed();
+    if (key.isEmpty()) return false;
+
+    FoldedFormula folded;
+    if (const auto cached = m_formulas.find(key); cached != m_formulas.end()) {
+        folded = cached.value();
+    } else {
+        const QByteArray utf8 = key.toUtf8();
+        RpnFormula::Error err;
+        const std::optional<RpnFormula> compiled = RpnFormula::compile(
+            std::string_view(utf8.constData(), std::size_t(utf8.size())), decimalSeparator() == QLatin1String(","), &err);
+        if (!compiled) {
+            // Offsets are UTF-8 bytes; report characters
+            error(QString("%1 (at %2)").arg(QString::fromStdString(err.message))
+                      .arg(QString::fromUtf8(utf8.left(qsizetype(err.offset))).size() + 1));
+            return false;
+        }
+
+        const RpnOpResult r = m_backend == DoubleBackend ? compiled->fold(folded.value)
+                                                         : compiled->fold(folded.decimal, m_decimal.context());
+        if (!r.ok()) {
+            error(QString::fromStdString(rpnErrorText(r)));
+            return false;
+        }
+        if (m_formulas.size() >= kMaxCachedFormulas) m_formulas.clear();
+        m_formulas.insert(key, folded);
+    }
+
+    if (m_backend == DoubleBackend) m_core.push(folded.value);
+    else m_decimal.push(folded.decimal);
+    publish();
+    appendHistoryLine(QString("%1 = %2").arg(key, topAsString()));
+    recordTop();
+    return true;
 }
 
-void RpnEngine::div()
+// --- STATISTICS ---
+
+const RpnStackStats &RpnEngine::currentStats(RpnStackStats &scratch) const
 {
-    if (!require(2)) return;
-    saveState();
-    double a,b; pop2(a,b);
-    if (b == 0.0) {
-        m_model.push(a); m_model.push(b);
-        if (!m_undoStack.isEmpty()) m_undoStack.removeLast();
-        emit canUndoChanged();
-        error("Division by zero.");
-        return;
-    }
-    m_model.push(a / b);
-    appendHistoryLine(QString("%1 %2 / -> %3").arg(a).arg(b).arg(topAsString()));
+    return withCore([&](const auto &core) -> const RpnStackStats & {
+        if (core.statsEnabled()) return core.stats();
+        for (const auto &v : core.values()) scratch.add(rpnToDouble(v));
+        return scratch;
+    });
 }
 
-void RpnEngine::pow()
+QVariantMap RpnEngine::stats() const
 {
-    if (!require(2)) return;
-    saveState();
-    double a,b; pop2(a,b);
-    m_model.push(std::pow(a, b));
-    appendHistoryLine(QString("%1 %2 pow -> %3").arg(a).arg(b).arg(topAsString()));
+    if (!m_statsVisible) return {};
+    RpnStackStats scratch;
+    const RpnStackStats &st = currentStats(scratch);
+    const auto text = [this](double v) { return std::isnan(v) ? QStringLiteral("-") : m_model.formatValue(v); };
+    return {
+        { QStringLiteral("count"), QString::number(st.count()) },
+        { QStringLiteral("sum"), text(st.sum()) },
+        { QStringLiteral("mean"), text(st.mean()) },
+        { QStringLiteral("min"), text(st.min()) },
+        { QStringLiteral("max"), text(st.max()) },
+        { QStringLiteral("variance"), text(st.variance()) },
+    };
 }
 
-void RpnEngine::root()
+bool RpnEngine::pushStat(const QString &name)
 {
-    if (!require(2)) return;
-    saveState();
-    double base, degree; 
-    pop2(base, degree); 
+    if (deferWhileBusy([this, name] { pushStat(name); })) return true;
+    RpnStackStats scratch;
+    const RpnStackStats &st = currentStats(scratch);
+    const std::size_t count = st.count();
 
-    if (degree == 0.0) {
-        m_model.push(base); m_model.push(degree);
-        if (!m_undoStack.isEmpty()) m_undoStack.removeLast();
-        emit canUndoChanged();
-        error("Root degree cannot be 0.");
-        return;
+    double value = 0.0;
+    std::size_t need = 1;
+    if (name == QLatin1String("count")) {
+        value = double(count);
+        need = 0;
+    } else if (name == QLatin1String("sum")) {
+        value = st.sum();
+        need = 0;
+    } else if (name == QLatin1String("mean")) {
+        value = st.mean();
+    } else if (name == QLatin1String("min")) {
+        value = st.min();
+    } else if (name == QLatin1String("max")) {
+        value = st.max();
+    } else if (name == QLatin1String("variance")) {
+        value = st.variance();
+        need = 2;
+    } else {
+        return false;
     }
-    double result = std::pow(base, 1.0 / degree);
-    if (!std::isfinite(result)) {
-        m_model.push(base); m_model.push(degree);
-        if (!m_undoStack.isEmpty()) m_undoStack.removeLast();
-        emit canUndoChanged();
-        error("Invalid root result.");
-        return;
+    if (count < need) {
+        RpnOpResult r;
+        r.error = RpnError::NotEnoughArgs;
+        r.need = int(need);
+        error(QString::fromStdString(rpnErrorText(r)));
+        return false;
     }
 
-    m_model.push(result);
-    appendHistoryLine(QString("%2 %1 root -> %3").arg(base).arg(degree).arg(topAsString()));
+    if (m_backend == DoubleBackend) {
+        m_core.push(value);
+    } else {
+        // Decimal stacks get their own digits, not the double readout
+        RpnDecimal exact;
+        if (name == QLatin1String("count")) {
+            exact = RpnDecimal::fromInt(std::int64_t(count));
+        } else if (name == QLatin1String("min") || name == QLatin1String("max")) {
+            const RpnDecimal *extreme = m_decimal.extreme(name == QLatin1String("max"));
+            exact = extreme ? *extreme : RpnDecimal::nan();
+        } else if (count > 0) {
+            const RpnBulkOp op = name == QLatin1String("sum")    ? RpnBulkOp::Sum
+                                 : name == QLatin1String("mean") ? RpnBulkOp::Mean
+                                                                 : RpnBulkOp::StdDev;
+            // Outside a job nothing cancels it
+            m_decimal.reduce(op, exact, op == RpnBulkOp::StdDev);
+        }
+        m_decimal.push(std::move(exact));
+    }
+    publish();
+    appendHistoryLine(QString("%1 of %2 values -> %3").arg(name).arg(count).arg(topAsString()));
+    // Replaying the number would not follow the stack it was taken from
+    breakRecording(QStringLiteral("A statistics push"));
+    return true;
 }
 
-void RpnEngine::sin()
+void RpnEngine::setStatsVisible(bool visible)
 {
-    if (!require(1)) return;
-    saveState();
-    double x; m_model.pop(x);
-    m_model.push(std::sin(x));
-    appendHistoryLine(QString("sin(%1) -> %2").arg(x).arg(topAsString()));
+    if (deferWhileBusy([this, visible] { setStatsVisible(visible); })) return;
+    if (m_statsVisible == visible) return;
+    m_statsVisible = visible;
+    // The inactive core is empty, so enabling both costs nothing
+    m_core.setStatsEnabled(visible);
+    m_decimal.setStatsEnabled(visible);
+    emit statsVisibleChanged();
+    emit statsChanged();
 }
 
-void RpnEngine::cos()
+// --- BULK IMPORT ---
+
+int RpnEngine::importUtf8(std::string_view text)
 {
-    if (!require(1)) return;
-    saveState();
-    double x; m_model.pop(x);
-    m_model.push(std::cos(x));
-    appendHistoryLine(QString("cos(%1) -> %2").arg(x).arg(topAsString()));
+    RPN_PERF_SCOPE("engine.import");
+    std::size_t rejected = 0;
+    if (m_backend == DoubleBackend) {
+        m_importBuffer.clear();
+        rpnParseNumbers(text, m_importBuffer, &rejected);
+    } else {
+        m_decimalImportBuffer.clear();
+        rpnParseDecimals(text, m_decimalImportBuffer, m_decimal.context(), &rejected);
+    }
+    return pushImported(rejected);
 }
 
-void RpnEngine::neg()
+int RpnEngine::pushImported(std::size_t rejected)
 {
-    if (!require(1)) return;
-    saveState();
-    double x; m_model.pop(x);
-    m_model.push(-x);
-    appendHistoryLine(QString("neg(%1) -> %2").arg(x).arg(topAsString()));
+    std::size_t count = 0;
+    if (m_backend == DoubleBackend) {
+        // One undo step, one row insertion for the whole batch
+        m_core.pushMany(m_importBuffer);
+        count = m_importBuffer.size();
+        // Don't hold on to the memory of a huge import
+        if (m_importBuffer.capacity() > 65536) m_importBuffer = {};
+    } else {
+        m_decimal.pushMany(m_decimalImportBuffer);
+        count = m_decimalImportBuffer.size();
+        m_decimalImportBuffer = {};
+    }
+
+    if (count > 0) {
+        publish();
+        appendHistoryLine(QString("import %1 values -> %2").arg(count).arg(topAsString()));
+        breakRecording(QStringLiteral("An import"));
+    }
+    if (rejected > 0) error(QString("Skipped %1 invalid values.").arg(rejected));
+    return int(count);
 }
 
-void RpnEngine::reciprocal()
+int RpnEngine::importNumbers(const QString &text)
 {
-    if (!require(1)) return;
-    
-    // Check 0 before saveState logic? 
-    // Usually saveState first, then logic. But let's check first to avoid bad states.
-    // However, to be safe:
-    saveState();
-    double x; m_model.pop(x);
-    
-    if (x == 0.0) {
-        m_model.push(x);
-        if (!m_undoStack.isEmpty()) m_undoStack.removeLast();
-        emit canUndoChanged();
-        error("Division by zero (1/x).");
-        return;
+    if (deferWhileBusy([this, text] { importNumbers(text); })) return -1;
+    const QByteArray utf8 = text.toUtf8();
+    return importUtf8(std::string_view(utf8.constData(), std::size_t(utf8.size())));
+}
+
+int RpnEngine::pasteNumbers()
+{
+    const QClipboard *clipboard = QGuiApplication::clipboard();
+    if (!clipboard) return 0;
+    return importNumbers(clipboard->text());
+}
+
+int RpnEngine::importFile(const QUrl &file)
+{
+    if (deferWhileBusy([this, file] { importFile(file); })) return -1;
+    QFile f(file.isLocalFile() ? file.toLocalFile() : file.toString());
+    if (!f.open(QIODevice::ReadOnly)) {
+        error(QString("Cannot open %1.").arg(f.fileName()));
+        return 0;
+    }
+    if (f.size() >= kJobBytes && canStartJob()) {
+        // Parsed on the worker in slices, for progress; pushed here
+        struct Parsed {
+            std::vector<double> values;
+            std::vector<RpnDecimal> decimals;
+            std::size_t rejected = 0;
+        };
+        auto parsed = std::make_shared<Parsed>();
+        const QString path = f.fileName();
+        const bool decimal = m_backend != DoubleBackend;
+        const RpnDecimalContext ctx = m_decimal.context();
+        f.close();
+        startJob(QString("Importing %1").arg(QFileInfo(path).fileName()), true,
+                 [parsed, path, decimal, ctx](RpnJobControl &job) {
+                     QFile in(path);
+                     if (!in.open(QIODevice::ReadOnly)) return;
+                     const std::size_t total = std::size_t(in.size());
+                     const auto parse = [&](std::string_view slice) {
+                         std::size_t rejected = 0;
+                         if (decimal) rpnParseDecimals(slice, parsed->decimals, ctx, &rejected);
+                         else rpnParseNumbers(slice, parsed->values, &rejected);
+                         parsed->rejected += rejected;
+                     };
+                     constexpr std::size_t kSlice = std::size_t(1) << 18;
+                     // Mapped like the synchronous path, so the file is never held in memory
+                     if (const uchar *data = in.map(0, in.size())) {
+                         const std::string_view text(reinterpret_cast<const char *>(data), total);
+                         for (std::size_t pos = 0; pos < text.size();) {
+                             if (!job.step(pos, text.size())) break;
+                             const std::size_t end = fieldBoundary(text, std::min(text.size(), pos + kSlice));
+                             parse(text.substr(pos, end - pos));
+                             pos = end;
+                         }
+                         in.unmap(const_cast<uchar *>(data));
+                         return;
+                     }
+                     // Otherwise read a slice at a time; a field cut at the end of
+                     // one slice is carried over to the next
+                     QByteArray buffer;
+                     std::size_t done = 0;
+                     for (;;) {
+                         if (!job.step(done, total)) return;
+                         const QByteArray chunk = in.read(qint64(kSlice));
+                         if (chunk.isEmpty()) break;
+                         done += std::size_t(chunk.size());
+                         buffer += chunk;
+                         const std::string_view text(buffer.constData(), std::size_t(buffer.size()));
+                         const std::size_t end = text.find_last_of("\n\t;");
+                         if (end == std::string_view::npos) continue;
+                         parse(text.substr(0, end));
+                         buffer.remove(0, qsizetype(end));
+                     }
+                     parse(std::string_view(buffer.constData(), std::size_t(buffer.size())));
+                 },
+                 [this, parsed] {
+                     m_importBuffer = std::move(parsed->values);
+                     m_decimalImportBuffer = std::move(parsed->decimals);
+                     RPN_PERF_SCOPE("engine.import");
+                     pushImported(parsed->rejected);
+                 });
+        return -1;
     }
-    m_model.push(1.0 / x);
-    appendHistoryLine(QString("1/%1 -> %2").arg(x).arg(topAsString()));
+    // Parse straight from the mapped file; read it only if mapping fails
+    if (f.size() > 0) {
+        if (const uchar *data = f.map(0, f.size())) {
+            const int count = importUtf8(std::string_view(reinterpret_cast<const char *>(data), std::size_t(f.size())));
+            f.unmap(const_cast<uchar *>(data));
+            return count;
+        }
+    }
+    const QByteArray bytes = f.readAll();
+    return importUtf8(std::string_view(bytes.constData(), std::size_t(bytes.size())));
 }
 
-void RpnEngine::dup()
+int RpnEngine::opForKey(const QString &key) const
 {
-    if (!m_model.has(1)) { error("Empty stack (dup)."); return; }
-    saveState();
-    m_model.dupTop();
-    appendHistoryLine(QString("dup -> %1").arg(topAsString()));
+    const QByteArray utf8 = key.toUtf8();
+    const std::optional<RpnOp> op = rpnOpFromKey(std::string_view(utf8.constData(), std::size_t(utf8.size())));
+    return op ? int(*op) : -1;
 }
 
-void RpnEngine::drop()
+int RpnEngine::opForShortcut(const QString &key) const
 {
-    if (!m_model.has(1)) { error("Empty stack (drop)."); return; }
-    saveState();
-    m_model.dropTop();
-    appendHistoryLine("drop");
+    const QByteArray utf8 = key.toLower().toUtf8();
+    const std::optional<RpnOp> op = rpnOpFromShortcut(std::string_view(utf8.constData(), std::size_t(utf8.size())));
+    return op ? int(*op) : -1;
 }
 
-void RpnEngine::clearAll()
+QStringList RpnEngine::opShortcuts() const
+{
+    QStringList keys;
+    for (const RpnOpInfo &info : kRpnOps)
+        if (!info.key.empty()) keys << QString::fromUtf8(info.key.data(), qsizetype(info.key.size()));
+    return keys;
+}
+
+QString RpnEngine::opLabel(int op) const
 {
-    if (!m_model.has(1)) return;
-    saveState();
-    m_model.clearAll();
-    appendHistoryLine("clear");
+    if (op < 0 || std::size_t(op) >= kRpnOps.size()) return {};
+    const std::string_view label = kRpnOps[std::size_t(op)].label;
+    return QString::fromUtf8(label.data(), qsizetype(label.size()));
 }
 
-void RpnEngine::pushPi()
+bool RpnEngine::applyOp(int op)
 {
-    saveState();
-    m_model.push(M_PI);
-    appendHistoryLine(QString("push pi -> %1").arg(topAsString()));
+    if (op < 0 || std::size_t(op) >= kRpnOps.size()) return false;
+    return run(RpnOp(op));
 }
 
-void RpnEngine::pushE()
+void RpnEngine::clearAll()
 {
-    saveState();
-    m_model.push(M_E);
-    appendHistoryLine(QString("push e -> %1").arg(topAsString()));
+    if (deferWhileBusy([this] { clearAll(); })) return;
+    if (withCore([](const auto &core) { return core.size(); }) == 0) return;
+    run(RpnOp::Clear);
 }
 
+void RpnEngine::negAll() { run(RpnBulkOp::Neg); }
+void RpnEngine::sinAll() { run(RpnBulkOp::Sin); }
+void RpnEngine::cosAll() { run(RpnBulkOp::Cos); }
+void RpnEngine::scaleAll() { run(RpnBulkOp::Scale); }
+void RpnEngine::sumAll() { run(RpnBulkOp::Sum); }
+void RpnEngine::productAll() { run(RpnBulkOp::Product); }
+void RpnEngine::meanAll() { run(RpnBulkOp::Mean); }
+void RpnEngine::stddevAll() { run(RpnBulkOp::StdDev); }
+
 bool RpnEngine::modifyStackValue(int row, const QString &text)
 {
+    if (deferWhileBusy([this, row, text] { modifyStackValue(row, text); })) return true;
+    if (row < 0 || std::size_t(row) >= withCore([](const auto &core) { return core.size(); })) return false;
+
     // 1. Get OLD value
-    QModelIndex idx = m_model.index(row);
-    QString oldValue = m_model.data(idx, RpnStackModel::ValueRole).toString();
+    QString oldValue = m_model.textAt(row);
 
-    // 2. Save Undo state
-    saveState();
+    // 2. Try to change value and everything derived from it (this also clears Redo)
+    bool ok = false;
+    RpnOpResult r;
+    if (m_backend == DoubleBackend) {
+        const double v = RpnStackModel::parseInput(text, &ok);
+        if (ok) r = m_core.edit(std::size_t(row), v);
+    } else {
+        const QByteArray utf8 = text.toUtf8();
+        RpnDecimal v;
+        ok = rpnParseDecimal(std::string_view(utf8.constData(), std::size_t(utf8.size())), v, m_decimal.context());
+        if (ok) r = m_decimal.edit(std::size_t(row), std::move(v));
+    }
+    if (!ok) return false;
+    if (!r.ok()) {
+        // A value derived from this one cannot take the new input
+        error(QString::fromStdString(rpnErrorText(r)));
+        return false;
+    }
+    publish();
 
-    // 3. Try to change value
-    bool success = m_model.setValueAt(row, text);
+    // 3. Get NEW value
+    QString newValue = m_model.textAt(row);
 
-    if (success) {
-        // --- SUCCESS ---
-        
-        // Clear Redo
-        m_redoStack.clear();
-        emit canUndoChanged();
-        emit canRedoChanged();
+    // 4. Use the same function as other operations (appendHistoryLine)
+    // This ensures the entry goes to the TOP of the list
+    QString line = QStringLiteral("%1 edit -> %2").arg(oldValue, newValue);
+    if (r.operandCount > 0) line += QStringLiteral(" (%1 updated)").arg(r.operandCount);
+    appendHistoryLine(line);
+    breakRecording(QStringLiteral("An edit"));
+    return true;
+}
+
+void RpnEngine::removeStackAt(int row)
+{
+    if (deferWhileBusy([this, row] { removeStackAt(row); })) return;
+    if (row < 0 || !withCore([row](auto &core) { return core.removeAt(std::size_t(row)); })) return;
+    publish();
+    breakRecording(QStringLiteral("Removing a row"));
+}
+
+bool RpnEngine::moveStackUp(int row)
+{
+    if (deferWhileBusy([this, row] { moveStackUp(row); })) return true;
+    if (row < 0 || !withCore([row](auto &core) { return core.moveUp(std::size_t(row)); })) return false;
+    publish();
+    breakRecording(QStringLiteral("Moving a row"));
+    return true;
+}
+
+bool RpnEngine::moveStackDown(int row)
+{
+    if (deferWhileBusy([this, row] { moveStackDown(row); })) return true;
+    if (row < 0 || !withCore([row](auto &core) { return core.moveDown(std::size_t(row)); })) return false;
+    publish();
+    breakRecording(QStringLiteral("Moving a row"));
+    return true;
+}
+
+bool RpnEngine::runProgram(const QString &source)
+{
+    if (deferWhileBusy([this, source] { runProgram(source); })) return true;
+    // Programs are compiled to double bytecode (rpnprogram.h)
+    if (m_backend != DoubleBackend) {
+        error(QStringLiteral("Programs need the double backend."));
+        return false;
+    }
+    if (!m_program || m_programSource != source) {
+        const QByteArray utf8 = source.toUtf8();
+        RpnProgram::CompileError err;
+        m_program = RpnProgram::compile(std::string_view(utf8.constData(), std::size_t(utf8.size())), &err);
+        if (!m_program) {
+            m_programSource.clear();
+            error(QString("%1 (token %2: %3)").arg(QString::fromStdString(err.message))
+                      .arg(err.token + 1).arg(QString::fromStdString(err.text)));
+            return false;
+        }
+        m_programSource = source;
+    }
+    if (m_program->empty()) return false;
+
+    if (!runCompiled(*m_program, QString("run %1").arg(source.simplified()))) return false;
+    recordToken(source.simplified());
+    return true;
+}
+
+bool RpnEngine::runCompiled(const RpnProgram &program, const QString &label)
+{
+    RPN_PERF_SCOPE("engine.program");
+    const RpnRunResult r = m_core.run(program);
+    publish();
+    if (r.executed > 0)
+        appendHistoryLine(QString("%1 -> %2").arg(label, topAsString()));
+    if (!r.ok()) {
+        RpnOpResult failed;
+        failed.error = r.error;
+        failed.need = r.need;
+        if (r.executed > 0) breakRecording(QStringLiteral("A program that failed halfway"));
+        error(QString("%1 (token %2)").arg(QString::fromStdString(rpnErrorText(failed))).arg(r.pc + 1));
+        return false;
+    }
+    return true;
+}
+
+// Decimal backends: the same tokens, one core call each. Stops at the first
+// failing token; the ones before it stay applied, like RpnProgram::run().
+bool RpnEngine::runTokens(std::string_view source, const QString &label)
+{
+    RPN_PERF_SCOPE("engine.program");
+    std::size_t token = 0;
+    std::size_t executed = 0;
+    RpnOpResult failed;
+    std::string_view text;
+    const char *s = source.data();
+    const char *end = s + source.size();
+    for (;; ++token) {
+        while (s != end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')) ++s;
+        if (s == end) break;
+        const char *start = s;
+        while (s != end && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r') ++s;
+        text = std::string_view(start, std::size_t(s - start));
+
+        RpnDecimal v;
+        if (rpnParseDecimal(text, v, m_decimal.context())) {
+            m_decimal.push(std::move(v));
+        } else if (const std::optional<RpnOp> op = rpnOpFromToken(text)) {
+            failed = m_decimal.apply(*op);
+            if (!failed.ok()) break;
+        } else {
+            failed.error = RpnError::InvalidNumber;
+            break;
+        }
+        ++executed;
+    }
+    publish();
+    if (executed > 0)
+        appendHistoryLine(QString("%1 -> %2").arg(label, topAsString()));
+    if (!failed.ok()) {
+        if (executed > 0) breakRecording(QStringLiteral("A program that failed halfway"));
+        error(QString("%1 (token %2: %3)").arg(QString::fromStdString(rpnErrorText(failed))).arg(token + 1)
+                  .arg(QString::fromUtf8(text.data(), qsizetype(text.size()))));
+        return false;
+    }
+    return true;
+}
+
+// --- MACROS ---
+
+void RpnEngine::recordMacro()
+{
+    if (deferWhileBusy([this] { recordMacro(); })) return;
+    m_recording = true;
+    m_macroTokens.clear();
+    emit macrosChanged();
+}
+
+void RpnEngine::cancelMacro()
+{
+    if (deferWhileBusy([this] { cancelMacro(); })) return;
+    if (!m_recording) return;
+    m_recording = false;
+    m_macroTokens.clear();
+    emit macrosChanged();
+}
 
-        // 4. Get NEW value
-        QString newValue = m_model.data(idx, RpnStackModel::ValueRole).toString();
+bool RpnEngine::saveMacro(const QString &key)
+{
+    if (deferWhileBusy([this, key] { saveMacro(key); })) return true;
+    if (!m_recording || key.isEmpty()) return false;
+    m_recording = false;
+    const QString source = m_macroTokens.join(QLatin1Char(' '));
+    m_macroTokens.clear();
+    if (source.isEmpty()) {
+        emit macrosChanged();
+        return false;
+    }
+    m_macros.insert(key, Macro{ source, std::nullopt });
+    storeMacros();
+    appendHistoryLine(QString("macro %1 = %2").arg(key, source));
+    emit macrosChanged();
+    emit macroSaved(key);
+    return true;
+}
 
-        // 5. Use the same function as other operations (appendHistoryLine)
-        // This ensures the entry goes to the TOP of the list
-        appendHistoryLine(QStringLiteral("%1 edit -> %2").arg(oldValue, newValue));
+bool RpnEngine::runMacro(const QString &key)
+{
+    if (deferWhileBusy([this, key] { runMacro(key); })) return true;
+    const auto it = m_macros.find(key);
+    if (it == m_macros.end()) return false;
 
+    const QString label = QString("macro %1").arg(key);
+    bool ok = false;
+    beginTransaction();
+    if (m_backend == DoubleBackend) {
+        if (!it->program) {
+            const QByteArray utf8 = it->source.toUtf8();
+            RpnProgram::CompileError err;
+            it->program = RpnProgram::compile(std::string_view(utf8.constData(), std::size_t(utf8.size())), &err);
+            if (!it->program)
+                error(QString("%1: %2 (token %3: %4)").arg(label, QString::fromStdString(err.message))
+                          .arg(err.token + 1).arg(QString::fromStdString(err.text)));
+        }
+        ok = it->program && runCompiled(*it->program, label);
     } else {
-        if (!m_undoStack.isEmpty()) {
-            m_undoStack.pop_back(); 
+        const QByteArray utf8 = it->source.toUtf8();
+        ok = runTokens(std::string_view(utf8.constData(), std::size_t(utf8.size())), label);
+    }
+    commitTransaction();
+    // Recording a macro that runs another one inlines it
+    if (ok) recordToken(it->source);
+    return ok;
+}
+
+QString RpnEngine::macroSource(const QString &key) const
+{
+    return m_macros.value(key).source;
+}
+
+void RpnEngine::recordToken(const QString &token)
+{
+    if (m_recording) m_macroTokens.append(token);
+}
+
+void RpnEngine::breakRecording(const QString &what)
+{
+    if (!m_recording) return;
+    cancelMacro();
+    error(QString("%1 cannot be recorded; macro recording stopped.").arg(what));
+}
+
+void RpnEngine::storeMacros() const
+{
+    QVariantMap map;
+    for (auto it = m_macros.cbegin(); it != m_macros.cend(); ++it) map.insert(it.key(), it->source);
+    QSettings s("marek2001", "RpnCalcQuick");
+    s.setValue("session/macros", map);
+}
+
+// --- BACKGROUND JOBS ---
+
+bool RpnEngine::canStartJob() const
+{
+    return !m_job && m_transactionDepth == 0 && !m_flushQueued;
+}
+
+void RpnEngine::startJob(const QString &text, bool cancellable,
+                         std::function<void(RpnJobControl &)> work, std::function<void()> land)
+{
+    auto job = std::make_shared<RpnJobControl>();
+    RpnEngineJob posted{
+        [job, work] { work(*job); },
+        [this, job, land] {
+            m_job.reset();
+            m_progressTimer.stop();
+            emit busyChanged();
+            if (job->cancelled()) error(QString::fromStdString(rpnErrorText(RpnError::Cancelled)));
+            else land();
+            replayDeferred();
         }
+    };
+    if (!canStartJob() || !m_worker.post(posted)) {
+        work(*job);
+        land();
+        return;
+    }
+
+    m_job = job;
+    m_jobText = text;
+    m_jobCancellable = cancellable;
+    m_progress = -1.0;
+    m_progressTimer.start();
+    emit busyChanged();
+    emit progressChanged();
+}
+
+void RpnEngine::cancelJob()
+{
+    if (m_job && m_jobCancellable) m_job->cancel();
+}
+
+bool RpnEngine::deferWhileBusy(std::function<void()> call, int nesting)
+{
+    if (!m_job) return false;
+    m_deferred.append(Deferred{ std::move(call), nesting });
+    return true;
+}
+
+void RpnEngine::replayDeferred()
+{
+    // Stops when a replayed call starts the next job; the rest wait for it
+    while (!m_job && !m_deferred.isEmpty()) m_deferred.takeFirst().call();
+}
+
+void RpnEngine::dropDeferredTransaction()
+{
+    if (m_transactionDepth == 0) return;
+    // Transactions opened later in the queue go whole
+    int depth = 0;
+    while (!m_deferred.isEmpty()) {
+        const int nesting = m_deferred.first().nesting;
+        if (nesting < 0 && depth == 0) return;
+        depth += nesting;
+        m_deferred.removeFirst();
     }
+}
 
-    return success;
+void RpnEngine::updateProgress()
+{
+    if (!m_job) return;
+    const double p = m_job->progress();
+    if (p == m_progress) return;
+    m_progress = p;
+    emit progressChanged();
 }
 
 // --- STATE & SETTINGS ---
@@ -289,82 +1016,246 @@ void RpnEngine::setFormatMode(int mode)
     m_formatMode = mode;
     emit formatModeChanged();
     m_model.setNumberFormat(m_formatMode, m_precision);
+    m_history.setNumberFormat(m_formatMode, m_precision);
+    if (m_statsVisible) emit statsChanged();
 }
 
 void RpnEngine::setPrecision(int p)
 {
-    if (p < 0) p = 0; else if (p > 17) p = 17;
+    if (p < 0) p = 0; else if (p > maxPrecision()) p = maxPrecision();
     if (m_precision == p) return;
     m_precision = p;
     emit precisionChanged();
     m_model.setNumberFormat(m_formatMode, m_precision);
+    m_history.setNumberFormat(m_formatMode, m_precision);
+    if (m_statsVisible) emit statsChanged();
 }
 
-void RpnEngine::saveState()
+int RpnEngine::maxPrecision() const
 {
-    m_undoStack.push_back(captureState());
-    if (!m_redoStack.isEmpty()) {
-        m_redoStack.clear();
-        emit canRedoChanged();
+    return m_backend == DoubleBackend ? 17 : m_decimal.context().digits;
+}
+
+int RpnEngine::maxInputDigits() const
+{
+    // A double holds 15 significant digits reliably
+    return m_backend == DoubleBackend ? 15 : m_decimal.context().digits;
+}
+
+RpnDecimalContext RpnEngine::decimalContext(int backend, int digits) const
+{
+    if (backend == ArbitraryBackend) return RpnDecimalContext::arbitrary(digits);
+    return RpnDecimalContext::decimal128();
+}
+
+void RpnEngine::setBackend(int backend)
+{
+    if (deferWhileBusy([this, backend] { setBackend(backend); })) return;
+    if (backend < DoubleBackend || backend > ArbitraryBackend || backend == m_backend) return;
+    switchBackend(backend, m_arbitraryDigits);
+}
+
+void RpnEngine::setArbitraryDigits(int digits)
+{
+    if (deferWhileBusy([this, digits] { setArbitraryDigits(digits); })) return;
+    digits = qBound(1, digits, RpnDecimalContext::kMaxDigits);
+    if (digits == m_arbitraryDigits) return;
+    if (m_backend == ArbitraryBackend) {
+        switchBackend(m_backend, digits);
+    } else {
+        m_arbitraryDigits = digits;
+        emit backendChanged();
     }
-    if (m_undoStack.size() > 100) m_undoStack.removeFirst();
-    emit canUndoChanged();
 }
 
-void RpnEngine::undo()
+void RpnEngine::switchBackend(int backend, int digits)
 {
-    if (m_undoStack.isEmpty()) return;
-    m_redoStack.push_back(captureState());
-    restoreState(m_undoStack.takeLast());
-    emit canUndoChanged();
-    emit canRedoChanged();
+    const RpnDecimalContext ctx = decimalContext(backend, digits);
+    const std::size_t count = m_core.size() + m_decimal.size();
+    if (count >= kJobValues && canStartJob()) {
+        auto doubles = std::make_shared<std::vector<double>>();
+        auto decimals = std::make_shared<std::vector<RpnDecimal>>();
+        startJob(QString("Converting %1 values").arg(count), true,
+                 [this, doubles, decimals, backend, ctx](RpnJobControl &job) {
+                     convertStack(m_core.values(), m_decimal.values(), backend == DoubleBackend, ctx,
+                                  *doubles, *decimals, &job);
+                 },
+                 [this, doubles, decimals, backend, digits] {
+                     applyBackend(backend, digits, std::move(*doubles), std::move(*decimals));
+                 });
+        return;
+    }
+
+    std::vector<double> doubles;
+    std::vector<RpnDecimal> decimals;
+    convertStack(m_core.values(), m_decimal.values(), backend == DoubleBackend, ctx, doubles, decimals, nullptr);
+    applyBackend(backend, digits, std::move(doubles), std::move(decimals));
 }
 
-void RpnEngine::redo()
+void RpnEngine::applyBackend(int backend, int digits, std::vector<double> doubles, std::vector<RpnDecimal> decimals)
 {
-    if (m_redoStack.isEmpty()) return;
-    m_undoStack.push_back(captureState());
-    restoreState(m_redoStack.takeLast());
-    emit canUndoChanged();
-    emit canRedoChanged();
+    m_arbitraryDigits = digits;
+    const RpnDecimalContext ctx = decimalContext(backend, digits);
+
+    // Empties the inactive core; recorded steps of both refer to the old values
+    m_backend = backend;
+    m_decimal.setContext(ctx);
+    m_core.restore(std::move(doubles));
+    m_decimal.restore(std::move(decimals));
+    // The model is reset instead of being told about every slot
+    m_core.takeChanges();
+    m_decimal.takeChanges();
+    m_model.setDecimalSource(backend == DoubleBackend ? nullptr : &m_decimal);
+    m_redoLines.clear();
+    // Folded for the old backend (and precision)
+    m_formulas.clear();
+
+    // The user's precision stays; only capped at what the backend keeps
+    setPrecision(m_precision);
+    publish();
+    emit backendChanged();
+
+    // The stack changed representation: journal patches would not apply to
+    // the current snapshot, so start a new one
+    if (m_session.isOpen()) {
+        const QString name = backend == DoubleBackend ? QStringLiteral("double")
+                             : backend == Decimal128Backend ? QStringLiteral("decimal128")
+                                                            : QString("%1 digits").arg(digits);
+        appendHistoryLine(QString("numbers: %1").arg(name));
+        withCore([this](const auto &core) { m_session.save(core.values(), m_history.lines()); });
+    }
 }
 
-RpnEngine::EngineState RpnEngine::captureState() const
+void RpnEngine::undo()
 {
-    return { m_model.snapshot(), m_historyText };
+    if (deferWhileBusy([this] { undo(); })) return;
+    if (m_transactionDepth > 0) {
+        error(QStringLiteral("Cannot undo inside a transaction."));
+        return;
+    }
+    RPN_PERF_SCOPE("engine.undo");
+    const auto step = withCore([](auto &core) { return core.undo(); });
+    if (!step) return;
+    publish();
+
+    // Lines added since the step (including later errors) go with it
+    m_redoLines.append(m_history.takeSince(step->tag));
+    m_session.recordHistoryDrop(m_redoLines.last().size());
+    if (step->marker) {
+        const quint64 first = m_history.firstMark();
+        m_history.restoreFirst(step->aux);
+        m_session.recordHistoryPrepend(m_history.lines(m_history.firstMark(), first));
+    }
+    historyChanged();
+    breakRecording(QStringLiteral("Undo"));
 }
 
-void RpnEngine::restoreState(const EngineState &s)
+void RpnEngine::redo()
 {
-    m_model.restore(s.stack);
-    m_historyText = s.historyText;
-    emit historyTextChanged();
+    if (deferWhileBusy([this] { redo(); })) return;
+    if (m_transactionDepth > 0) {
+        error(QStringLiteral("Cannot redo inside a transaction."));
+        return;
+    }
+    RPN_PERF_SCOPE("engine.redo");
+    const auto step = withCore([](auto &core) { return core.redo(); });
+    if (!step) return;
+    const QList<RpnHistoryEntry> entries = m_redoLines.isEmpty() ? QList<RpnHistoryEntry>() : m_redoLines.takeLast();
+    publish();
+
+    if (step->marker) {
+        m_history.clear();
+        m_session.recordHistoryClear();
+    }
+    m_history.append(entries);
+    for (const RpnHistoryEntry &entry : entries) m_session.recordHistoryAdd(entry);
+    historyChanged();
+    breakRecording(QStringLiteral("Redo"));
 }
 
-void RpnEngine::saveSessionState() const
+void RpnEngine::saveSessionState()
 {
+    RPN_PERF_SCOPE("engine.saveState");
     QSettings s("marek2001", "RpnCalcQuick");
-    const QVector<double> snap = m_model.snapshot();
-    QVariantList list;
-    for (double v : snap) list.push_back(v);
-    s.setValue("session/stack", list);
-    s.setValue("session/historyText", m_historyText);
     s.setValue("session/formatMode", m_formatMode);
+    s.setValue("session/precision", m_precision);
+    s.setValue("session/backend", m_backend);
+    s.setValue("session/arbitraryDigits", m_arbitraryDigits);
+    s.setValue("session/statsVisible", m_statsVisible);
+    // Folds the journal into a fresh snapshot. Not before the session was
+    // loaded (it may still be loading), and while another job runs the
+    // stack as it was before the job: that is what the journal holds.
+    if (!m_session.isOpen()) return;
+    withCore([this](const auto &core) { m_session.save(core.values(), m_history.lines()); });
 }
 
 void RpnEngine::loadSessionState()
 {
+    if (deferWhileBusy([this] { loadSessionState(); })) return;
     QSettings s("marek2001", "RpnCalcQuick");
     setFormatMode(s.value("session/formatMode", m_formatMode).toInt());
+    setStatsVisible(s.value("session/statsVisible", m_statsVisible).toBool());
+    const QVariantMap macros = s.value("session/macros").toMap();
+    m_macros.clear();
+    for (auto it = macros.cbegin(); it != macros.cend(); ++it)
+        m_macros.insert(it.key(), Macro{ it.value().toString(), std::nullopt });
+    emit macrosChanged();
 
+    // Nothing is on the stack yet, so this only picks the core
+    const int backend = s.value("session/backend", m_backend).toInt();
+    switchBackend(backend >= DoubleBackend && backend <= ArbitraryBackend ? backend : DoubleBackend,
+                  qBound(1, s.value("session/arbitraryDigits", m_arbitraryDigits).toInt(), RpnDecimalContext::kMaxDigits));
+    // After the backend, which decides how many digits there are to show
+    setPrecision(s.value("session/precision", m_precision).toInt());
 
-    const QVariantList list = s.value("session/stack").toList();
-    QVector<double> snap;
-    for (const QVariant &item : list) snap.push_back(item.toDouble());
-    m_model.restore(snap);
+    // The files are read on the worker, so a big session does not hold up
+    // the first frame; calls made meanwhile wait for it
+    struct Loaded {
+        std::vector<double> snap;
+        std::vector<RpnDecimal> decimals;
+        QList<RpnHistoryEntry> history;
+        bool found = false;
+    };
+    auto loaded = std::make_shared<Loaded>();
+    RpnSession *session = &m_session;
+    startJob(QStringLiteral("Loading session"), false,
+             [loaded, session](RpnJobControl &) {
+                 loaded->found = session->load(loaded->snap, loaded->decimals, loaded->history);
+             },
+             [this, loaded] {
+                 QSettings s("marek2001", "RpnCalcQuick");
+                 std::vector<double> &snap = loaded->snap;
+                 std::vector<RpnDecimal> &decimals = loaded->decimals;
+                 const bool migrate = !loaded->found && s.contains("session/stack");
+                 if (migrate) {
+                     // Older versions kept the session in QSettings, TOP first
+                     const QVariantList list = s.value("session/stack").toList();
+                     snap.reserve(std::size_t(list.size()));
+                     for (auto it = list.crbegin(); it != list.crend(); ++it) snap.push_back(it->toDouble());
+                     m_history.setText(s.value("session/historyText", "").toString());
+                 }
 
-    m_historyText = s.value("session/historyText", "").toString();
-    emit historyTextChanged();
+                 // Also drops the undo log: recorded steps refer to the old stack.
+                 // A stack saved by the other kind of backend is converted.
+                 if (m_backend == DoubleBackend) {
+                     for (const RpnDecimal &v : decimals) snap.push_back(v.toDouble());
+                     m_core.restore(std::move(snap));
+                 } else {
+                     for (double v : snap) decimals.push_back(RpnDecimal::fromDouble(v));
+                     for (RpnDecimal &v : decimals) v = v.roundedTo(m_decimal.context());
+                     m_decimal.restore(std::move(decimals));
+                 }
+                 publish();
+                 if (!migrate) m_history.setEntries(loaded->history);
+                 historyChanged();
+
+                 // Only changes made from here on go to the journal
+                 if (migrate && withCore([&](const auto &core) { return m_session.save(core.values(), m_history.lines()); })) {
+                     s.remove("session/stack");
+                     s.remove("session/historyText");
+                 }
+                 m_session.open();
+             });
 }
 
 bool RpnEngine::isKde() const
@@ -1,10 +1,24 @@
 #pragma once
 #include <QObject>
+#include <QHash>
 #include <QList>
+#include <QMap>
 #include <QLocale>
+#include <QTimer>
+#include <QUrl>
+#include <QVariantMap>
 
+#include <functional>
+#include <memory>
+
+#include "rpncore.h"
+#include "rpninfix.h"
+#include "rpnprogram.h"
 #include "rpnstackmodel.h"
 #include "rpnhistorymodel.h"
+#include "rpnsession.h"
+#include "rpnperfmonitor.h"
+#include "rpnengineworker.h"
 
 class RpnEngine : public QObject
 {
@@ -13,55 +27,149 @@ class RpnEngine : public QObject
     Q_PROPERTY(int formatMode READ formatMode WRITE setFormatMode NOTIFY formatModeChanged)
     Q_PROPERTY(int precision READ precision WRITE setPrecision NOTIFY precisionChanged)
     Q_PROPERTY(RpnHistoryModel* historyModel READ historyModel CONSTANT)
+    // Latency overlay and JSON dump (RPNCALC_PERF builds)
+    Q_PROPERTY(RpnPerfMonitor* perf READ perf CONSTANT)
     Q_PROPERTY(QString historyText READ historyText NOTIFY historyTextChanged)
     Q_PROPERTY(bool canUndo READ canUndo NOTIFY canUndoChanged)
     Q_PROPERTY(bool canRedo READ canRedo NOTIFY canRedoChanged)
     Q_PROPERTY(QString decimalSeparator READ decimalSeparator CONSTANT)
     Q_PROPERTY(bool isKde READ isKde CONSTANT)
+    Q_PROPERTY(int backend READ backend WRITE setBackend NOTIFY backendChanged)
+    Q_PROPERTY(int arbitraryDigits READ arbitraryDigits WRITE setArbitraryDigits NOTIFY backendChanged)
+    // Significant digits the active backend keeps (input length limit)
+    Q_PROPERTY(int maxInputDigits READ maxInputDigits NOTIFY backendChanged)
+    Q_PROPERTY(bool recordingMacro READ recordingMacro NOTIFY macrosChanged)
+    // Keys that have a macro bound, sorted
+    Q_PROPERTY(QStringList macroKeys READ macroKeys NOTIFY macrosChanged)
+    // Live stack statistics, kept up to date by the core while shown
+    Q_PROPERTY(bool statsVisible READ statsVisible WRITE setStatsVisible NOTIFY statsVisibleChanged)
+    // count, sum, mean, min, max, variance as display text ("-" if undefined)
+    Q_PROPERTY(QVariantMap stats READ stats NOTIFY statsChanged)
+    // Long work (decimal whole-stack ops and backend switches on big stacks,
+    // big imports, loading the session) runs on the engine worker meanwhile
+    Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
+    Q_PROPERTY(QString busyText READ busyText NOTIFY busyChanged)
+    Q_PROPERTY(bool busyCancellable READ busyCancellable NOTIFY busyChanged)
+    // 0..1, or -1 while unknown
+    Q_PROPERTY(double progress READ progress NOTIFY progressChanged)
     
     int formatMode() const { return m_formatMode; }
     int precision() const { return m_precision; }
-    QString historyText() const { return m_historyText; }
+    // Built on demand; the UI shows historyModel instead
+    QString historyText() const { return m_history.text(); }
     
 public:
+    // How stack values are stored and computed
+    enum Backend {
+        DoubleBackend = 0,      // IEEE double, SIMD bulk ops, programs
+        Decimal128Backend = 1,  // 34 decimal digits, exact decimal input
+        ArbitraryBackend = 2    // arbitraryDigits() decimal digits
+    };
+    Q_ENUM(Backend)
+
     explicit RpnEngine(QObject *parent = nullptr);
+    ~RpnEngine() override;
+
+    int backend() const { return m_backend; }
+    int arbitraryDigits() const { return m_arbitraryDigits; }
+    int maxInputDigits() const;
 
     RpnStackModel* stackModel() { return &m_model; }
     RpnHistoryModel* historyModel() { return &m_history; }
+    RpnPerfMonitor* perf() { return &m_perf; }
     bool isKde() const;
 
+    // While a job runs, this and the other calls below are queued and
+    // replayed in order when it is done. A queued enter() reports true; if
+    // it fails when replayed, the rest of its transaction is dropped, as
+    // it would have been right away, and the text comes back through
+    // inputRejected().
     Q_INVOKABLE bool enter(const QString &text);
+    // Infix formula, e.g. "(3+4)*sin(pi/6)" (rpninfix.h), folded to one
+    // value and pushed as one step. Folded values are cached by text.
+    Q_INVOKABLE bool evaluate(const QString &formula);
 
-    // Binary operations
-    Q_INVOKABLE void add();
-    Q_INVOKABLE void sub();
-    Q_INVOKABLE void mul();
-    Q_INVOKABLE void div();
-    Q_INVOKABLE void pow();
-    Q_INVOKABLE void root(); // New: n-th root
-
-    // Unary operations / Functions
-    Q_INVOKABLE void sin();
-    Q_INVOKABLE void cos();
-    Q_INVOKABLE void neg();
-    Q_INVOKABLE void reciprocal(); // New: 1/x
-
-    // Stack ops
-    Q_INVOKABLE void dup();
-    Q_INVOKABLE void drop();
+    // Bulk import: numbers separated by line breaks, tabs or ';', pushed in
+    // order as one undo step. Return how many values were added, or -1
+    // when queued behind a running job or, for a large file, run as one
+    // (the count then goes to the history).
+    Q_INVOKABLE int importNumbers(const QString &text);
+    Q_INVOKABLE int importFile(const QUrl &file);
+    Q_INVOKABLE int pasteNumbers();
+
+    // Stack operations come from the registry (kRpnOps): the UI resolves a
+    // keypad label or keyboard key to an op index once, then applies it by
+    // index. -1 if nothing matches.
+    Q_INVOKABLE int opForKey(const QString &key) const;
+    // Keyboard side of the same table: the op bound to a key, every bound
+    // key, and the keypad label an op is shown under ("" if none)
+    Q_INVOKABLE int opForShortcut(const QString &key) const;
+    Q_INVOKABLE QStringList opShortcuts() const;
+    Q_INVOKABLE QString opLabel(int op) const;
+    Q_INVOKABLE bool applyOp(int op);
     Q_INVOKABLE void clearAll();
 
-    // Constants
-    Q_INVOKABLE void pushPi();
-    Q_INVOKABLE void pushE();
+    // Whole-stack operations (one undo step and one model update each)
+    Q_INVOKABLE void negAll();
+    Q_INVOKABLE void sinAll();
+    Q_INVOKABLE void cosAll();
+    Q_INVOKABLE void scaleAll();   // top value scales the rest
+    Q_INVOKABLE void sumAll();
+    Q_INVOKABLE void productAll();
+    Q_INVOKABLE void meanAll();
+    Q_INVOKABLE void stddevAll();
+
+    // Stack reordering from the UI (undoable)
+    Q_INVOKABLE void removeStackAt(int row);
+    Q_INVOKABLE bool moveStackUp(int row);
+    Q_INVOKABLE bool moveStackDown(int row);
+
+    // Compiles an RPN program ("3 4 + 5 *") and runs it as one undoable step
+    Q_INVOKABLE bool runProgram(const QString &source);
+
+    // Everything between beginTransaction() and commitTransaction() is one
+    // undo step, and views and bindings hear about it once, at the end of the
+    // event-loop tick. Transactions nest; undo()/redo() inside one report an error.
+    Q_INVOKABLE void beginTransaction();
+    Q_INVOKABLE void commitTransaction();
+
+    // Macros: pushes and ops are captured as an RPN program while recording,
+    // then bound to a key. Whole-stack ops, edits, reordering, import and
+    // undo/redo cannot be replayed that way and cancel the recording.
+    Q_INVOKABLE void recordMacro();
+    Q_INVOKABLE void cancelMacro();
+    // Ends the recording and binds it to `key` (replacing what was there).
+    // macroSaved() confirms it, also when the call was queued.
+    Q_INVOKABLE bool saveMacro(const QString &key);
+    // Replays in one transaction: compiled bytecode on the double backend,
+    // a token loop over the core on the decimal ones
+    Q_INVOKABLE bool runMacro(const QString &key);
+    Q_INVOKABLE QString macroSource(const QString &key) const;
+    bool recordingMacro() const { return m_recording; }
+    QStringList macroKeys() const { return m_macros.keys(); }
+
+    bool statsVisible() const { return m_statsVisible; }
+    QVariantMap stats() const;
+    // Pushes one of the stats() keys as a value (one undo step)
+    Q_INVOKABLE bool pushStat(const QString &name);
+
+    // While busy, calls that change the stack, history or settings wait
+    // for the job and then run in the order they were made
+    bool busy() const { return m_job != nullptr; }
+    QString busyText() const { return m_jobText; }
+    bool busyCancellable() const { return m_job && m_jobCancellable; }
+    double progress() const { return m_progress; }
+    // The stack stays as it was before the job
+    Q_INVOKABLE void cancelJob();
 
     Q_INVOKABLE void clearHistory();
+    Q_INVOKABLE void copyHistory() const;
     Q_INVOKABLE void undo();
     Q_INVOKABLE void redo();
-    bool canUndo() const { return !m_undoStack.isEmpty(); }
-    bool canRedo() const { return !m_redoStack.isEmpty(); }
+    bool canUndo() const { return m_backend == DoubleBackend ? m_core.canUndo() : m_decimal.canUndo(); }
+    bool canRedo() const { return m_backend == DoubleBackend ? m_core.canRedo() : m_decimal.canRedo(); }
 
-    Q_INVOKABLE void saveSessionState() const;
+    Q_INVOKABLE void saveSessionState();
     Q_INVOKABLE void loadSessionState();
     QString topAsString() const;
 
@@ -76,32 +184,165 @@ signals:
     void historyTextChanged();
     void canUndoChanged();
     void canRedoChanged();
+    void backendChanged();
+    void macrosChanged();
+    void macroSaved(const QString &key);
+    // A queued enter() failed when it was replayed
+    void inputRejected(const QString &text);
+    void statsVisibleChanged();
+    void statsChanged();
+    void busyChanged();
+    void progressChanged();
 
 public slots:
     void setFormatMode(int mode);
     void setPrecision(int p);
+    // Converts the stack to the new backend; drops the undo log
+    void setBackend(int backend);
+    void setArbitraryDigits(int digits);
+    void setStatsVisible(bool visible);
 
 private:
+    // Calculation state lives in the core; the models only present it.
+    // Only the core of the active backend holds values.
+    RpnCore m_core;
+    RpnDecimalCore m_decimal;
+    int m_backend = DoubleBackend;
+    int m_arbitraryDigits = 50;
     RpnStackModel m_model;
     RpnHistoryModel m_history;
-    QString m_historyText;
+    // Journals every published change; snapshot written by saveSessionState()
+    RpnSession m_session;
+    RpnPerfMonitor m_perf;
     
     int m_formatMode = RpnStackModel::Simple;
     int m_precision  = 15;
     
-    bool require(int n);
+    // Calls f(core) with the core of the active backend
+    template <typename F>
+    decltype(auto) withCore(F &&f)
+    {
+        if (m_backend == DoubleBackend) return f(m_core);
+        return f(m_decimal);
+    }
+    template <typename F>
+    decltype(auto) withCore(F &&f) const
+    {
+        if (m_backend == DoubleBackend) return f(m_core);
+        return f(m_decimal);
+    }
+
+    RpnDecimalContext decimalContext(int backend, int digits) const;
+    void switchBackend(int backend, int digits);
+    // The second half of switchBackend(), with the stack already converted
+    void applyBackend(int backend, int digits, std::vector<double> doubles, std::vector<RpnDecimal> decimals);
+    int maxPrecision() const;
+
     void error(const QString &msg);
-    bool pop2(double &a, double &b);
     void appendHistoryLine(const QString &line);
+    void appendHistory(const RpnHistoryEntry &entry);
+
+    // Runs one core op; on success publishes it and logs its history line
+    int importUtf8(std::string_view text);
+    // Pushes the import buffer of the active backend as one step
+    int pushImported(std::size_t rejected);
+
+    bool run(RpnOp op);
+    bool run(RpnBulkOp op);
+    // Error, or the history line and publish of a bulk op that succeeded
+    bool finishBulk(RpnBulkOp op, const RpnOpResult &r);
+    // Records, not text: formatted only when the history is shown
+    RpnHistoryEntry historyEntry(RpnOp op, const RpnOpResult &r) const;
+    RpnHistoryEntry historyEntry(RpnBulkOp op, const RpnOpResult &r) const;
+    // Sets the entry's result to the new top value
+    void setHistoryTop(RpnHistoryEntry &entry) const;
+    // Sends everything the core changed to the views in one batch; inside a
+    // transaction (or with a flush queued) the queued flush does it
+    void publish();
+    void flushChanges();
+    void historyChanged();
+
+    bool runCompiled(const RpnProgram &program, const QString &label);
+    bool runTokens(std::string_view source, const QString &label);
+
+    struct Macro {
+        QString source;
+        std::optional<RpnProgram> program; // compiled on first double-backend run
+    };
+    QMap<QString, Macro> m_macros;
+    bool m_recording = false;
+    QStringList m_macroTokens;
+    void recordToken(const QString &token);
+    // An edit the recording cannot replay
+    void breakRecording(const QString &what);
+    void storeMacros() const;
+
+    // Folded formulas of the active backend, by trimmed text
+    struct FoldedFormula {
+        double value = 0.0;
+        RpnDecimal decimal;
+    };
+    static constexpr int kMaxCachedFormulas = 1024;
+    QHash<QString, FoldedFormula> m_formulas;
+    // The top value as a token that reads back exactly (macro recording)
+    QString topToken() const;
+    // Records the pushed top value; infinity and NaN have no token the
+    // parser accepts, so they stop the recording instead
+    void recordTop();
+
+    bool m_statsVisible = false;
+    // Statistics of the active core; computed into `scratch` while the core
+    // does not keep them
+    const RpnStackStats &currentStats(RpnStackStats &scratch) const;
+
+    // Last compiled program, reused while the source is unchanged
+    QString m_programSource;
+    std::optional<RpnProgram> m_program;
+
+    // History lines taken out by undo, waiting for redo (newest step last)
+    QList<QList<RpnHistoryEntry>> m_redoLines;
+    std::vector<double> m_importBuffer;
+    std::vector<RpnDecimal> m_decimalImportBuffer;
+    bool m_publishedUndo = false;
+    bool m_publishedRedo = false;
+
+    int m_transactionDepth = 0;
+    bool m_flushQueued = false;
+    bool m_historyDirty = false; // historyTextChanged held back until the flush
+
+    // --- BACKGROUND JOBS ---
+    // Decimal values (or file bytes) from which work goes to the worker
+    static constexpr std::size_t kJobValues = 2000;
+    static constexpr qint64 kJobBytes = qint64(1) << 20;
+
+    // Outside transactions and pending flushes only, so the cores are
+    // published and nothing holds a group open across the job
+    bool canStartJob() const;
+    // `work` runs on the worker; it may read the cores, which stay as they
+    // are until the job lands, and nothing else of the engine. `land` then
+    // applies the result here, unless the job was cancelled. Runs both
+    // right away when no job can start.
+    void startJob(const QString &text, bool cancellable,
+                  std::function<void(RpnJobControl &)> work, std::function<void()> land);
+    // True when `call` was queued behind the running job. `nesting` is +1
+    // for beginTransaction() and -1 for commitTransaction().
+    bool deferWhileBusy(std::function<void()> call, int nesting = 0);
+    void replayDeferred();
+    // A replayed enter() failed inside a transaction: drops the calls queued
+    // for the rest of it, up to the commit that closes it
+    void dropDeferredTransaction();
+    void updateProgress();
 
-    // Undo/Redo
-    void saveState(); 
-    struct EngineState {
-        QVector<double> stack;
-        QString historyText;
+    std::shared_ptr<RpnJobControl> m_job;
+    QString m_jobText;
+    bool m_jobCancellable = false;
+    double m_progress = -1.0;
+    QTimer m_progressTimer;
+    struct Deferred {
+        std::function<void()> call;
+        int nesting = 0;
     };
-    EngineState captureState() const;
-    void restoreState(const EngineState& s);
-    QVector<EngineState> m_undoStack;
-    QVector<EngineState> m_redoStack;
-};
\ No newline at end of file
+    QList<Deferred> m_deferred;
+    // Last: destroyed (and its thread joined) before what a job may read
+    RpnEngineWorker m_worker;
+};
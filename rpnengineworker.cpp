@@ -0,0 +1,40 @@
+#include "rpnengineworker.h"
+
+RpnEngineWorker::RpnEngineWorker(QObject *parent)
+    : QObject(parent)
+    , m_thread([this] { loop(); })
+{
+}
+
+RpnEngineWorker::~RpnEngineWorker()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+    m_posted.fetch_add(1, std::memory_order_release);
+    m_posted.notify_one();
+    m_thread.join();
+}
+
+bool RpnEngineWorker::post(RpnEngineJob job)
+{
+    if (!m_jobs.push(job)) return false;
+    m_posted.fetch_add(1, std::memory_order_release);
+    m_posted.notify_one();
+    return true;
+}
+
+void RpnEngineWorker::loop()
+{
+    quint32 seen = m_posted.load(std::memory_order_acquire);
+    for (;;) {
+        while (std::optional<RpnEngineJob> job = m_jobs.pop()) {
+            if (m_stop.load(std::memory_order_relaxed)) return;
+            job->work();
+            // Runs on the worker object's thread; Qt drops it if the object is gone
+            QMetaObject::invokeMethod(this, std::move(job->done), Qt::QueuedConnection);
+        }
+        if (m_stop.load(std::memory_order_relaxed)) return;
+        // Sleeps until post() bumps the counter past what this pass saw
+        m_posted.wait(seen, std::memory_order_acquire);
+        seen = m_posted.load(std::memory_order_acquire);
+    }
+}
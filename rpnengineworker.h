@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QObject>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "rpnspscqueue.h"
+
+// Work RpnEngine hands off the GUI thread. `work` runs on the worker and
+// must only touch what the job owns (copies, never the engine); `done`
+// runs afterwards on the worker object's thread and applies the result.
+struct RpnEngineJob {
+    std::function<void()> work;
+    std::function<void()> done;
+};
+
+// Runs engine jobs one after the other on a thread of its own. The GUI
+// thread posts through a lock-free queue and wakes the worker with an
+// atomic notify; results come back as queued calls, in post order.
+class RpnEngineWorker final : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RpnEngineWorker(QObject *parent = nullptr);
+    // Waits for the job in progress; cancel it first
+    ~RpnEngineWorker() override;
+
+    // From the thread the worker object lives in; false when the queue is full
+    bool post(RpnEngineJob job);
+
+private:
+    void loop();
+
+    RpnSpscQueue<RpnEngineJob, 16> m_jobs;
+    std::atomic<quint32> m_posted{ 0 }; // bumped on every post and on shutdown
+    std::atomic<bool> m_stop{ false };
+    std::thread m_thread;               // last: starts once the rest is set up
+};
@@ -0,0 +1,212 @@
+#include "rpnformatter.h"
+
+#include <QtGlobal>
+#include <charconv>
+#include <cmath>
+
+namespace {
+constexpr int kMinPow10 = -330;
+constexpr int kMaxPow10 = 310;
+}
+
+RpnFormatter::RpnFormatter(const QLocale &locale)
+{
+    setLocale(locale);
+}
+
+void RpnFormatter::setLocale(const QLocale &locale)
+{
+    m_locale = locale;
+    m_decimalPoint = locale.decimalPoint();
+    m_groupSeparator = locale.groupSeparator();
+    m_negativeSign = locale.negativeSign();
+    m_asciiDigits = locale.zeroDigit() == QStringLiteral("0");
+
+    // Learn where the locale puts group separators (including locales that
+    // skip grouping for short numbers or group unevenly) by formatting 10^(n-1)
+    m_groups.fill(0);
+    if (!m_asciiDigits || m_groupSeparator.isEmpty()) return;
+    for (int n = 1; n <= kMaxGroupedDigits; ++n) {
+        const QString probe = locale.toString(pow10(n - 1), 'f', 0);
+        quint32 mask = 0;
+        int digits = 0;
+        for (qsizetype i = 0; i < probe.size();) {
+            if (probe.at(i).isDigit()) {
+                ++digits;
+                ++i;
+            } else if (probe.mid(i, m_groupSeparator.size()) == m_groupSeparator) {
+                if (digits > 0) mask |= 1u << (digits - 1);
+                i += m_groupSeparator.size();
+            } else {
+                ++i;
+            }
+        }
+        m_groups[n] = mask;
+    }
+}
+
+void RpnFormatter::setFormat(int mode, int precision)
+{
+    if (mode < 0 || mode > 2) mode = 0;
+    m_mode = static_cast<Mode>(mode);
+    // format(double) clamps again to what a double holds
+    m_precision = qBound(0, precision, RpnDecimalContext::kMaxDigits);
+}
+
+double RpnFormatter::pow10(int exp)
+{
+    // Same values std::pow(10, exp) gives, computed once
+    static const auto table = [] {
+        std::array<double, kMaxPow10 - kMinPow10 + 1> t{};
+        for (int e = kMinPow10; e <= kMaxPow10; ++e) t[e - kMinPow10] = std::pow(10.0, e);
+        return t;
+    }();
+    if (exp < kMinPow10 || exp > kMaxPow10) return std::pow(10.0, exp);
+    return table[exp - kMinPow10];
+}
+
+QString RpnFormatter::localeFixed(double v, int decimals) const
+{
+    QString s = m_locale.toString(v, 'f', decimals);
+    if (s.contains(m_decimalPoint)) {
+        while (s.endsWith('0')) s.chop(1);
+        if (s.endsWith(m_decimalPoint)) s.chop(m_decimalPoint.length());
+    }
+    if (s == m_negativeSign + QLatin1Char('0')) s = QStringLiteral("0");
+    return s;
+}
+
+QString RpnFormatter::fixed(double v, int decimals) const
+{
+    char buf[512];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, decimals);
+    // Non-ASCII digits: let QLocale do it
+    QString out;
+    if (!m_asciiDigits || res.ec != std::errc() || !grouped(buf, res.ptr, out)) return localeFixed(v, decimals);
+    return out;
+}
+
+QString RpnFormatter::fixed(const RpnDecimal &v, int decimals) const
+{
+    QString out;
+    if (m_asciiDigits) {
+        const std::string s = v.toFixed(decimals);
+        if (grouped(s.data(), s.data() + s.size(), out)) return out;
+    }
+    // QLocale has no decimal type; only reached for non-ASCII digits
+    return localeFixed(v.toDouble(), decimals);
+}
+
+bool RpnFormatter::grouped(const char *p, const char *end, QString &out) const
+{
+    const bool negative = (*p == '-');
+    if (negative) ++p;
+
+    const char *dot = p;
+    while (dot != end && *dot != '.') ++dot;
+
+    // Remove trailing zeros (e.g. "1.500" -> "1.5"), then a bare point
+    const char *fracEnd = end;
+    if (dot != end) {
+        while (fracEnd > dot + 1 && fracEnd[-1] == '0') --fracEnd;
+        if (fracEnd == dot + 1) fracEnd = dot;
+    }
+
+    const int intDigits = int(dot - p);
+    bool allZero = true;
+    for (const char *c = p; c != fracEnd; ++c)
+        if (*c != '0' && *c != '.') { allZero = false; break; }
+
+    // Beyond the probed grouping table (not reachable from format())
+    if (intDigits > kMaxGroupedDigits) return false;
+
+    out.clear();
+    out.reserve(int(fracEnd - p) + intDigits / 3 + 2);
+    // "-0" after rounding is shown as "0"
+    if (negative && !allZero) out += m_negativeSign;
+
+    const quint32 groups = m_groups[intDigits];
+    for (int i = 0; i < intDigits; ++i) {
+        out += QLatin1Char(p[i]);
+        if (groups & (1u << i)) out += m_groupSeparator;
+    }
+    if (fracEnd != dot) {
+        out += m_decimalPoint;
+        out += QLatin1String(dot + 1, fracEnd - dot - 1);
+    }
+    return true;
+}
+
+QString RpnFormatter::exponent(double v, int exp, int decimals) const
+{
+    const double mant = v / pow10(exp);
+    return fixed(mant, decimals) + QStringLiteral(" * 10^") + QString::number(exp);
+}
+
+QString RpnFormatter::exponent(const RpnDecimal &v, int exp, int decimals) const
+{
+    return fixed(v.scaledByPow10(-exp), decimals) + QStringLiteral(" * 10^") + QString::number(exp);
+}
+
+QString RpnFormatter::format(double v) const
+{
+    if (!std::isfinite(v)) return QStringLiteral("NaN");
+    if (v == 0.0) return QStringLiteral("0");
+
+    const double absV = std::abs(v);
+
+    switch (m_mode) {
+        case Scientific: {
+            const int exp = static_cast<int>(std::floor(std::log10(absV)));
+            // Scientific always has 1 digit before decimal point.
+            // Safe max after decimal is 15 - 1 = 14.
+            return exponent(v, exp, qBound(0, m_precision, 14));
+        }
+        case Engineering: {
+            int exp = static_cast<int>(std::floor(std::log10(absV)));
+            exp = (exp / 3) * 3; // Round exponent to multiple of 3
+            const double absMant = absV / pow10(exp);
+
+            // Mantissa in engineering mode can be e.g. 1.2, 12.3 or 123.4:
+            // keep the total at 15 significant digits
+            int intDigits = 1;
+            if (absMant >= 100.0) intDigits = 3;
+            else if (absMant >= 10.0) intDigits = 2;
+            return exponent(v, exp, qBound(0, m_precision, 15 - intDigits));
+        }
+        case Simple:
+        default: {
+            // If number is very large or very small, force scientific notation
+            if (absV >= 1.0e15 || absV < 1.0e-15) {
+                const int exp = static_cast<int>(std::floor(std::log10(absV)));
+                return exponent(v, exp, 14);
+            }
+            // Normal mode - max 15 digits
+            return fixed(v, qBound(0, m_precision, 15));
+        }
+    }
+}
+
+QString RpnFormatter::format(const RpnDecimal &v, int digits) const
+{
+    if (!v.isFinite()) return QStringLiteral("NaN");
+    if (v.isZero()) return QStringLiteral("0");
+
+    // Same layout as format(double), with `digits` in place of its 15
+    const int exp = v.adjustedExponent();
+    switch (m_mode) {
+        case Scientific:
+            return exponent(v, exp, qBound(0, m_precision, digits - 1));
+        case Engineering: {
+            const int engExp = (exp / 3) * 3;
+            const int intDigits = qMax(1, exp - engExp + 1);
+            return exponent(v, engExp, qBound(0, m_precision, digits - intDigits));
+        }
+        case Simple:
+        default:
+            // Grouping is only probed up to kMaxGroupedDigits integer digits
+            if (exp >= qMin(digits, kMaxGroupedDigits) || exp < -digits)
+                return exponent(v, exp, digits - 1);
+            return fixed(v, qBound(0, m_precision, digits));
+    }
+}
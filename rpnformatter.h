@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QLocale>
+#include <QString>
+
+#include <array>
+
+#include "rpndecimal.h"
+
+// Turns stack values into display text (Scientific / Engineering / Simple).
+// Locale symbols and digit grouping are resolved once in setLocale(), and
+// digits come from std::to_chars, so format() does no locale lookups.
+class RpnFormatter
+{
+public:
+    // Same values as RpnStackModel::NumberFormat
+    enum Mode {
+        Scientific = 0,
+        Engineering = 1,
+        Simple = 2
+    };
+
+    explicit RpnFormatter(const QLocale &locale = QLocale::system());
+
+    void setLocale(const QLocale &locale);
+    void setFormat(int mode, int precision);
+
+    Mode mode() const { return m_mode; }
+    int precision() const { return m_precision; }
+
+    QString format(double v) const;
+    // Decimal backends: `digits` is the backend's precision and takes the
+    // place of the 15 significant digits a double can show
+    QString format(const RpnDecimal &v, int digits) const;
+
+private:
+    // Like QLocale::toString(v, 'f', decimals) followed by trailing zero removal
+    QString fixed(double v, int decimals) const;
+    QString fixed(const RpnDecimal &v, int decimals) const;
+    // Groups the plain "-123.4500" text in [p, end); false if too long to group
+    bool grouped(const char *p, const char *end, QString &out) const;
+    QString localeFixed(double v, int decimals) const;
+    QString exponent(double v, int exp, int decimals) const;
+    QString exponent(const RpnDecimal &v, int exp, int decimals) const;
+    static double pow10(int exp);
+
+    static constexpr int kMaxGroupedDigits = 24;
+
+    QLocale m_locale;
+    QString m_decimalPoint;
+    QString m_groupSeparator;
+    QString m_negativeSign;
+    bool m_asciiDigits = true;
+    // Bit k of m_groups[n] = separator after the k-th digit of an n-digit integer part
+    std::array<quint32, kMaxGroupedDigits + 1> m_groups{};
+
+    Mode m_mode = Scientific;
+    int m_precision = 6;
+};
@@ -0,0 +1,67 @@
+#include "rpnformatworker.h"
+
+#include <limits>
+
+RpnFormatWorker::RpnFormatWorker(QObject *parent)
+    : QObject(parent)
+    , m_thread([this] { loop(); })
+{
+}
+
+RpnFormatWorker::~RpnFormatWorker()
+{
+    {
+        const std::lock_guard lock(m_mutex);
+        m_stop = true;
+        m_latest = std::numeric_limits<quint64>::max(); // abandons the job in progress
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void RpnFormatWorker::post(RpnFormatJob job)
+{
+    {
+        const std::lock_guard lock(m_mutex);
+        if (job.generation > m_latest) {
+            m_latest = job.generation;
+            m_jobs.clear();
+        }
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void RpnFormatWorker::loop()
+{
+    for (;;) {
+        RpnFormatJob job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_stop) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        QStringList texts;
+        texts.reserve(job.size());
+        bool abandoned = false;
+        for (int i = 0; i < job.size(); ++i) {
+            // The model has moved on; its results would be thrown away
+            if ((i & 63) == 0 && m_latest.load(std::memory_order_relaxed) != job.generation) {
+                abandoned = true;
+                break;
+            }
+            texts.append(job.decimal ? job.formatter.format(job.decimals[std::size_t(i)], job.digits)
+                                     : job.formatter.format(job.values[std::size_t(i)]));
+        }
+        if (abandoned) continue;
+
+        // Runs on the worker object's thread; Qt drops it if the object is gone
+        QMetaObject::invokeMethod(this, [this, generation = job.generation, id = job.id,
+                                         texts = std::move(texts)] {
+            emit formatted(generation, id, texts);
+        }, Qt::QueuedConnection);
+    }
+}
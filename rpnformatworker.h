@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rpndecimal.h"
+#include "rpnformatter.h"
+
+// A window of stack slots to format. Values and formatter are copies, so
+// the worker never reads the core or the model.
+struct RpnFormatJob {
+    quint64 generation = 0;  // model format the values were copied under
+    quint64 id = 0;          // the model's handle for the result
+    RpnFormatter formatter;
+    bool decimal = false;
+    int digits = 0;                     // decimal backend precision
+    std::vector<double> values;         // double backend
+    std::vector<RpnDecimal> decimals;   // decimal backends
+
+    int size() const { return int(decimal ? decimals.size() : values.size()); }
+};
+
+// Formats stack values on a background thread, one job after the other.
+// Only the newest generation counts: posting a job of a newer generation
+// drops the queued jobs of older ones and abandons the one in progress.
+class RpnFormatWorker final : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RpnFormatWorker(QObject *parent = nullptr);
+    ~RpnFormatWorker() override;
+
+    void post(RpnFormatJob job);
+
+signals:
+    // Emitted on the thread the worker object lives in (the GUI thread)
+    void formatted(quint64 generation, quint64 id, const QStringList &texts);
+
+private:
+    void loop();
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<RpnFormatJob> m_jobs;
+    bool m_stop = false;
+    std::atomic<quint64> m_latest{ 0 }; // newest generation posted; ~0 on shutdown
+    std::thread m_thread;               // last: starts once the rest is set up
+};
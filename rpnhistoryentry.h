@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+
+#include "rpncore.h"
+
+// One history line as recorded: free text, or an operation with the numbers
+// it used. Operation entries are turned into text only when the line is
+// shown, copied or saved (RpnHistoryModel::lineText()), so recording one
+// allocates nothing.
+struct RpnHistoryEntry {
+    enum class Kind : quint8 {
+        Text,   // `text` is the line
+        Op,     // RpnOp: operands (as the op reports them) and result
+        Bulk    // RpnBulkOp over `count` values
+    };
+
+    Kind kind = Kind::Text;
+    quint8 op = 0;
+    qint32 count = 0;
+    double operands[2] = {};
+    double result = 0.0; // the new top, or the factor of a scale
+    // Text: the line. Op/Bulk: the result already formatted (decimal
+    // backends, whose values a double cannot carry), or empty.
+    QString text;
+
+    static RpnHistoryEntry line(const QString &text)
+    {
+        RpnHistoryEntry e;
+        e.text = text;
+        return e;
+    }
+};
@@ -3,6 +3,185 @@
 RpnHistoryModel::RpnHistoryModel(QObject *parent)
     : QAbstractListModel(parent)
 {
+    // Filled slot by slot, so adding never reallocates
+    m_ring.reserve(m_capacity);
 }
 
 RpnHistoryModel::~RpnHistoryModel() = default;
+
+void RpnHistoryModel::clear()
+{
+    if (m_begin == m_end) return;
+    // Lines stay in the ring until overwritten, so clearing can be undone
+    beginResetModel();
+    m_begin = m_end;
+    endResetModel();
+}
+
+void RpnHistoryModel::add(const RpnHistoryEntry &entry)
+{
+    const quint64 abs = m_end;
+    const quint64 cap = quint64(m_capacity);
+
+    // Ring is full: the slot we are about to write holds the oldest row
+    if (abs >= cap && m_begin <= abs - cap) {
+        const int last = rowCount() - 1;
+        beginRemoveRows(QModelIndex(), last, last);
+        m_begin = abs - cap + 1;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), 0, 0);
+    const qsizetype slot = qsizetype(abs % cap);
+    if (slot == m_ring.size()) m_ring.append(entry);
+    else m_ring[slot] = entry;
+    ++m_end;
+    m_highWater = qMax(m_highWater, m_end);
+    endInsertRows();
+}
+
+QList<RpnHistoryEntry> RpnHistoryModel::takeSince(quint64 mark)
+{
+    QList<RpnHistoryEntry> entries;
+    const quint64 first = qMax(mark, m_begin);
+    if (first >= m_end) return entries;
+
+    entries.reserve(qsizetype(m_end - first));
+    for (quint64 abs = first; abs < m_end; ++abs) entries.append(entryAt(abs));
+
+    // Newest lines are the top rows
+    beginRemoveRows(QModelIndex(), 0, int(m_end - first) - 1);
+    m_end = first;
+    endRemoveRows();
+    return entries;
+}
+
+void RpnHistoryModel::append(const QList<RpnHistoryEntry> &entries)
+{
+    for (const RpnHistoryEntry &entry : entries) add(entry);
+}
+
+void RpnHistoryModel::restoreFirst(quint64 mark)
+{
+    // Slots below highWater - capacity have been reused by newer lines
+    const quint64 cap = quint64(m_capacity);
+    quint64 first = mark;
+    if (m_highWater > cap) first = qMax(first, m_highWater - cap);
+    if (first >= m_begin) return;
+
+    // Older lines come back at the bottom of the list
+    const int oldCount = rowCount();
+    beginInsertRows(QModelIndex(), oldCount, oldCount + int(m_begin - first) - 1);
+    m_begin = first;
+    endInsertRows();
+}
+
+QStringList RpnHistoryModel::lines(quint64 from, quint64 to) const
+{
+    from = qMax(from, m_begin);
+    to = qMin(to, m_end);
+    QStringList out;
+    if (from >= to) return out;
+    out.reserve(qsizetype(to - from));
+    for (quint64 abs = from; abs < to; ++abs) out.append(lineText(entryAt(abs)));
+    return out;
+}
+
+void RpnHistoryModel::setLines(const QStringList &lines)
+{
+    QList<RpnHistoryEntry> entries;
+    entries.reserve(lines.size());
+    for (const QString &line : lines) entries.append(RpnHistoryEntry::line(line));
+    setEntries(entries);
+}
+
+void RpnHistoryModel::setEntries(const QList<RpnHistoryEntry> &entries)
+{
+    beginResetModel();
+    m_ring.clear();
+    m_ring.reserve(m_capacity);
+    // Keep at most one ring's worth of the newest entries
+    const qsizetype keep = qMin(entries.size(), m_capacity);
+    for (qsizetype i = entries.size() - keep; i < entries.size(); ++i) m_ring.append(entries[i]);
+    m_begin = 0;
+    m_end = m_highWater = quint64(keep);
+    endResetModel();
+}
+
+QString RpnHistoryModel::text() const
+{
+    QString out;
+    for (quint64 abs = m_end; abs > m_begin; --abs) {
+        if (abs != m_end) out += '\n';
+        out += lineText(entryAt(abs - 1));
+    }
+    return out;
+}
+
+void RpnHistoryModel::setText(const QString &text)
+{
+    beginResetModel();
+    m_ring.clear();
+    m_ring.reserve(m_capacity);
+    m_begin = m_end = m_highWater = 0;
+
+    if (!text.isEmpty()) {
+        const QStringList lines = text.split('\n');
+        // Newest line first; keep at most one ring's worth of the newest
+        const qsizetype keep = qMin(lines.size(), m_capacity);
+        for (qsizetype i = keep - 1; i >= 0; --i) m_ring.append(RpnHistoryEntry::line(lines[i]));
+        m_end = m_highWater = quint64(keep);
+    }
+    endResetModel();
+}
+
+// --- FORMATTING ---
+
+void RpnHistoryModel::setNumberFormat(int mode, int precision)
+{
+    if (mode == m_formatter.mode() && precision == m_formatter.precision()) return;
+    m_formatter.setFormat(mode, precision);
+    if (rowCount() > 0) emit dataChanged(index(0), index(rowCount() - 1), { TextRole });
+}
+
+QString RpnHistoryModel::lineText(const RpnHistoryEntry &entry) const
+{
+    switch (entry.kind) {
+        case RpnHistoryEntry::Kind::Text: return entry.text;
+        case RpnHistoryEntry::Kind::Op: return opText(entry);
+        case RpnHistoryEntry::Kind::Bulk: return bulkText(entry);
+    }
+    return {};
+}
+
+QString RpnHistoryModel::opText(const RpnHistoryEntry &e) const
+{
+    if (e.op >= kRpnOps.size()) return {};
+    const RpnOpInfo &info = kRpnOps[e.op];
+    const QString pattern = QString::fromUtf8(info.history.data(), qsizetype(info.history.size()));
+    // Ops that leave no new top (drop, swap, clear) have no placeholders
+    if (!pattern.contains(QLatin1Char('%'))) return pattern;
+    const QString top = e.text.isEmpty() ? m_formatter.format(e.result) : e.text;
+    switch (info.arity()) {
+        case 2: return pattern.arg(m_formatter.format(e.operands[0]), m_formatter.format(e.operands[1]), top);
+        case 1: return pattern.arg(m_formatter.format(e.operands[0]), top);
+        default: return pattern.arg(top);
+    }
+}
+
+QString RpnHistoryModel::bulkText(const RpnHistoryEntry &e) const
+{
+    const int n = e.count;
+    const QString top = e.text.isEmpty() ? m_formatter.format(e.result) : e.text;
+    switch (static_cast<RpnBulkOp>(e.op)) {
+        case RpnBulkOp::Neg: return QString("neg over %1 values").arg(n);
+        case RpnBulkOp::Sin: return QString("sin over %1 values").arg(n);
+        case RpnBulkOp::Cos: return QString("cos over %1 values").arg(n);
+        case RpnBulkOp::Scale: return QString("scale %1 values by %2").arg(n).arg(top);
+        case RpnBulkOp::Sum: return QString("sum of %1 values -> %2").arg(n).arg(top);
+        case RpnBulkOp::Product: return QString("product of %1 values -> %2").arg(n).arg(top);
+        case RpnBulkOp::Mean: return QString("mean of %1 values -> %2").arg(n).arg(top);
+        case RpnBulkOp::StdDev: return QString("stddev of %1 values -> %2").arg(n).arg(top);
+    }
+    return {};
+}
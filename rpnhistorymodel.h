@@ -1,25 +1,35 @@
 #pragma once
 #include <QAbstractListModel>
 #include <QStringList>
+#include <QVector>
 
+#include "rpnformatter.h"
+#include "rpnhistoryentry.h"
+
+// Append-only ring of history entries, newest at row 0.
+// Entries are addressed by an ever-growing absolute index ("mark"), so the
+// engine can undo "everything after mark N" without copying the history.
+// The ring is allocated once; operation entries become text in data().
 class RpnHistoryModel final : public QAbstractListModel {
     Q_OBJECT
 public:
     enum Roles { TextRole = Qt::UserRole + 1 };
     Q_ENUM(Roles)
 
+    static constexpr qsizetype kDefaultCapacity = 100000;
+
     explicit RpnHistoryModel(QObject *parent = nullptr);
     ~RpnHistoryModel() override;
     int rowCount(const QModelIndex &parent = QModelIndex()) const override {
         if (parent.isValid()) return 0;
-        return m_items.size();
+        return int(m_end - m_begin);
     }
 
     QVariant data(const QModelIndex &index, int role) const override {
         if (!index.isValid()) return {};
         const int row = index.row();
-        if (row < 0 || row >= m_items.size()) return {};
-        if (role == TextRole) return m_items[row];
+        if (row < 0 || row >= rowCount()) return {};
+        if (role == TextRole) return lineText(entryAt(m_end - 1 - quint64(row)));
         return {};
     }
 
@@ -27,19 +37,47 @@ public:
         return {{TextRole, "text"}};
     }
 
-    Q_INVOKABLE void clear() {
-        beginResetModel();
-        m_items.clear();
-        endResetModel();
-    }
+    Q_INVOKABLE void clear();
 
-    void add(const QString &line) {
-        const int row = m_items.size();
-        beginInsertRows(QModelIndex(), row, row);
-        m_items.push_back(line);
-        endInsertRows();
-    }
+    // O(1); evicts the oldest line once the ring is full
+    void add(const RpnHistoryEntry &entry);
+    void add(const QString &line) { add(RpnHistoryEntry::line(line)); }
+
+    // Absolute index one past the newest line / of the oldest visible line
+    quint64 mark() const { return m_end; }
+    quint64 firstMark() const { return m_begin; }
+
+    // Removes entries added at or after `mark`, returned oldest first
+    QList<RpnHistoryEntry> takeSince(quint64 mark);
+    // Re-adds entries returned by takeSince()
+    void append(const QList<RpnHistoryEntry> &entries);
+    // Makes lines cleared by clear() visible again, as far as the ring still has them
+    void restoreFirst(quint64 mark);
+
+    // Lines in [from, to) (absolute marks), oldest first
+    QStringList lines(quint64 from, quint64 to) const;
+    QStringList lines() const { return lines(m_begin, m_end); }
+    // Replaces the history; oldest first
+    void setLines(const QStringList &lines);
+    void setEntries(const QList<RpnHistoryEntry> &entries);
+
+    // Number format of operation entries; shown rows are refreshed
+    void setNumberFormat(int mode, int precision);
+    QString lineText(const RpnHistoryEntry &entry) const;
+
+    // Whole history as text, newest line first (built on demand)
+    QString text() const;
+    void setText(const QString &text);
 
 private:
-    QStringList m_items;
+    const RpnHistoryEntry &entryAt(quint64 abs) const { return m_ring[qsizetype(abs % quint64(m_capacity))]; }
+    QString opText(const RpnHistoryEntry &entry) const;
+    QString bulkText(const RpnHistoryEntry &entry) const;
+
+    QVector<RpnHistoryEntry> m_ring;
+    RpnFormatter m_formatter;
+    qsizetype m_capacity = kDefaultCapacity;
+    quint64 m_begin = 0;     // oldest visible line
+    quint64 m_end = 0;       // one past the newest line
+    quint64 m_highWater = 0; // one past the newest slot ever written
 };
@@ -0,0 +1,274 @@
+#include "rpninfix.h"
+#include "rpnparse.h"
+
+#include <utility>
+
+namespace {
+
+// Deep enough for any formula typed by hand, shallow enough for the stack
+constexpr int kMaxNesting = 200;
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+} // namespace
+
+// Recursive descent over the UTF-8 text, emitting postfix steps as it goes
+class RpnFormulaParser
+{
+public:
+    RpnFormulaParser(std::string_view text, bool decimalComma, RpnFormula &out)
+        : m_text(text), m_decimalComma(decimalComma), m_out(out)
+    {
+    }
+
+    bool parse()
+    {
+        if (!expression()) return false;
+        skipSpace();
+        if (m_pos != m_text.size()) return fail(m_pos, peek() == ')' ? "Unmatched ')'." : "Expected an operator.");
+        return true;
+    }
+
+    RpnFormula::Error error;
+
+private:
+    // --- GRAMMAR ---
+    // expression := term (('+' | '-') term)*
+    // term       := unary (('*' | '/') unary)*
+    // unary      := ('-' | '+') unary | power
+    // power      := primary '!'* ('^' unary)?
+
+    bool expression()
+    {
+        if (!term()) return false;
+        for (;;) {
+            if (accept("+")) {
+                if (!term()) return false;
+                append(RpnOp::Add);
+            } else if (accept("-") || accept("\xE2\x88\x92")) { // −
+                if (!term()) return false;
+                append(RpnOp::Sub);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool term()
+    {
+        if (!unary()) return false;
+        for (;;) {
+            if (accept("*") || accept("\xC3\x97")) { // ×
+                if (!unary()) return false;
+                append(RpnOp::Mul);
+            } else if (accept("/") || accept("\xC3\xB7")) { // ÷
+                if (!unary()) return false;
+                append(RpnOp::Div);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool unary()
+    {
+        if (++m_depth > kMaxNesting) return fail(m_pos, "Formula is nested too deeply.");
+        bool ok = false;
+        if (accept("-") || accept("\xE2\x88\x92")) {
+            ok = unary();
+            if (ok) append(RpnOp::Neg);
+        } else if (accept("+")) {
+            ok = unary();
+        } else {
+            ok = power();
+        }
+        --m_depth;
+        return ok;
+    }
+
+    bool power()
+    {
+        if (!primary()) return false;
+        while (accept("!")) append(RpnOp::Factorial);
+        if (accept("^")) {
+            // Right operand is a unary: 2^-1, and 2^3^2 = 2^(3^2)
+            if (!unary()) return false;
+            append(RpnOp::Pow);
+        }
+        return true;
+    }
+
+    bool primary()
+    {
+        skipSpace();
+        const std::size_t start = m_pos;
+        if (m_pos == m_text.size()) return fail(start, "Formula ends too early.");
+
+        if (accept("(")) {
+            if (!expression()) return false;
+            if (!accept(")")) return fail(m_pos, "Missing ')'.");
+            return true;
+        }
+        if (isDigit(peek()) || (isDecimalSeparator(peek()) && isDigit(peek(1)))) return number();
+        if (accept("\xCF\x80")) { // π
+            append(RpnOp::PushPi);
+            return true;
+        }
+        if (!isAlpha(peek())) return fail(start, "Expected a number, a constant or '('.");
+
+        while (m_pos < m_text.size() && (isAlpha(m_text[m_pos]) || isDigit(m_text[m_pos]))) ++m_pos;
+        const std::string_view name = m_text.substr(start, m_pos - start);
+        if (name == "pi") {
+            append(RpnOp::PushPi);
+            return true;
+        }
+        if (name == "e") {
+            append(RpnOp::PushE);
+            return true;
+        }
+        // Every unary or binary op of the registry is a function: f(x), f(x; y)
+        if (const std::optional<RpnOp> op = rpnOpFromToken(name); op && rpnOpInfo(*op).arity() > 0)
+            return call(name, *op);
+        return fail(start, "Unknown name '" + std::string(name) + "'.");
+    }
+
+    bool call(std::string_view name, RpnOp op)
+    {
+        if (!accept("(")) return fail(m_pos, "Expected '(' after " + std::string(name) + ".");
+        const int n = rpnOpInfo(op).arity();
+        const std::string arity = std::string(name) + " takes " + std::to_string(n)
+                                  + (n == 1 ? " argument." : " arguments.");
+        for (int arg = 0; arg < n; ++arg) {
+            if (arg > 0 && !acceptSeparator()) return fail(m_pos, arity);
+            if (!expression()) return false;
+        }
+        if (!accept(")")) return fail(m_pos, acceptSeparator() ? arity : std::string("Missing ')'."));
+        append(op);
+        return true;
+    }
+
+    bool number()
+    {
+        const std::size_t start = m_pos;
+        while (isDigit(peek())) ++m_pos;
+        if (isDecimalSeparator(peek()) && isDigit(peek(1))) {
+            ++m_pos;
+            while (isDigit(peek())) ++m_pos;
+        }
+        // Exponent only when digits follow, so "2e" stays an error, not 2*e
+        if ((peek() == 'e' || peek() == 'E')
+            && (isDigit(peek(1)) || ((peek(1) == '+' || peek(1) == '-') && isDigit(peek(2))))) {
+            m_pos += 2;
+            while (isDigit(peek())) ++m_pos;
+        }
+        const std::string_view text = m_text.substr(start, m_pos - start);
+        double v = 0.0;
+        if (!rpnParseNumber(text, v)) return fail(start, "Invalid number.");
+        m_out.m_steps.push_back({ std::nullopt, std::string(text) });
+        return true;
+    }
+
+    // --- LEXING ---
+
+    bool isDecimalSeparator(char c) const { return c == '.' || (m_decimalComma && c == ','); }
+
+    char peek(std::size_t ahead = 0) const
+    {
+        return m_pos + ahead < m_text.size() ? m_text[m_pos + ahead] : '\0';
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_text.size() && isSpace(m_text[m_pos])) ++m_pos;
+    }
+
+    bool accept(std::string_view token)
+    {
+        skipSpace();
+        if (m_text.substr(m_pos, token.size()) != token) return false;
+        m_pos += token.size();
+        return true;
+    }
+
+    bool acceptSeparator() { return accept(";") || (!m_decimalComma && accept(",")); }
+
+    void append(RpnOp op) { m_out.m_steps.push_back({ op, {} }); }
+
+    bool fail(std::size_t offset, std::string message)
+    {
+        error = { offset, std::move(message) };
+        return false;
+    }
+
+    std::string_view m_text;
+    bool m_decimalComma;
+    RpnFormula &m_out;
+    std::size_t m_pos = 0;
+    int m_depth = 0;
+};
+
+std::optional<RpnFormula> RpnFormula::compile(std::string_view text, bool decimalComma, Error *error)
+{
+    RpnFormula formula;
+    RpnFormulaParser parser(text, decimalComma, formula);
+    if (!parser.parse()) {
+        if (error) *error = std::move(parser.error);
+        return std::nullopt;
+    }
+    return formula;
+}
+
+std::string RpnFormula::rpn() const
+{
+    std::string out;
+    for (const Step &s : m_steps) {
+        if (!out.empty()) out += ' ';
+        out += s.op ? std::string(rpnOpToken(*s.op)) : s.number;
+    }
+    return out;
+}
+
+// --- CONSTANT FOLDING ---
+// A scratch core without undo gives exactly the engine's results and errors
+
+RpnOpResult RpnFormula::fold(double &value) const
+{
+    RpnCore core;
+    core.setUndoEnabled(false);
+    for (const Step &s : m_steps) {
+        if (s.op) {
+            const RpnOpResult r = core.apply(*s.op);
+            if (!r.ok()) return r;
+        } else {
+            double v = 0.0;
+            rpnParseNumber(s.number, v);
+            core.push(v);
+        }
+    }
+    RpnOpResult r;
+    value = core.at(0);
+    r.result = value;
+    return r;
+}
+
+RpnOpResult RpnFormula::fold(RpnDecimal &value, const RpnDecimalContext &ctx) const
+{
+    RpnDecimalCore core(ctx);
+    core.setUndoEnabled(false);
+    for (const Step &s : m_steps) {
+        if (s.op) {
+            const RpnOpResult r = core.apply(*s.op);
+            if (!r.ok()) return r;
+        } else {
+            RpnDecimal v;
+            rpnParseDecimal(s.number, v, ctx);
+            core.push(std::move(v));
+        }
+    }
+    RpnOpResult r;
+    value = core.at(0);
+    r.result = value.toDouble();
+    return r;
+}
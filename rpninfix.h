@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+
+// An infix formula such as "(3+4)*sin(pi/6)", translated to the ops the
+// cores already have. There are no variables, so a formula always folds
+// to one constant; fold() does that with the same rules and errors as
+// pushing the values and applying the ops one by one.
+//
+//   + - * / ^ (also × ÷ −), unary minus, n!, parentheses
+//   pi (π), e
+//   every unary or binary op by its token (kRpnOps): sin(x) tan(x) ln(x)
+//   exp(x) sqrt(x) abs(x) root(x; n) pow(x; y) inv(x) neg(x) ...
+//
+// ^ binds tighter than unary minus and is right-associative: -2^2 = -4,
+// 2^3^2 = 512.
+class RpnFormula
+{
+public:
+    struct Error {
+        std::size_t offset = 0; // byte offset into the formula
+        std::string message;
+    };
+
+    // With `decimalComma`, ',' is the decimal separator and only ';'
+    // separates function arguments; otherwise ',' and ';' both do
+    static std::optional<RpnFormula> compile(std::string_view text, bool decimalComma, Error *error = nullptr);
+
+    // Postfix form in rpnOpFromToken() names: "3 4 + pi 6 / sin *"
+    std::string rpn() const;
+
+    RpnOpResult fold(double &value) const;
+    RpnOpResult fold(RpnDecimal &value, const RpnDecimalContext &ctx) const;
+
+private:
+    struct Step {
+        std::optional<RpnOp> op;
+        std::string number; // when op is empty; text rpnParseNumber() accepts
+    };
+
+    std::vector<Step> m_steps;
+
+    friend class RpnFormulaParser;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Progress and cancellation of one long operation. The thread doing the
+// work reports through step(); any other thread may read progress() and
+// call cancel(). Operations that take one (RpnStackCore::setJobControl())
+// check it every few values and stop with RpnError::Cancelled.
+class RpnJobControl
+{
+public:
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    // `done` of `total` units finished; false once cancelled
+    bool step(std::size_t done, std::size_t total)
+    {
+        m_total.store(total, std::memory_order_relaxed);
+        m_done.store(done, std::memory_order_relaxed);
+        return !cancelled();
+    }
+
+    // 0..1, or -1 while nothing was reported (show it as indeterminate)
+    double progress() const
+    {
+        const std::size_t total = m_total.load(std::memory_order_relaxed);
+        if (total == 0) return -1.0;
+        const std::size_t done = m_done.load(std::memory_order_relaxed);
+        return done >= total ? 1.0 : double(done) / double(total);
+    }
+
+private:
+    std::atomic<bool> m_cancelled{ false };
+    std::atomic<std::size_t> m_done{ 0 };
+    std::atomic<std::size_t> m_total{ 0 };
+};
@@ -0,0 +1,218 @@
+#include "rpnlinebatch.h"
+#include "rpnparse.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+void shortest(double v, std::string &out)
+{
+    char buf[32];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+} // namespace
+
+RpnLineBatch::RpnLineBatch(unsigned threads)
+    : m_formatter(shortest)
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    m_workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+        m_workers.back()->core.setUndoEnabled(false);
+    }
+    m_threads.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) m_threads.emplace_back([this, i] { poolLoop(i); });
+}
+
+RpnLineBatch::~RpnLineBatch()
+{
+    {
+        const std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &t : m_threads) t.join();
+}
+
+void RpnLineBatch::setFormatter(Formatter formatter)
+{
+    m_formatter = formatter ? std::move(formatter) : Formatter(shortest);
+}
+
+// --- SCHEDULING ---
+
+RpnLineBatch::Result RpnLineBatch::run(std::string_view text, std::string &out, std::string &errors,
+                                       std::size_t firstLine)
+{
+    // Cut at the first line break after every m_chunkBytes
+    m_chunks.clear();
+    for (std::size_t pos = 0; pos < text.size();) {
+        std::size_t end = std::min(text.size(), pos + m_chunkBytes);
+        if (end < text.size()) {
+            const void *nl = std::memchr(text.data() + end, '\n', text.size() - end);
+            end = nl ? std::size_t(static_cast<const char *>(nl) - text.data()) + 1 : text.size();
+        }
+        Chunk &chunk = m_chunks.emplace_back();
+        chunk.text = text.substr(pos, end - pos);
+        pos = end;
+    }
+    if (m_chunks.empty()) return {};
+
+    // Equal shares to start with; stealing evens out the rest
+    const std::size_t n = m_workers.size();
+    const std::size_t count = m_chunks.size();
+    for (std::size_t i = 0; i < n; ++i)
+        m_workers[i]->range.store(pack(std::uint32_t(count * i / n), std::uint32_t(count * (i + 1) / n)),
+                                  std::memory_order_relaxed);
+
+    {
+        const std::lock_guard lock(m_mutex);
+        ++m_generation;
+        m_running = unsigned(n);
+    }
+    m_wake.notify_all();
+    work(0);
+    {
+        std::unique_lock lock(m_mutex);
+        m_done.wait(lock, [this] { return m_running == 0; });
+    }
+
+    Result result;
+    for (const Chunk &chunk : m_chunks) {
+        out += chunk.out;
+        for (const LineError &e : chunk.errors) {
+            errors += "line " + std::to_string(firstLine + result.lines + e.line) + ", token "
+                      + std::to_string(e.token) + " (" + e.text + "): ERR: " + e.message + '\n';
+        }
+        result.lines += chunk.lines;
+        result.errors += chunk.errors.size();
+    }
+    return result;
+}
+
+void RpnLineBatch::poolLoop(std::size_t self)
+{
+    std::uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop) return;
+            seen = m_generation;
+        }
+        work(self);
+    }
+}
+
+void RpnLineBatch::work(std::size_t self)
+{
+    RpnCore &core = m_workers[self]->core;
+    std::uint32_t chunk = 0;
+    while (take(self, chunk) || steal(self, chunk)) evaluate(m_chunks[chunk], core);
+
+    const std::lock_guard lock(m_mutex);
+    if (--m_running == 0) m_done.notify_one();
+}
+
+bool RpnLineBatch::take(std::size_t self, std::uint32_t &chunk)
+{
+    std::atomic<std::uint64_t> &range = m_workers[self]->range;
+    std::uint64_t r = range.load(std::memory_order_acquire);
+    while (low(r) < high(r)) {
+        if (range.compare_exchange_weak(r, pack(low(r) + 1, high(r)), std::memory_order_acq_rel)) {
+            chunk = low(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RpnLineBatch::steal(std::size_t self, std::uint32_t &chunk)
+{
+    const std::size_t n = m_workers.size();
+    for (std::size_t k = 1; k < n; ++k) {
+        std::atomic<std::uint64_t> &victim = m_workers[(self + k) % n]->range;
+        std::uint64_t r = victim.load(std::memory_order_acquire);
+        while (low(r) < high(r)) {
+            // The upper half, so the victim keeps the chunks next to its own
+            const std::uint32_t mid = low(r) + (high(r) - low(r)) / 2;
+            if (victim.compare_exchange_weak(r, pack(low(r), mid), std::memory_order_acq_rel)) {
+                chunk = mid;
+                // Nobody takes from an empty range, so a plain store will do
+                m_workers[self]->range.store(pack(mid + 1, high(r)), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// --- EVALUATION ---
+
+void RpnLineBatch::evaluate(Chunk &chunk, RpnCore &core) const
+{
+    chunk.out.clear();
+    chunk.errors.clear();
+    chunk.lines = 0;
+    std::string_view rest = chunk.text;
+    while (!rest.empty()) {
+        const std::size_t nl = rest.find('\n');
+        const std::string_view line = rest.substr(0, nl);
+        rest = nl == std::string_view::npos ? std::string_view() : rest.substr(nl + 1);
+        evaluateLine(line, core, chunk);
+        ++chunk.lines;
+    }
+}
+
+void RpnLineBatch::evaluateLine(std::string_view line, RpnCore &core, Chunk &chunk) const
+{
+    core.apply(RpnOp::Clear);
+    std::size_t token = 0;
+    const char *p = line.data();
+    const char *end = p + line.size();
+    while (p != end) {
+        while (p != end && isSpace(*p)) ++p;
+        const char *start = p;
+        while (p != end && !isSpace(*p)) ++p;
+        if (start == p) break;
+        const std::string_view text(start, std::size_t(p - start));
+        ++token;
+
+        double v = 0.0;
+        std::string message;
+        if (rpnParseNumber(text, v)) {
+            core.push(v);
+            continue;
+        }
+        if (const std::optional<RpnOp> op = rpnOpFromToken(text)) {
+            const RpnOpResult r = core.apply(*op);
+            if (r.ok()) continue;
+            message = rpnErrorText(r);
+        } else {
+            message = rpnErrorText(RpnError::InvalidNumber);
+        }
+        chunk.out += "ERR: ";
+        chunk.out += message;
+        chunk.out += '\n';
+        chunk.errors.push_back({ chunk.lines, token, std::string(text.substr(0, 32)), std::move(message) });
+        return;
+    }
+
+    // Top of the stack first, like the GUI
+    const std::vector<double> &stack = core.values();
+    for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
+        if (it != stack.crbegin()) chunk.out += ' ';
+        m_formatter(*it, chunk.out);
+    }
+    chunk.out += '\n';
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "rpncore.h"
+
+// Evaluates input in which every line is an independent RPN program (the
+// tokens of headless mode), on all cores. The input is cut into chunks of
+// whole lines and each thread starts on an equal share of them; a thread
+// that runs out steals half of what another one has left. Every thread
+// evaluates on an RpnCore of its own (undo off) that it clears per line,
+// and each chunk writes to its own buffer, so results come out in input
+// order without the threads sharing anything but the chunk counters.
+class RpnLineBatch
+{
+public:
+    // Appends the text of one value to `out`; called from several threads
+    using Formatter = std::function<void(double value, std::string &out)>;
+
+    struct Result {
+        std::size_t lines = 0;
+        std::size_t errors = 0;  // lines that stopped at an error
+    };
+
+    // 0 threads: one per hardware thread. The calling thread is one of them.
+    explicit RpnLineBatch(unsigned threads = 0);
+    ~RpnLineBatch();
+    RpnLineBatch(const RpnLineBatch &) = delete;
+    RpnLineBatch &operator=(const RpnLineBatch &) = delete;
+
+    unsigned threads() const { return unsigned(m_workers.size()); }
+    // Shortest round-trip text by default
+    void setFormatter(Formatter formatter);
+    void setChunkBytes(std::size_t bytes) { m_chunkBytes = bytes > 0 ? bytes : 1; }
+
+    // Evaluates the lines of `text`; a last line without '\n' counts too.
+    // Appends one line to `out` per input line: the final stack, top first
+    // and separated by spaces, or "ERR: message" when a token failed (the
+    // rest of that line is skipped). Failures are described in `errors`
+    // ("line N, token M (text): ERR: message"), lines counted from `firstLine`.
+    Result run(std::string_view text, std::string &out, std::string &errors, std::size_t firstLine = 1);
+
+private:
+    struct LineError {
+        std::size_t line = 0;   // within the chunk
+        std::size_t token = 0;
+        std::string text;
+        std::string message;
+    };
+
+    struct Chunk {
+        std::string_view text;
+        std::string out;
+        std::vector<LineError> errors;
+        std::size_t lines = 0;
+    };
+
+    // Chunk indices [lo, hi) a thread has left, packed into one word so
+    // the owner and thieves claim them with a single compare-exchange
+    struct alignas(64) Worker {
+        std::atomic<std::uint64_t> range{ 0 };
+        RpnCore core;
+    };
+
+    static std::uint64_t pack(std::uint32_t lo, std::uint32_t hi) { return std::uint64_t(hi) << 32 | lo; }
+    static std::uint32_t low(std::uint64_t r) { return std::uint32_t(r); }
+    static std::uint32_t high(std::uint64_t r) { return std::uint32_t(r >> 32); }
+
+    void work(std::size_t self);
+    // Next chunk of `self`, stolen from another thread when its own ran out
+    bool take(std::size_t self, std::uint32_t &chunk);
+    bool steal(std::size_t self, std::uint32_t &chunk);
+    void evaluate(Chunk &chunk, RpnCore &core) const;
+    void evaluateLine(std::string_view line, RpnCore &core, Chunk &chunk) const;
+    void poolLoop(std::size_t self);
+
+    Formatter m_formatter;
+    std::size_t m_chunkBytes = std::size_t(1) << 16;
+    std::vector<Chunk> m_chunks;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    // Wakes the pool for each run() and tells the caller when it is done
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::uint64_t m_generation = 0;
+    unsigned m_running = 0;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads; // worker 0 is the caller of run()
+};
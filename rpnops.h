@@ -0,0 +1,250 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <optional>
+#include <string_view>
+
+#include "rpndecimal.h"
+
+// Operation registry: one constexpr entry per stack operation with its
+// arity, kernels (double and decimal, domain checks included), script
+// tokens, keypad label, keyboard key and history format. RpnCore,
+// RpnDecimalCore, RpnProgram, the history and the GUI all dispatch through
+// the table by index, so a new function is one enum value plus one entry.
+
+enum class RpnOp : std::uint8_t {
+    Add, Sub, Mul, Div, Pow, Root,
+    Sin, Cos, Neg, Reciprocal,
+    Dup, Drop, Swap, Clear,
+    PushPi, PushE,
+    // Appended: recorded history keeps the numbers of the ones above
+    Tan, Ln, Exp, Sqrt, Abs, Factorial
+};
+
+enum class RpnError : std::uint8_t {
+    None,
+    NotEnoughArgs,
+    DivisionByZero,
+    RootDegreeZero,
+    InvalidRoot,
+    ReciprocalOfZero,
+    EmptyDup,
+    EmptyDrop,
+    InvalidNumber,
+    Cancelled,      // RpnJobControl::cancel() stopped a long operation
+    InvalidLog,
+    InvalidFactorial
+};
+
+enum class RpnOpKind : std::uint8_t {
+    Push,    // no operands, pushes the result
+    Unary,   // replaces the top value
+    Binary,  // replaces the top two values
+    Stack    // dup, drop, swap, clear: moves values, no kernel
+};
+
+// Operands come bottom first (in[0] is the lower of two). A kernel writes
+// `out` and returns None, or returns the error and leaves the stack alone.
+using RpnKernel = RpnError (*)(const double *in, double &out);
+using RpnDecimalKernel = RpnError (*)(const RpnDecimal *in, const RpnDecimalContext &ctx, RpnDecimal &out);
+
+struct RpnOpInfo {
+    RpnOp op;
+    RpnOpKind kind;
+    // Script and headless names; the first one is what macros record
+    std::array<std::string_view, 3> tokens;
+    std::string_view label;    // keypad key; empty if the keypad has none
+    std::string_view key;      // keyboard shortcut; empty if none
+    // QString::arg pattern: operands bottom first, then the new top
+    std::string_view history;
+    RpnKernel kernel = nullptr;
+    RpnDecimalKernel decimal = nullptr;
+
+    constexpr int arity() const
+    {
+        return kind == RpnOpKind::Binary ? 2 : kind == RpnOpKind::Unary ? 1 : 0;
+    }
+};
+
+namespace rpnkernel {
+
+// Largest n accepted by n!, on every backend (a double overflows after 170)
+inline constexpr int kMaxFactorial = 10000;
+
+inline RpnError add(const double *in, double &out) { out = in[0] + in[1]; return RpnError::None; }
+inline RpnError sub(const double *in, double &out) { out = in[0] - in[1]; return RpnError::None; }
+inline RpnError mul(const double *in, double &out) { out = in[0] * in[1]; return RpnError::None; }
+inline RpnError div(const double *in, double &out)
+{
+    if (in[1] == 0.0) return RpnError::DivisionByZero;
+    out = in[0] / in[1];
+    return RpnError::None;
+}
+inline RpnError pow(const double *in, double &out) { out = std::pow(in[0], in[1]); return RpnError::None; }
+inline RpnError root(const double *in, double &out)
+{
+    if (in[1] == 0.0) return RpnError::RootDegreeZero;
+    out = std::pow(in[0], 1.0 / in[1]);
+    return std::isfinite(out) ? RpnError::None : RpnError::InvalidRoot;
+}
+inline RpnError sin(const double *in, double &out) { out = std::sin(in[0]); return RpnError::None; }
+inline RpnError cos(const double *in, double &out) { out = std::cos(in[0]); return RpnError::None; }
+inline RpnError tan(const double *in, double &out) { out = std::tan(in[0]); return RpnError::None; }
+inline RpnError neg(const double *in, double &out) { out = -in[0]; return RpnError::None; }
+inline RpnError reciprocal(const double *in, double &out)
+{
+    if (in[0] == 0.0) return RpnError::ReciprocalOfZero;
+    out = 1.0 / in[0];
+    return RpnError::None;
+}
+inline RpnError ln(const double *in, double &out)
+{
+    if (!(in[0] > 0.0)) return RpnError::InvalidLog;
+    out = std::log(in[0]);
+    return RpnError::None;
+}
+inline RpnError exp(const double *in, double &out) { out = std::exp(in[0]); return RpnError::None; }
+inline RpnError sqrt(const double *in, double &out)
+{
+    if (in[0] < 0.0) return RpnError::InvalidRoot;
+    out = std::sqrt(in[0]);
+    return RpnError::None;
+}
+inline RpnError abs(const double *in, double &out) { out = std::fabs(in[0]); return RpnError::None; }
+inline RpnError factorial(const double *in, double &out)
+{
+    const double n = in[0];
+    if (!(n >= 0.0 && n <= kMaxFactorial) || n != std::floor(n)) return RpnError::InvalidFactorial;
+    out = 1.0;
+    for (int i = 2; i <= int(n) && std::isfinite(out); ++i) out *= i;
+    return RpnError::None;
+}
+inline RpnError pi(const double *, double &out) { out = std::numbers::pi; return RpnError::None; }
+inline RpnError e(const double *, double &out) { out = std::numbers::e; return RpnError::None; }
+
+// --- DECIMAL ---
+
+using D = RpnDecimal;
+using Ctx = RpnDecimalContext;
+
+inline RpnError dAdd(const D *in, const Ctx &ctx, D &out) { out = D::add(in[0], in[1], ctx); return RpnError::None; }
+inline RpnError dSub(const D *in, const Ctx &ctx, D &out) { out = D::sub(in[0], in[1], ctx); return RpnError::None; }
+inline RpnError dMul(const D *in, const Ctx &ctx, D &out) { out = D::mul(in[0], in[1], ctx); return RpnError::None; }
+inline RpnError dDiv(const D *in, const Ctx &ctx, D &out)
+{
+    if (in[1].isZero()) return RpnError::DivisionByZero;
+    out = D::div(in[0], in[1], ctx);
+    return RpnError::None;
+}
+inline RpnError dPow(const D *in, const Ctx &ctx, D &out) { out = D::pow(in[0], in[1], ctx); return RpnError::None; }
+inline RpnError dRoot(const D *in, const Ctx &ctx, D &out)
+{
+    if (in[1].isZero()) return RpnError::RootDegreeZero;
+    out = D::root(in[0], in[1], ctx);
+    return out.isFinite() ? RpnError::None : RpnError::InvalidRoot;
+}
+inline RpnError dSin(const D *in, const Ctx &ctx, D &out) { out = D::sin(in[0], ctx); return RpnError::None; }
+inline RpnError dCos(const D *in, const Ctx &ctx, D &out) { out = D::cos(in[0], ctx); return RpnError::None; }
+inline RpnError dTan(const D *in, const Ctx &ctx, D &out) { out = D::tan(in[0], ctx); return RpnError::None; }
+inline RpnError dNeg(const D *in, const Ctx &, D &out) { out = -in[0]; return RpnError::None; }
+inline RpnError dReciprocal(const D *in, const Ctx &ctx, D &out)
+{
+    if (in[0].isZero()) return RpnError::ReciprocalOfZero;
+    out = D::div(D::fromInt(1), in[0], ctx);
+    return RpnError::None;
+}
+inline RpnError dLn(const D *in, const Ctx &ctx, D &out)
+{
+    if (in[0].isNaN() || in[0].isNegative() || in[0].isZero()) return RpnError::InvalidLog;
+    out = D::ln(in[0], ctx);
+    return RpnError::None;
+}
+inline RpnError dExp(const D *in, const Ctx &ctx, D &out) { out = D::exp(in[0], ctx); return RpnError::None; }
+inline RpnError dSqrt(const D *in, const Ctx &ctx, D &out)
+{
+    if (in[0].isNegative() && !in[0].isZero()) return RpnError::InvalidRoot;
+    out = D::sqrt(in[0], ctx);
+    return RpnError::None;
+}
+inline RpnError dAbs(const D *in, const Ctx &, D &out) { out = in[0].abs(); return RpnError::None; }
+inline RpnError dFactorial(const D *in, const Ctx &ctx, D &out)
+{
+    const D &n = in[0];
+    if (!n.isInteger() || n.isNegative() || n.compare(D::fromInt(kMaxFactorial)) > 0)
+        return RpnError::InvalidFactorial;
+    out = D::factorial(std::int64_t(n.toDouble()), ctx);
+    return RpnError::None;
+}
+inline RpnError dPi(const D *, const Ctx &ctx, D &out) { out = D::pi(ctx); return RpnError::None; }
+inline RpnError dE(const D *, const Ctx &ctx, D &out) { out = D::e(ctx); return RpnError::None; }
+
+} // namespace rpnkernel
+
+// Indexed by RpnOp
+inline constexpr std::array<RpnOpInfo, 22> kRpnOps{{
+    { RpnOp::Add, RpnOpKind::Binary, { "+" }, "+", "+", "%1 %2 + -> %3", rpnkernel::add, rpnkernel::dAdd },
+    { RpnOp::Sub, RpnOpKind::Binary, { "-" }, "-", "-", "%1 %2 - -> %3", rpnkernel::sub, rpnkernel::dSub },
+    { RpnOp::Mul, RpnOpKind::Binary, { "*", "\xC3\x97" }, "\xC3\x97", "*", "%1 %2 * -> %3",  // ×
+      rpnkernel::mul, rpnkernel::dMul },
+    { RpnOp::Div, RpnOpKind::Binary, { "/" }, "/", "/", "%1 %2 / -> %3", rpnkernel::div, rpnkernel::dDiv },
+    { RpnOp::Pow, RpnOpKind::Binary, { "^", "pow" }, "x\xCA\xB8", "^", "%1 %2 pow -> %3",  // xʸ
+      rpnkernel::pow, rpnkernel::dPow },
+    { RpnOp::Root, RpnOpKind::Binary, { "root", "r" }, "\xCB\xA3\xE2\x88\x9A\xE1\xB5\xA7", "r",  // ˣ√ᵧ
+      "%2 %1 root -> %3", rpnkernel::root, rpnkernel::dRoot },
+    { RpnOp::Sin, RpnOpKind::Unary, { "sin" }, "sin", "s", "sin(%1) -> %2", rpnkernel::sin, rpnkernel::dSin },
+    { RpnOp::Cos, RpnOpKind::Unary, { "cos" }, "cos", "c", "cos(%1) -> %2", rpnkernel::cos, rpnkernel::dCos },
+    { RpnOp::Neg, RpnOpKind::Unary, { "neg", "n", "\xC2\xB1" }, "\xC2\xB1", "n", "neg(%1) -> %2",  // ±
+      rpnkernel::neg, rpnkernel::dNeg },
+    { RpnOp::Reciprocal, RpnOpKind::Unary, { "inv", "1/x" }, "1/x", "i", "1/%1 -> %2",
+      rpnkernel::reciprocal, rpnkernel::dReciprocal },
+    { RpnOp::Dup, RpnOpKind::Stack, { "dup", "d" }, "dup", "d", "dup -> %1" },
+    { RpnOp::Drop, RpnOpKind::Stack, { "drop", "x" }, "drop", "x", "drop" },
+    { RpnOp::Swap, RpnOpKind::Stack, { "swap" }, {}, {}, "swap" },
+    { RpnOp::Clear, RpnOpKind::Stack, { "clear" }, {}, {}, "clear" },
+    { RpnOp::PushPi, RpnOpKind::Push, { "pi" }, "\xCF\x80", {}, "push pi -> %1", rpnkernel::pi, rpnkernel::dPi },  // π
+    { RpnOp::PushE, RpnOpKind::Push, { "e" }, "e", {}, "push e -> %1", rpnkernel::e, rpnkernel::dE },
+    { RpnOp::Tan, RpnOpKind::Unary, { "tan" }, "tan", "t", "tan(%1) -> %2", rpnkernel::tan, rpnkernel::dTan },
+    { RpnOp::Ln, RpnOpKind::Unary, { "ln" }, "ln", "l", "ln(%1) -> %2", rpnkernel::ln, rpnkernel::dLn },
+    { RpnOp::Exp, RpnOpKind::Unary, { "exp" }, "e\xCB\xA3", {}, "exp(%1) -> %2",  // eˣ
+      rpnkernel::exp, rpnkernel::dExp },
+    { RpnOp::Sqrt, RpnOpKind::Unary, { "sqrt" }, "\xE2\x88\x9Ax", "q", "sqrt(%1) -> %2",  // √x
+      rpnkernel::sqrt, rpnkernel::dSqrt },
+    { RpnOp::Abs, RpnOpKind::Unary, { "abs" }, "|x|", "a", "abs(%1) -> %2", rpnkernel::abs, rpnkernel::dAbs },
+    { RpnOp::Factorial, RpnOpKind::Unary, { "!", "fact" }, "n!", "!", "%1! -> %2",
+      rpnkernel::factorial, rpnkernel::dFactorial },
+}};
+
+constexpr const RpnOpInfo &rpnOpInfo(RpnOp op)
+{
+    return kRpnOps[std::size_t(op)];
+}
+
+constexpr bool rpnOpTableInOrder()
+{
+    for (std::size_t i = 0; i < kRpnOps.size(); ++i)
+        if (std::size_t(kRpnOps[i].op) != i) return false;
+    return true;
+}
+static_assert(rpnOpTableInOrder(), "kRpnOps must be indexed by RpnOp");
+
+// Op for a keypad label or keyboard key ("xʸ", "^", "s"), e.g. from QML
+constexpr std::optional<RpnOp> rpnOpFromKey(std::string_view key)
+{
+    if (key.empty()) return std::nullopt;
+    for (const RpnOpInfo &info : kRpnOps)
+        if (info.label == key || info.key == key) return info.op;
+    return std::nullopt;
+}
+
+// Op bound to a keyboard key ("s"); labels are not keys, so "e" stays free
+constexpr std::optional<RpnOp> rpnOpFromShortcut(std::string_view key)
+{
+    if (key.empty()) return std::nullopt;
+    for (const RpnOpInfo &info : kRpnOps)
+        if (info.key == key) return info.op;
+    return std::nullopt;
+}
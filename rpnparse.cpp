@@ -0,0 +1,176 @@
+#include "rpnparse.h"
+
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <system_error>
+
+namespace {
+
+constexpr std::size_t kMaxNumberLength = 128;
+// Room for every digit of the widest decimal context plus grouping spaces
+constexpr std::size_t kMaxDecimalLength = 4 * RpnDecimalContext::kMaxDigits;
+
+bool isAsciiSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool isNbsp(std::string_view s, std::size_t i)
+{
+    return i + 1 < s.size() && s[i] == '\xC2' && s[i + 1] == '\xA0';
+}
+
+std::string_view trim(std::string_view s)
+{
+    for (;;) {
+        if (!s.empty() && isAsciiSpace(s.front())) s.remove_prefix(1);
+        else if (isNbsp(s, 0)) s.remove_prefix(2);
+        else break;
+    }
+    for (;;) {
+        if (!s.empty() && isAsciiSpace(s.back())) s.remove_suffix(1);
+        else if (s.size() >= 2 && isNbsp(s, s.size() - 2)) s.remove_suffix(2);
+        else break;
+    }
+    return s;
+}
+
+// The whole of `s` must be a plain C-locale double (an optional leading '+' is allowed)
+bool parsePlain(std::string_view s, double &value)
+{
+    if (!s.empty() && s.front() == '+') {
+        s.remove_prefix(1);
+        if (!s.empty() && (s.front() == '+' || s.front() == '-')) return false;
+    }
+    if (s.empty()) return false;
+    const char *end = s.data() + s.size();
+    const auto res = std::from_chars(s.data(), end, value, std::chars_format::general);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+// ',' -> '.', spaces and NBSP dropped; `out` has room for t.size() chars
+std::size_t cleanup(std::string_view t, char *out)
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < t.size(); ++i) {
+        const char c = t[i];
+        if (c == ' ') continue;
+        if (isNbsp(t, i)) { ++i; continue; }
+        out[n++] = (c == ',') ? '.' : c;
+    }
+    return n;
+}
+
+// Calls f(field) for every non-empty, trimmed field of a bulk import
+template <typename F>
+void forEachField(std::string_view text, F &&f)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p != end) {
+        const char *start = p;
+        while (p != end && *p != '\n' && *p != '\r' && *p != '\t' && *p != ';') ++p;
+        const std::string_view field = trim(std::string_view(start, std::size_t(p - start)));
+        if (p != end) ++p;
+        if (!field.empty()) f(field);
+    }
+}
+
+bool parseInt(std::string_view s, int &value)
+{
+    if (!s.empty() && s.front() == '+') s.remove_prefix(1);
+    if (s.empty()) return false;
+    const char *end = s.data() + s.size();
+    const auto res = std::from_chars(s.data(), end, value);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+} // namespace
+
+bool rpnParseNumber(std::string_view text, double &value)
+{
+    const std::string_view t = trim(text);
+    if (t.empty() || t.size() > kMaxNumberLength) return false;
+
+    // 1. Cleanup into a local buffer: ',' -> '.', drop spaces and NBSP
+    char buf[kMaxNumberLength];
+    const std::string_view s(buf, cleanup(t, buf));
+
+    double v = 0.0;
+    bool status = false;
+
+    // 2. Handle scientific notation "a*10^b" as "aEb"
+    if (const std::size_t splitIdx = s.find("*10^"); splitIdx != std::string_view::npos && splitIdx > 0) {
+        const std::string_view aStr = s.substr(0, splitIdx);
+        const std::string_view bStr = s.substr(splitIdx + 4);
+
+        char sci[kMaxNumberLength + 1];
+        std::size_t m = 0;
+        for (char c : aStr) sci[m++] = c;
+        sci[m++] = 'E';
+        for (char c : bStr) sci[m++] = c;
+        status = parsePlain(std::string_view(sci, m), v);
+
+        // Fallback: mantissa and integer exponent parsed separately
+        if (!status) {
+            double a = 0.0;
+            int b = 0;
+            if (parsePlain(aStr, a) && parseInt(bStr, b)) {
+                v = a * std::pow(10.0, b);
+                status = true;
+            }
+        }
+    } else {
+        // 3. Standard parsing (e.g. 123.45)
+        status = parsePlain(s, v);
+    }
+
+    if (!status || !std::isfinite(v)) return false;
+    value = v;
+    return true;
+}
+
+bool rpnParseDecimal(std::string_view text, RpnDecimal &value, const RpnDecimalContext &ctx)
+{
+    const std::string_view t = trim(text);
+    if (t.empty() || t.size() > kMaxDecimalLength) return false;
+
+    std::string s(t.size(), '\0');
+    s.resize(cleanup(t, s.data()));
+    // "a*10^b" is exactly "aEb" here: no double rounding to work around
+    if (const std::size_t splitIdx = s.find("*10^"); splitIdx != std::string::npos && splitIdx > 0)
+        s.replace(splitIdx, 4, "E");
+
+    RpnDecimal v;
+    if (!RpnDecimal::fromChars(s, v, ctx) || !v.isFinite()) return false;
+    value = std::move(v);
+    return true;
+}
+
+std::size_t rpnParseNumbers(std::string_view text, std::vector<double> &out, std::size_t *rejected)
+{
+    const std::size_t before = out.size();
+    std::size_t bad = 0;
+    forEachField(text, [&](std::string_view field) {
+        double v = 0.0;
+        if (rpnParseNumber(field, v)) out.push_back(v);
+        else ++bad;
+    });
+    if (rejected) *rejected = bad;
+    return out.size() - before;
+}
+
+std::size_t rpnParseDecimals(std::string_view text, std::vector<RpnDecimal> &out,
+                             const RpnDecimalContext &ctx, std::size_t *rejected)
+{
+    const std::size_t before = out.size();
+    std::size_t bad = 0;
+    forEachField(text, [&](std::string_view field) {
+        RpnDecimal v;
+        if (rpnParseDecimal(field, v, ctx)) out.push_back(std::move(v));
+        else ++bad;
+    });
+    if (rejected) *rejected = bad;
+    return out.size() - before;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "rpndecimal.h"
+
+// Parses one number with the same rules as RpnStackModel::parseInput(),
+// without allocating: surrounding whitespace is ignored, ',' is a decimal
+// point, spaces and NBSP inside the number are dropped, and "a*10^b" means
+// a * 10^b. Only finite values are accepted. `text` is UTF-8.
+bool rpnParseNumber(std::string_view text, double &value);
+
+// Same rules for the decimal backends, rounded to `ctx`. No detour
+// through double, so "0,1" is exactly 0.1.
+bool rpnParseDecimal(std::string_view text, RpnDecimal &value, const RpnDecimalContext &ctx);
+
+// Parses a list of numbers in one pass, e.g. pasted from a spreadsheet.
+// Fields are separated by line breaks, tabs and ';', and each field follows
+// rpnParseNumber() (so "1 234,5" is one value). Empty fields are skipped and
+// fields that are not numbers are counted in `rejected`. Values are appended
+// to `out`; returns how many were appended.
+std::size_t rpnParseNumbers(std::string_view text, std::vector<double> &out,
+                            std::size_t *rejected = nullptr);
+std::size_t rpnParseDecimals(std::string_view text, std::vector<RpnDecimal> &out,
+                             const RpnDecimalContext &ctx, std::size_t *rejected = nullptr);
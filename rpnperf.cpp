@@ -0,0 +1,124 @@
+#include "rpnperf.h"
+
+#ifdef RPNCALC_PERF
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{ 0 };
+
+std::deque<RpnPerfProbe> &probeList()
+{
+    static std::deque<RpnPerfProbe> list;
+    return list;
+}
+
+std::deque<RpnPerfCounter> &counterList()
+{
+    static std::deque<RpnPerfCounter> list;
+    return list;
+}
+
+// Values below 8 get a bucket each; above that, the top three bits below
+// the leading one pick the sub-bucket
+int bucketOf(std::uint64_t ns)
+{
+    constexpr int sub = 1 << RpnPerfHistogram::kSubBits;
+    if (ns < std::uint64_t(sub)) return int(ns);
+    const int shift = 63 - std::countl_zero(ns) - RpnPerfHistogram::kSubBits;
+    return (shift + 1) * sub + int((ns >> shift) & (sub - 1));
+}
+
+std::uint64_t bucketTop(int bucket)
+{
+    constexpr int sub = 1 << RpnPerfHistogram::kSubBits;
+    if (bucket < sub) return std::uint64_t(bucket);
+    const int shift = bucket / sub - 1;
+    const std::uint64_t low = std::uint64_t(sub + bucket % sub) << shift;
+    return low + (std::uint64_t(1) << shift) - 1;
+}
+
+} // namespace
+
+// --- HISTOGRAM ---
+
+void RpnPerfHistogram::add(std::uint64_t ns)
+{
+    ++m_counts[std::size_t(bucketOf(ns))];
+    ++m_count;
+    m_sum += ns;
+    m_max = std::max(m_max, ns);
+}
+
+std::uint64_t RpnPerfHistogram::percentile(double p) const
+{
+    if (m_count == 0) return 0;
+    const double clamped = std::clamp(p, 0.0, 100.0);
+    // Rank of the sample, 1-based
+    const std::uint64_t rank = std::max<std::uint64_t>(1, std::uint64_t(clamped / 100.0 * double(m_count) + 0.5));
+    std::uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += m_counts[std::size_t(b)];
+        if (seen >= rank) return std::min(bucketTop(b), m_max);
+    }
+    return m_max;
+}
+
+// --- REGISTRY ---
+
+RpnPerfProbe &RpnPerf::probe(const char *name)
+{
+    for (RpnPerfProbe &p : probeList())
+        if (std::strcmp(p.name, name) == 0) return p;
+    return probeList().emplace_back(RpnPerfProbe{ name, {}, 0 });
+}
+
+RpnPerfCounter &RpnPerf::counter(const char *name)
+{
+    for (RpnPerfCounter &c : counterList())
+        if (std::strcmp(c.name, name) == 0) return c;
+    return counterList().emplace_back(RpnPerfCounter{ name, 0 });
+}
+
+const std::deque<RpnPerfProbe> &RpnPerf::probes() { return probeList(); }
+const std::deque<RpnPerfCounter> &RpnPerf::counters() { return counterList(); }
+
+std::uint64_t RpnPerf::allocations() { return g_allocations.load(std::memory_order_relaxed); }
+
+void RpnPerf::reset()
+{
+    for (RpnPerfProbe &p : probeList()) {
+        p.latency = {};
+        p.allocations = 0;
+    }
+    for (RpnPerfCounter &c : counterList()) c.value = 0;
+}
+
+// --- ALLOCATION COUNT ---
+// Replaces the global operator new/delete; the default nothrow forms call
+// these. Over-aligned allocations are not counted.
+
+void *operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+// Latency and counter instrumentation, built only with -DRPNCALC_PERF=ON
+// (defines RPNCALC_PERF). Otherwise RPN_PERF_SCOPE / RPN_PERF_COUNT expand
+// to nothing and none of this is compiled.
+//
+//     RPN_PERF_SCOPE("engine.op");      // times the rest of the block
+//     RPN_PERF_COUNT("model.notify");   // bumps a counter
+//
+// Probes and counters are registered on first use (one lookup per call
+// site) and must only be used from the GUI thread. The allocation count
+// covers every thread.
+
+#ifdef RPNCALC_PERF
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+// Latency histogram: 8 linear sub-buckets per power of two nanoseconds,
+// so percentiles are within 12.5% and adding a sample is a few instructions
+class RpnPerfHistogram
+{
+public:
+    static constexpr int kSubBits = 3;
+    static constexpr int kBuckets = 64 << kSubBits;
+
+    void add(std::uint64_t ns);
+    std::uint64_t count() const { return m_count; }
+    std::uint64_t sum() const { return m_sum; }
+    std::uint64_t max() const { return m_max; }
+    // Upper edge of the bucket holding the p-th percentile (p in 0..100)
+    std::uint64_t percentile(double p) const;
+
+private:
+    std::array<std::uint64_t, kBuckets> m_counts{};
+    std::uint64_t m_count = 0;
+    std::uint64_t m_sum = 0;
+    std::uint64_t m_max = 0;
+};
+
+struct RpnPerfProbe {
+    const char *name;
+    RpnPerfHistogram latency;
+    std::uint64_t allocations = 0; // operator new calls inside the scopes
+};
+
+struct RpnPerfCounter {
+    const char *name;
+    std::uint64_t value = 0;
+};
+
+class RpnPerf
+{
+public:
+    // `name` must outlive the program (a string literal)
+    static RpnPerfProbe &probe(const char *name);
+    static RpnPerfCounter &counter(const char *name);
+
+    // Registration order; references stay valid
+    static const std::deque<RpnPerfProbe> &probes();
+    static const std::deque<RpnPerfCounter> &counters();
+
+    // operator new calls since start-up, all threads
+    static std::uint64_t allocations();
+
+    // Clears samples and counts, keeps the registrations
+    static void reset();
+};
+
+class RpnPerfScope
+{
+public:
+    explicit RpnPerfScope(RpnPerfProbe &probe)
+        : m_probe(probe), m_allocations(RpnPerf::allocations()), m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~RpnPerfScope()
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+        m_probe.latency.add(std::uint64_t(ns));
+        m_probe.allocations += RpnPerf::allocations() - m_allocations;
+    }
+
+    RpnPerfScope(const RpnPerfScope &) = delete;
+    RpnPerfScope &operator=(const RpnPerfScope &) = delete;
+
+private:
+    RpnPerfProbe &m_probe;
+    std::uint64_t m_allocations;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define RPN_PERF_CONCAT2(a, b) a##b
+#define RPN_PERF_CONCAT(a, b) RPN_PERF_CONCAT2(a, b)
+#define RPN_PERF_SCOPE(name)                                                                    \
+    static RpnPerfProbe &RPN_PERF_CONCAT(rpnPerfProbe, __LINE__) = RpnPerf::probe(name);        \
+    const RpnPerfScope RPN_PERF_CONCAT(rpnPerfScope, __LINE__)(RPN_PERF_CONCAT(rpnPerfProbe, __LINE__))
+#define RPN_PERF_COUNT(name)                                                                    \
+    do {                                                                                        \
+        static RpnPerfCounter &rpnPerfCounter = RpnPerf::counter(name);                         \
+        ++rpnPerfCounter.value;                                                                 \
+    } while (false)
+
+#else
+
+#define RPN_PERF_SCOPE(name) static_cast<void>(0)
+#define RPN_PERF_COUNT(name) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,160 @@
+#include "rpnperfmonitor.h"
+#include "rpnperf.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QEvent>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQuickWindow>
+#include <QStandardPaths>
+
+#include <chrono>
+
+namespace {
+
+[[maybe_unused]] qint64 nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+RpnPerfMonitor::RpnPerfMonitor(QObject *parent)
+    : QObject(parent)
+{
+    m_timer.setInterval(500);
+    connect(&m_timer, &QTimer::timeout, this, &RpnPerfMonitor::refresh);
+}
+
+void RpnPerfMonitor::setActive(bool active)
+{
+    if (!available() || m_active == active) return;
+    m_active = active;
+    if (m_active) {
+        refresh();
+        m_timer.start();
+    } else {
+        m_timer.stop();
+    }
+    emit activeChanged();
+}
+
+void RpnPerfMonitor::watch(QQuickWindow *window)
+{
+#ifdef RPNCALC_PERF
+    if (!window) return;
+    QCoreApplication::instance()->installEventFilter(this);
+
+    // Both run on the render thread. The GUI thread is blocked while a frame
+    // synchronizes, so input handled before that is what the frame shows.
+    connect(window, &QQuickWindow::beforeSynchronizing, this, [this] {
+        const qint64 input = m_inputAt.exchange(0);
+        qint64 none = 0;
+        if (input) m_syncedAt.compare_exchange_strong(none, input);
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::frameSwapped, this, [this] {
+        const qint64 input = m_syncedAt.exchange(0);
+        if (!input) return;
+        const qint64 ns = nowNs() - input;
+        QMetaObject::invokeMethod(this, [ns] {
+            static RpnPerfProbe &probe = RpnPerf::probe("input.to_frame");
+            probe.latency.add(std::uint64_t(ns));
+        }, Qt::QueuedConnection);
+    }, Qt::DirectConnection);
+#else
+    Q_UNUSED(window);
+#endif
+}
+
+bool RpnPerfMonitor::eventFilter(QObject *watched, QEvent *event)
+{
+#ifdef RPNCALC_PERF
+    const QEvent::Type type = event->type();
+    if (type == QEvent::KeyPress || type == QEvent::MouseButtonPress) {
+        qint64 none = 0;
+        m_inputAt.compare_exchange_strong(none, nowNs());
+    }
+#endif
+    return QObject::eventFilter(watched, event);
+}
+
+void RpnPerfMonitor::reset()
+{
+#ifdef RPNCALC_PERF
+    RpnPerf::reset();
+    refresh();
+#endif
+}
+
+void RpnPerfMonitor::refresh()
+{
+#ifdef RPNCALC_PERF
+    // One line per probe: samples, p50/p90/p99/max in µs, allocations per call
+    auto us = [](std::uint64_t ns) { return QString::number(double(ns) / 1000.0, 'f', 1); };
+    QString text = QStringLiteral("probe  n  p50 p90 p99 max µs  alloc/op\n");
+    for (const RpnPerfProbe &p : RpnPerf::probes()) {
+        const RpnPerfHistogram &h = p.latency;
+        if (h.count() == 0) continue;
+        text += QString("%1  %2  %3 %4 %5 %6  %7\n")
+                    .arg(QLatin1String(p.name)).arg(h.count())
+                    .arg(us(h.percentile(50)), us(h.percentile(90)), us(h.percentile(99)), us(h.max()))
+                    .arg(double(p.allocations) / double(h.count()), 0, 'f', 1);
+    }
+    for (const RpnPerfCounter &c : RpnPerf::counters())
+        text += QString("%1  %2\n").arg(QLatin1String(c.name)).arg(c.value);
+    text += QString("allocations  %1").arg(RpnPerf::allocations());
+
+    if (text == m_summary) return;
+    m_summary = text;
+    emit updated();
+#endif
+}
+
+QString RpnPerfMonitor::dumpJson(const QString &path) const
+{
+#ifdef RPNCALC_PERF
+    QJsonArray probes;
+    for (const RpnPerfProbe &p : RpnPerf::probes()) {
+        const RpnPerfHistogram &h = p.latency;
+        QJsonObject o;
+        o["name"] = QString::fromLatin1(p.name);
+        o["count"] = double(h.count());
+        o["mean_ns"] = h.count() ? double(h.sum()) / double(h.count()) : 0.0;
+        o["p50_ns"] = double(h.percentile(50));
+        o["p90_ns"] = double(h.percentile(90));
+        o["p99_ns"] = double(h.percentile(99));
+        o["max_ns"] = double(h.max());
+        o["allocations"] = double(p.allocations);
+        probes.append(o);
+    }
+    QJsonObject counters;
+    for (const RpnPerfCounter &c : RpnPerf::counters())
+        counters[QLatin1String(c.name)] = double(c.value);
+
+    QJsonObject root;
+    root["probes"] = probes;
+    root["counters"] = counters;
+    root["allocations"] = double(RpnPerf::allocations());
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+    QString file = path;
+    if (file.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        file = dir + QStringLiteral("/perf-")
+               + QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss")) + QStringLiteral(".json");
+    }
+    QFile f(file);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return {};
+    f.write(QJsonDocument(root).toJson());
+    return file;
+#else
+    Q_UNUSED(path);
+    return {};
+#endif
+}
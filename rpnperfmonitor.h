@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <atomic>
+
+class QQuickWindow;
+
+// QML face of rpnperf.h: a text summary for the overlay, a JSON dump and
+// input-to-frame latency (key or mouse press until the next frame is on
+// screen). In builds without RPNCALC_PERF `available` is false and
+// everything else is a no-op.
+class RpnPerfMonitor final : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool available READ available CONSTANT)
+    // Refreshes `summary` twice a second while true (the overlay is shown)
+    Q_PROPERTY(bool active READ active WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(QString summary READ summary NOTIFY updated)
+
+public:
+    explicit RpnPerfMonitor(QObject *parent = nullptr);
+
+    static constexpr bool available()
+    {
+#ifdef RPNCALC_PERF
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool active() const { return m_active; }
+    void setActive(bool active);
+    QString summary() const { return m_summary; }
+
+    // Starts measuring input-to-frame latency for `window`
+    Q_INVOKABLE void watch(QQuickWindow *window);
+    // Writes every probe and counter; an empty `path` goes to the app data
+    // directory. Returns the file written, or an empty string.
+    Q_INVOKABLE QString dumpJson(const QString &path = QString()) const;
+    Q_INVOKABLE void reset();
+
+signals:
+    void activeChanged();
+    void updated();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void refresh();
+
+    bool m_active = false;
+    QString m_summary;
+    QTimer m_timer;
+    // Steady-clock ns; 0 = none. The render thread reads them, hence atomic.
+    std::atomic<qint64> m_inputAt{ 0 };  // oldest input no frame has picked up yet
+    std::atomic<qint64> m_syncedAt{ 0 }; // input the frame being rendered reflects
+};
@@ -0,0 +1,169 @@
+#include "rpnprogram.h"
+#include "rpnparse.h"
+
+#include <algorithm>
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+} // namespace
+
+std::optional<RpnProgram> RpnProgram::compile(std::string_view source, CompileError *error)
+{
+    RpnProgram p;
+
+    // Depth relative to the entry top until a clear, absolute after it
+    long long rel = 0;
+    std::size_t abs = 0;
+    bool absolute = false;
+
+    auto fail = [&](std::size_t token, std::string_view text, std::string message) {
+        if (error) *error = { token, std::string(text), std::move(message) };
+        return std::nullopt;
+    };
+
+    const char *s = source.data();
+    const char *end = s + source.size();
+    for (std::size_t token = 0;; ++token) {
+        while (s != end && isSpace(*s)) ++s;
+        if (s == end) break;
+        const char *start = s;
+        while (s != end && !isSpace(*s)) ++s;
+        const std::string_view text(start, std::size_t(s - start));
+
+        Instr in;
+        int need = 0;
+        int net = 1;
+        RpnError underflow = RpnError::NotEnoughArgs;
+
+        double v = 0.0;
+        if (rpnParseNumber(text, v)) {
+            in.arg = std::uint32_t(p.m_constants.size());
+            p.m_constants.push_back(v);
+        } else {
+            const std::optional<RpnOp> op = rpnOpFromToken(text);
+            if (!op) return fail(token, text, rpnErrorText(RpnError::InvalidNumber));
+            const RpnOpInfo &info = rpnOpInfo(*op);
+            switch (info.kind) {
+                case RpnOpKind::Push:
+                    // Constants are plain pushes
+                    info.kernel(nullptr, v);
+                    in.arg = std::uint32_t(p.m_constants.size());
+                    p.m_constants.push_back(v);
+                    break;
+                case RpnOpKind::Unary: in.op = Opcode::Unary; in.arg = std::uint32_t(*op); need = 1; net = 0; break;
+                case RpnOpKind::Binary:
+                    // Plain arithmetic runs inline, everything else through its kernel
+                    in.op = *op == RpnOp::Add ? Opcode::Add
+                          : *op == RpnOp::Sub ? Opcode::Sub
+                          : *op == RpnOp::Mul ? Opcode::Mul
+                                              : Opcode::Binary;
+                    in.arg = std::uint32_t(*op);
+                    need = 2;
+                    net = -1;
+                    break;
+                case RpnOpKind::Stack:
+                    switch (*op) {
+                        case RpnOp::Dup: in.op = Opcode::Dup; need = 1; underflow = RpnError::EmptyDup; break;
+                        case RpnOp::Drop: in.op = Opcode::Drop; need = 1; net = -1; underflow = RpnError::EmptyDrop; break;
+                        case RpnOp::Swap: in.op = Opcode::Swap; need = 2; net = 0; break;
+                        default: in.op = Opcode::Clear; net = 0; break;
+                    }
+                    break;
+            }
+        }
+
+        const std::size_t pc = p.m_code.size();
+        if (absolute) {
+            // Depth is known exactly: an underflow here would fail on every run
+            if (abs < std::size_t(need)) {
+                RpnOpResult r;
+                r.error = underflow;
+                r.need = need;
+                return fail(token, text, rpnErrorText(r));
+            }
+        } else if (need - rel > 0 && std::size_t(need - rel) > p.m_inputs) {
+            p.m_inputs = std::size_t(need - rel);
+            p.m_checks.push_back({ pc, p.m_inputs, need, underflow });
+        }
+
+        if (in.op == Opcode::Clear) {
+            absolute = true;
+            abs = 0;
+            p.m_wholeStack = true;
+        } else if (absolute) {
+            abs = std::size_t(std::ptrdiff_t(abs) + net);
+            p.m_peakAfterClear = std::max(p.m_peakAfterClear, abs);
+        } else {
+            rel += net;
+            if (rel > 0) p.m_growth = std::max(p.m_growth, std::size_t(rel));
+        }
+        p.m_code.push_back(in);
+    }
+    return p;
+}
+
+RpnRunResult RpnProgram::run(std::vector<double> &stack) const
+{
+    RpnRunResult res;
+    const std::size_t entry = stack.size();
+
+    // Too shallow: run up to the first instruction that would underflow
+    std::size_t stop = m_code.size();
+    const DepthCheck *underflow = nullptr;
+    if (entry < m_inputs) {
+        for (const DepthCheck &check : m_checks) {
+            if (check.entryDepth > entry) {
+                underflow = &check;
+                stop = check.pc;
+                break;
+            }
+        }
+    }
+
+    stack.resize(std::max(entry + m_growth, m_peakAfterClear));
+    double *const base = stack.data();
+    double *sp = base + entry; // one past the top
+
+    const Instr *const code = m_code.data();
+    const double *const constants = m_constants.data();
+    double value = 0.0;
+    std::size_t pc = 0;
+    for (; pc < stop; ++pc) {
+        const Instr in = code[pc];
+        switch (in.op) {
+            case Opcode::Push: *sp++ = constants[in.arg]; continue;
+            case Opcode::Add: sp[-2] = sp[-2] + sp[-1]; --sp; continue;
+            case Opcode::Sub: sp[-2] = sp[-2] - sp[-1]; --sp; continue;
+            case Opcode::Mul: sp[-2] = sp[-2] * sp[-1]; --sp; continue;
+            case Opcode::Binary:
+                if ((res.error = kRpnOps[in.arg].kernel(sp - 2, value)) != RpnError::None) break;
+                sp[-2] = value;
+                --sp;
+                continue;
+            case Opcode::Unary:
+                if ((res.error = kRpnOps[in.arg].kernel(sp - 1, value)) != RpnError::None) break;
+                sp[-1] = value;
+                continue;
+            case Opcode::Dup: *sp = sp[-1]; ++sp; continue;
+            case Opcode::Drop: --sp; continue;
+            case Opcode::Swap: std::swap(sp[-1], sp[-2]); continue;
+            case Opcode::Clear: sp = base; continue;
+        }
+        // Value check failed; the stack is as it was before this instruction
+        break;
+    }
+
+    stack.resize(std::size_t(sp - base));
+    res.executed = pc;
+    res.pc = pc;
+    if (res.ok() && underflow) {
+        res.error = underflow->error;
+        res.need = underflow->need;
+    }
+    return res;
+}
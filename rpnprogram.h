@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+
+struct RpnRunResult {
+    RpnError error = RpnError::None;
+    int need = 0;               // NotEnoughArgs: depth the failing op needed
+    std::size_t pc = 0;         // failing instruction (= token index)
+    std::size_t executed = 0;   // instructions applied before stopping
+
+    bool ok() const { return error == RpnError::None; }
+};
+
+// An RPN program ("3 4 + 5 *") compiled to bytecode.
+// Numbers are parsed and op names resolved once, and the stack depth every
+// instruction needs is worked out at compile time: run() compares the entry
+// depth once and then executes over a flat double buffer with no per-op
+// depth checks. Only value checks (division by zero, ...) remain at run time.
+class RpnProgram
+{
+public:
+    struct CompileError {
+        std::size_t token = 0;
+        std::string text;
+        std::string message;
+    };
+
+    static std::optional<RpnProgram> compile(std::string_view source, CompileError *error = nullptr);
+
+    std::size_t size() const { return m_code.size(); }
+    bool empty() const { return m_code.empty(); }
+    // Values taken from the entry stack; the whole stack if usesWholeStack()
+    std::size_t inputs() const { return m_inputs; }
+    bool usesWholeStack() const { return m_wholeStack; }
+
+    // Runs on `stack` (bottom-to-top) in place. Stops at the first failing
+    // instruction; the ones before it stay applied, like separate ops would.
+    RpnRunResult run(std::vector<double> &stack) const;
+
+private:
+    enum class Opcode : std::uint8_t {
+        Push,
+        Add, Sub, Mul,  // inline
+        Unary, Binary,  // kernel of kRpnOps[arg]
+        Dup, Drop, Swap, Clear
+    };
+
+    struct Instr {
+        Opcode op = Opcode::Push;
+        std::uint32_t arg = 0; // Push: index into m_constants; Unary/Binary: RpnOp
+    };
+
+    // First instruction that needs a deeper entry stack than any before it
+    struct DepthCheck {
+        std::size_t pc = 0;
+        std::size_t entryDepth = 0;
+        int need = 0;
+        RpnError error = RpnError::NotEnoughArgs;
+    };
+
+    std::vector<Instr> m_code;
+    std::vector<double> m_constants;
+    std::vector<DepthCheck> m_checks;   // entryDepth strictly increasing
+    std::size_t m_inputs = 0;
+    std::size_t m_growth = 0;           // highest point above the entry top
+    std::size_t m_peakAfterClear = 0;   // highest point after a clear
+    bool m_wholeStack = false;
+};
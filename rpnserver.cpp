@@ -0,0 +1,260 @@
+#include "rpnserver.h"
+#include "rpnparse.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <charconv>
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+std::string_view nextWord(std::string_view &rest)
+{
+    std::size_t start = 0;
+    while (start < rest.size() && isSpace(rest[start])) ++start;
+    std::size_t end = start;
+    while (end < rest.size() && !isSpace(rest[end])) ++end;
+    const std::string_view word = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return word;
+}
+
+} // namespace
+
+// Everything but `socket`, `buffer` and `busy` belongs to the batch in flight
+// while `busy` is set; starting a batch and delivering finished() order the
+// accesses, so the fields need no lock of their own
+struct RpnServer::Client {
+    QLocalSocket *socket = nullptr;  // null once the client disconnected
+    QByteArray buffer;               // received, not yet a whole line
+    bool busy = false;
+
+    std::vector<std::string> lines;  // requests waiting for the next batch
+    std::vector<std::string> batch;  // requests of the batch in flight
+    std::string replies;
+
+    std::vector<double> stack;
+    RpnFormatter formatter;
+    bool shortest = true;
+};
+
+RpnServer::RpnServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &RpnServer::accept);
+}
+
+RpnServer::~RpnServer()
+{
+    m_threads.waitForDone();
+}
+
+QString RpnServer::defaultName()
+{
+    const QString user = qEnvironmentVariable("USER");
+    return user.isEmpty() ? QStringLiteral("rpncalc") : QStringLiteral("rpncalc-") + user;
+}
+
+bool RpnServer::listen(const QString &name)
+{
+    // Other users cannot connect
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (m_server->listen(name)) return true;
+
+    // The name is taken: by a live server, or by the socket file of one that died
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(500)) {
+        m_error = QStringLiteral("Another server is listening on %1.").arg(name);
+        return false;
+    }
+    QLocalServer::removeServer(name);
+    if (m_server->listen(name)) return true;
+    m_error = m_server->errorString();
+    return false;
+}
+
+void RpnServer::setDefaultFormat(int mode, int precision)
+{
+    m_mode = mode;
+    m_precision = precision;
+}
+
+// --- CONNECTIONS ---
+
+void RpnServer::accept()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        auto client = std::make_shared<Client>();
+        client->socket = socket;
+        client->shortest = m_mode < 0;
+        if (!client->shortest) client->formatter.setFormat(m_mode, m_precision);
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, client] { read(client); });
+        connect(socket, &QLocalSocket::disconnected, this, [client] {
+            // A running batch still holds the client; its replies go nowhere
+            client->socket->deleteLater();
+            client->socket = nullptr;
+        });
+    }
+}
+
+void RpnServer::read(const std::shared_ptr<Client> &client)
+{
+    client->buffer += client->socket->readAll();
+    qsizetype start = 0;
+    for (qsizetype nl; (nl = client->buffer.indexOf('\n', start)) >= 0; start = nl + 1) {
+        qsizetype end = nl;
+        if (end > start && client->buffer.at(end - 1) == '\r') --end;
+        client->lines.emplace_back(client->buffer.constData() + start, std::size_t(end - start));
+    }
+    client->buffer.remove(0, start);
+
+    if (client->buffer.size() > kMaxLine) {
+        client->socket->write("ERR Request too long.\n");
+        client->socket->disconnectFromServer();
+        return;
+    }
+    dispatch(client);
+}
+
+void RpnServer::dispatch(const std::shared_ptr<Client> &client)
+{
+    if (client->busy || client->lines.empty()) return;
+    client->busy = true;
+    client->batch.swap(client->lines);
+    m_threads.start([this, client] {
+        evaluate(*client);
+        QMetaObject::invokeMethod(this, [this, client] { finished(client); }, Qt::QueuedConnection);
+    });
+}
+
+void RpnServer::finished(const std::shared_ptr<Client> &client)
+{
+    client->busy = false;
+    client->batch.clear();
+    if (!client->socket) return;
+    client->socket->write(client->replies.data(), qint64(client->replies.size()));
+    client->replies.clear();
+    // Lines that came in while the batch ran
+    dispatch(client);
+}
+
+// --- EVALUATION ---
+
+std::unique_ptr<RpnCore> RpnServer::borrowCore()
+{
+    {
+        const std::lock_guard lock(m_poolMutex);
+        if (!m_cores.empty()) {
+            std::unique_ptr<RpnCore> core = std::move(m_cores.back());
+            m_cores.pop_back();
+            return core;
+        }
+    }
+    auto core = std::make_unique<RpnCore>();
+    // Each line is one undo group, undone if a token fails. Whole groups
+    // are kept, so a limit of one step holds just the current line.
+    core->setUndoLimit(1);
+    return core;
+}
+
+void RpnServer::returnCore(std::unique_ptr<RpnCore> core)
+{
+    const std::lock_guard lock(m_poolMutex);
+    m_cores.push_back(std::move(core));
+}
+
+void RpnServer::evaluate(Client &client)
+{
+    std::unique_ptr<RpnCore> core = borrowCore();
+    core->restore(std::move(client.stack));
+    for (const std::string &line : client.batch) evaluateLine(line, *core, client);
+    client.stack = core->take();
+    returnCore(std::move(core));
+}
+
+void RpnServer::evaluateLine(std::string_view line, RpnCore &core, Client &client) const
+{
+    std::string_view rest = line;
+    while (!rest.empty() && isSpace(rest.front())) rest.remove_prefix(1);
+    if (rest.starts_with(':')) {
+        client.replies += command(rest.substr(1), client) ? "OK\n" : "ERR Unknown command.\n";
+        return;
+    }
+
+    // The marker opens the group, so the undo below never reaches an
+    // earlier line even when this one failed before changing anything
+    core.beginGroup();
+    core.recordMarker(0);
+    std::size_t token = 0;
+    for (std::string_view text; !(text = nextWord(rest)).empty();) {
+        ++token;
+        double v = 0.0;
+        if (rpnParseNumber(text, v)) {
+            core.push(v);
+            continue;
+        }
+        std::string message;
+        if (const std::optional<RpnOp> op = rpnOpFromToken(text)) {
+            const RpnOpResult r = core.apply(*op);
+            if (r.ok()) continue;
+            message = rpnErrorText(r);
+        } else {
+            message = rpnErrorText(RpnError::InvalidNumber);
+        }
+        core.endGroup();
+        core.undo();
+        client.replies += "ERR " + message + " (token " + std::to_string(token) + ")\n";
+        return;
+    }
+
+    core.endGroup();
+
+    // Top of the stack first, like the GUI and headless mode
+    client.replies += "OK";
+    const std::vector<double> &stack = core.values();
+    char buf[32];
+    for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
+        client.replies += '\t';
+        if (client.shortest) {
+            const auto res = std::to_chars(buf, buf + sizeof(buf), *it);
+            client.replies.append(buf, res.ptr);
+        } else {
+            client.replies += client.formatter.format(*it).toStdString();
+        }
+    }
+    client.replies += '\n';
+}
+
+bool RpnServer::command(std::string_view line, Client &client) const
+{
+    if (nextWord(line) != "format") return false;
+    const std::string_view mode = nextWord(line);
+    const std::string_view digits = nextWord(line);
+    int precision = client.formatter.precision();
+    if (!digits.empty()) {
+        const auto res = std::from_chars(digits.data(), digits.data() + digits.size(), precision);
+        if (res.ec != std::errc() || res.ptr != digits.data() + digits.size()) return false;
+    }
+    if (!nextWord(line).empty()) return false;
+
+    if (mode == "shortest") {
+        client.shortest = true;
+        return true;
+    }
+    int m = -1;
+    if (mode == "scientific" || mode == "sci") m = RpnFormatter::Scientific;
+    else if (mode == "engineering" || mode == "eng") m = RpnFormatter::Engineering;
+    else if (mode == "simple") m = RpnFormatter::Simple;
+    if (m < 0) return false;
+    client.formatter.setFormat(m, precision);
+    client.shortest = false;
+    return true;
+}
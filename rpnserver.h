@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnformatter.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+// Calculation server for scripts: `appRpnCalcQuick --serve [--socket NAME]`
+// listens on a local socket (a Unix domain socket, a named pipe on Windows)
+// so a client pays a round trip instead of starting the application.
+//
+// Protocol, one line per request and one line per reply, in order:
+//   3 4 +            RPN tokens, applied to this client's stack
+//   (empty line)     just reports the stack
+//   :format simple 4 sets the output format for this client (scientific,
+//                    engineering, simple or shortest; precision optional)
+// Replies are "OK" followed by the whole stack, top first, each value after
+// a tab, or "ERR message (token N)"; a failed line leaves the stack as it
+// was. Numbers parse like RpnStackModel::parseInput and format like
+// formatValue. Every connection keeps its own stack; requests sent without
+// waiting for replies are evaluated together, on a core borrowed from a
+// pool shared by all clients, on a worker thread.
+class RpnServer final : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RpnServer(QObject *parent = nullptr);
+    ~RpnServer() override;
+
+    // rpncalc-$USER in the temp directory, where the rpnc client looks too
+    static QString defaultName();
+
+    // Takes over a socket left behind by a server that is gone
+    bool listen(const QString &name);
+    QString errorString() const { return m_error; }
+
+    // Output format of new clients; mode < 0 is the shortest round-trip value
+    void setDefaultFormat(int mode, int precision);
+
+private:
+    struct Client;
+
+    void accept();
+    void read(const std::shared_ptr<Client> &client);
+    // Hands the lines received so far to the pool, unless a batch is running
+    void dispatch(const std::shared_ptr<Client> &client);
+    void finished(const std::shared_ptr<Client> &client);
+
+    // Worker thread side
+    void evaluate(Client &client);
+    void evaluateLine(std::string_view line, RpnCore &core, Client &client) const;
+    bool command(std::string_view line, Client &client) const;
+    std::unique_ptr<RpnCore> borrowCore();
+    void returnCore(std::unique_ptr<RpnCore> core);
+
+    // A request line longer than this closes the connection
+    static constexpr qsizetype kMaxLine = qsizetype(1) << 20;
+
+    QLocalServer *m_server = nullptr;
+    QString m_error;
+    int m_mode = -1;
+    int m_precision = 15;
+
+    std::mutex m_poolMutex;
+    std::vector<std::unique_ptr<RpnCore>> m_cores;
+
+    // Last, so running batches finish before the rest is destroyed
+    QThreadPool m_threads;
+};
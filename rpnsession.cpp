@@ -0,0 +1,476 @@
+#include "rpnsession.h"
+
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char kSnapshotMagic[4] = { 'R', 'P', 'N', 'S' };
+constexpr char kJournalMagic[4] = { 'R', 'P', 'N', 'J' };
+constexpr quint32 kVersion = 1;
+// Files are written in native byte order; this tells a foreign one apart
+constexpr quint32 kByteOrder = 0x01020304;
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 flags;      // snapshot: kDecimalStack
+    quint64 generation;
+};
+
+// The snapshot stack is decimal text, one length-prefixed string per value
+constexpr quint32 kDecimalStack = 0x1;
+
+struct SnapshotCounts {
+    quint64 stack;
+    quint64 history;
+};
+
+// Record: u32 payload size, u8 type, payload, u32 checksum of type + payload
+constexpr qsizetype kRecordPrefix = 5;
+constexpr qsizetype kRecordOverhead = kRecordPrefix + 4;
+
+template <typename T>
+void put(QByteArray &out, const T &v)
+{
+    out.append(reinterpret_cast<const char *>(&v), qsizetype(sizeof(T)));
+}
+
+template <typename T>
+bool get(const char *&p, const char *end, T &v)
+{
+    if (end - p < qsizetype(sizeof(T))) return false;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+void putString(QByteArray &out, const QString &s)
+{
+    const QByteArray utf8 = s.toUtf8();
+    put(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+
+bool getString(const char *&p, const char *end, QString &s)
+{
+    quint32 len = 0;
+    if (!get(p, end, len) || end - p < qsizetype(len)) return false;
+    s = QString::fromUtf8(p, qsizetype(len));
+    p += len;
+    return true;
+}
+
+// Operation entry: kind, op, count, operands, result, then the
+// preformatted result (usually empty)
+void putEntry(QByteArray &out, const RpnHistoryEntry &e)
+{
+    put(out, quint8(e.kind));
+    put(out, e.op);
+    put(out, e.count);
+    put(out, e.operands);
+    put(out, e.result);
+    if (e.text.isEmpty()) put(out, quint32(0));
+    else putString(out, e.text);
+}
+
+bool getEntry(const char *&p, const char *end, RpnHistoryEntry &e)
+{
+    quint8 kind = 0;
+    if (!get(p, end, kind) || kind < quint8(RpnHistoryEntry::Kind::Op) || kind > quint8(RpnHistoryEntry::Kind::Bulk))
+        return false;
+    e.kind = RpnHistoryEntry::Kind(kind);
+    return get(p, end, e.op) && get(p, end, e.count) && get(p, end, e.operands) && get(p, end, e.result)
+           && getString(p, end, e.text);
+}
+
+void putDecimal(QByteArray &out, const RpnDecimal &v)
+{
+    const std::string text = v.toString();
+    put(out, quint32(text.size()));
+    out.append(text.data(), qsizetype(text.size()));
+}
+
+bool getDecimal(const char *&p, const char *end, RpnDecimal &v)
+{
+    quint32 len = 0;
+    if (!get(p, end, len) || end - p < qsizetype(len)) return false;
+    // Read back exactly, whatever precision the backend had
+    const bool ok = RpnDecimal::fromChars(std::string_view(p, len), v,
+                                          RpnDecimalContext::arbitrary(RpnDecimalContext::kMaxDigits));
+    p += len;
+    return ok;
+}
+
+// Slots [start, stop) of the new stack that a journal patch has to carry
+void patchRange(const RpnStackChanges &changes, std::size_t &start, std::size_t &stop)
+{
+    // Slots below `start` are unchanged
+    const std::size_t minSize = std::min(changes.oldSize, changes.newSize);
+    const std::size_t hi = std::min(changes.hi, minSize);
+    const bool dirty = changes.lo < hi;
+    start = dirty ? changes.lo : minSize;
+    stop = changes.newSize > minSize ? changes.newSize : (dirty ? hi : start);
+}
+
+// FNV-1a: catches torn and partly written records, not tampering
+quint32 checksum(const char *data, qsizetype n)
+{
+    quint32 h = 2166136261u;
+    for (qsizetype i = 0; i < n; ++i) {
+        h ^= quint8(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+FileHeader makeHeader(const char (&magic)[4], quint64 generation)
+{
+    FileHeader h{};
+    std::memcpy(h.magic, magic, 4);
+    h.version = kVersion;
+    h.byteOrder = kByteOrder;
+    h.generation = generation;
+    return h;
+}
+
+bool validHeader(const FileHeader &h, const char (&magic)[4])
+{
+    return std::memcmp(h.magic, magic, 4) == 0 && h.version == kVersion && h.byteOrder == kByteOrder;
+}
+
+// Maps `file` (already open); falls back to reading it
+struct FileView {
+    QByteArray copy;
+    const char *data = nullptr;
+    qint64 size = 0;
+
+    explicit FileView(QFile &file)
+    {
+        size = file.size();
+        if (size <= 0) return;
+        if (uchar *mapped = file.map(0, size)) {
+            data = reinterpret_cast<const char *>(mapped);
+        } else {
+            copy = file.readAll();
+            data = copy.constData();
+            size = copy.size();
+        }
+    }
+};
+
+} // namespace
+
+RpnSession::RpnSession()
+    : m_dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+{
+}
+
+RpnSession::~RpnSession() = default;
+
+void RpnSession::setDirectory(const QString &dir)
+{
+    if (m_journal.isOpen()) m_journal.close();
+    m_dir = dir;
+}
+
+QString RpnSession::snapshotPath() const { return m_dir + QStringLiteral("/session.bin"); }
+QString RpnSession::journalPath() const { return m_dir + QStringLiteral("/session.journal"); }
+
+// --- LOADING ---
+
+bool RpnSession::load(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history)
+{
+    stack.clear();
+    decimals.clear();
+    history.clear();
+    m_generation = 0;
+
+    const bool haveSnapshot = readSnapshot(stack, decimals, history);
+    m_validJournalSize = replayJournal(stack, decimals, history);
+    return haveSnapshot || m_validJournalSize > qint64(sizeof(FileHeader));
+}
+
+bool RpnSession::readSnapshot(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history)
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const FileView view(file);
+    const char *p = view.data;
+    const char *end = p + view.size;
+
+    FileHeader header{};
+    SnapshotCounts counts{};
+    if (!p || !get(p, end, header) || !validHeader(header, kSnapshotMagic) || !get(p, end, counts))
+        return false;
+    if (header.flags & kDecimalStack) {
+        // At least the length of every value must be there
+        if (quint64(end - p) / 4 < counts.stack) return false;
+        decimals.resize(std::size_t(counts.stack));
+        for (RpnDecimal &v : decimals)
+            if (!getDecimal(p, end, v)) return false;
+    } else {
+        if (quint64(end - p) / sizeof(double) < counts.stack) return false;
+        // The stack is stored exactly as RpnCore keeps it: one copy, no decoding
+        stack.resize(std::size_t(counts.stack));
+        if (counts.stack) std::memcpy(stack.data(), p, std::size_t(counts.stack) * sizeof(double));
+        p += counts.stack * sizeof(double);
+    }
+
+    history.reserve(qsizetype(std::min<quint64>(counts.history, quint64(end - p) / 4)));
+    QString line;
+    for (quint64 i = 0; i < counts.history && getString(p, end, line); ++i) history.append(RpnHistoryEntry::line(line));
+
+    m_generation = header.generation;
+    return true;
+}
+
+qint64 RpnSession::replayJournal(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history)
+{
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadOnly)) return -1;
+    const FileView view(file);
+    const char *const begin = view.data;
+    const char *p = begin;
+    const char *end = p + view.size;
+
+    FileHeader header{};
+    if (!p || !get(p, end, header) || !validHeader(header, kJournalMagic)) return -1;
+    // Already part of the snapshot (crash between save() steps), or foreign
+    if (header.generation != m_generation) return -1;
+
+    const char *good = p;
+    while (end - p >= kRecordOverhead) {
+        quint32 size = 0;
+        const char *q = p;
+        get(q, end, size);
+        if (end - q < qsizetype(size) + 5) break;
+        const char *typed = q;
+        const quint8 type = quint8(*q++);
+        const char *payloadEnd = q + size;
+        quint32 sum = 0;
+        const char *s = payloadEnd;
+        get(s, end, sum);
+        if (sum != checksum(typed, qsizetype(size) + 1)) break;
+
+        bool ok = true;
+        switch (type) {
+            case StackPatch: {
+                quint64 newSize = 0, start = 0, count = 0;
+                ok = get(q, payloadEnd, newSize) && get(q, payloadEnd, start) && get(q, payloadEnd, count)
+                     && start + count <= newSize && quint64(payloadEnd - q) == count * sizeof(double);
+                if (!ok) break;
+                stack.resize(std::size_t(newSize));
+                if (count) std::memcpy(stack.data() + start, q, std::size_t(count) * sizeof(double));
+                break;
+            }
+            case DecimalPatch: {
+                quint64 newSize = 0, start = 0, count = 0;
+                ok = get(q, payloadEnd, newSize) && get(q, payloadEnd, start) && get(q, payloadEnd, count)
+                     && start + count <= newSize && quint64(payloadEnd - q) / 4 >= count;
+                if (!ok) break;
+                decimals.resize(std::size_t(newSize));
+                for (quint64 i = 0; ok && i < count; ++i) ok = getDecimal(q, payloadEnd, decimals[std::size_t(start + i)]);
+                break;
+            }
+            case HistoryAdd: {
+                QString line;
+                ok = getString(q, payloadEnd, line);
+                if (ok) history.append(RpnHistoryEntry::line(line));
+                break;
+            }
+            case HistoryOp: {
+                RpnHistoryEntry entry;
+                ok = getEntry(q, payloadEnd, entry);
+                if (ok) history.append(entry);
+                break;
+            }
+            case HistoryDrop: {
+                quint32 n = 0;
+                ok = get(q, payloadEnd, n);
+                if (ok) history.resize(history.size() - std::min<qsizetype>(n, history.size()));
+                break;
+            }
+            case HistoryClear:
+                history.clear();
+                break;
+            case HistoryPrepend: {
+                quint32 n = 0;
+                QList<RpnHistoryEntry> lines;
+                ok = get(q, payloadEnd, n);
+                QString line;
+                for (quint32 i = 0; ok && i < n; ++i) {
+                    ok = getString(q, payloadEnd, line);
+                    if (ok) lines.append(RpnHistoryEntry::line(line));
+                }
+                if (ok) history = lines + history;
+                break;
+            }
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) break;
+        p = s;
+        good = p;
+    }
+    return qint64(good - begin);
+}
+
+// --- JOURNAL ---
+
+bool RpnSession::open()
+{
+    if (m_journal.isOpen()) return true;
+    QDir().mkpath(m_dir);
+    m_journal.setFileName(journalPath());
+
+    if (m_validJournalSize >= qint64(sizeof(FileHeader))) {
+        if (!m_journal.open(QIODevice::ReadWrite)) return false;
+        // Drop a torn record at the end so new records follow intact ones
+        if (m_journal.size() != m_validJournalSize) m_journal.resize(m_validJournalSize);
+        m_journal.seek(m_validJournalSize);
+        m_journalBytes = m_validJournalSize;
+        return true;
+    }
+    return startJournal();
+}
+
+bool RpnSession::startJournal()
+{
+    if (m_journal.isOpen()) m_journal.close();
+    m_journal.setFileName(journalPath());
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    const FileHeader header = makeHeader(kJournalMagic, m_generation);
+    m_journal.write(reinterpret_cast<const char *>(&header), qint64(sizeof(header)));
+    m_journal.flush();
+    m_journalBytes = qint64(sizeof(header));
+    m_validJournalSize = m_journalBytes;
+    return true;
+}
+
+void RpnSession::writeRecord(RecordType type)
+{
+    const quint32 size = quint32(m_record.size() - kRecordPrefix);
+    std::memcpy(m_record.data(), &size, sizeof(size));
+    m_record[4] = char(type);
+    put(m_record, checksum(m_record.constData() + 4, m_record.size() - 4));
+
+    m_journal.write(m_record);
+    // Hand the record to the OS right away: survives a crash of the app
+    m_journal.flush();
+    m_journalBytes += m_record.size();
+}
+
+void RpnSession::recordStack(const RpnCore::Changes &changes, const std::vector<double> &stack)
+{
+    if (!isOpen() || changes.empty()) return;
+
+    std::size_t start = 0, stop = 0;
+    patchRange(changes, start, stop);
+    m_record.resize(kRecordPrefix);
+    put(m_record, quint64(changes.newSize));
+    put(m_record, quint64(start));
+    put(m_record, quint64(stop - start));
+    m_record.append(reinterpret_cast<const char *>(stack.data() + start),
+                    qsizetype((stop - start) * sizeof(double)));
+    writeRecord(StackPatch);
+}
+
+void RpnSession::recordStack(const RpnCore::Changes &changes, const std::vector<RpnDecimal> &stack)
+{
+    if (!isOpen() || changes.empty()) return;
+
+    std::size_t start = 0, stop = 0;
+    patchRange(changes, start, stop);
+    m_record.resize(kRecordPrefix);
+    put(m_record, quint64(changes.newSize));
+    put(m_record, quint64(start));
+    put(m_record, quint64(stop - start));
+    for (std::size_t i = start; i < stop; ++i) putDecimal(m_record, stack[i]);
+    writeRecord(DecimalPatch);
+}
+
+void RpnSession::recordHistoryAdd(const RpnHistoryEntry &entry)
+{
+    if (!isOpen()) return;
+    m_record.resize(kRecordPrefix);
+    if (entry.kind == RpnHistoryEntry::Kind::Text) {
+        putString(m_record, entry.text);
+        writeRecord(HistoryAdd);
+        return;
+    }
+    putEntry(m_record, entry);
+    writeRecord(HistoryOp);
+}
+
+void RpnSession::recordHistoryDrop(qsizetype count)
+{
+    if (!isOpen() || count <= 0) return;
+    m_record.resize(kRecordPrefix);
+    put(m_record, quint32(count));
+    writeRecord(HistoryDrop);
+}
+
+void RpnSession::recordHistoryClear()
+{
+    if (!isOpen()) return;
+    m_record.resize(kRecordPrefix);
+    writeRecord(HistoryClear);
+}
+
+void RpnSession::recordHistoryPrepend(const QStringList &lines)
+{
+    if (!isOpen() || lines.isEmpty()) return;
+    m_record.resize(kRecordPrefix);
+    put(m_record, quint32(lines.size()));
+    for (const QString &line : lines) putString(m_record, line);
+    writeRecord(HistoryPrepend);
+}
+
+// --- SNAPSHOT ---
+
+bool RpnSession::save(const std::vector<double> &stack, const QStringList &history)
+{
+    const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(stack.data()),
+                                                   qsizetype(stack.size() * sizeof(double)));
+    return writeSnapshot(0, stack.size(), raw, history);
+}
+
+bool RpnSession::save(const std::vector<RpnDecimal> &stack, const QStringList &history)
+{
+    QByteArray text;
+    for (const RpnDecimal &v : stack) putDecimal(text, v);
+    return writeSnapshot(kDecimalStack, stack.size(), text, history);
+}
+
+bool RpnSession::writeSnapshot(quint32 flags, quint64 stackCount, const QByteArray &stack, const QStringList &history)
+{
+    QDir().mkpath(m_dir);
+    const quint64 generation = m_generation + 1;
+
+    QSaveFile file(snapshotPath());
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    FileHeader header = makeHeader(kSnapshotMagic, generation);
+    header.flags = flags;
+    const SnapshotCounts counts{ stackCount, quint64(history.size()) };
+    file.write(reinterpret_cast<const char *>(&header), qint64(sizeof(header)));
+    file.write(reinterpret_cast<const char *>(&counts), qint64(sizeof(counts)));
+    file.write(stack);
+
+    QByteArray lines;
+    for (const QString &line : history) putString(lines, line);
+    file.write(lines);
+    // Atomic rename: the old snapshot stays valid until this succeeds
+    if (!file.commit()) return false;
+
+    // The journal still has the old generation until it is restarted, so a
+    // crash right here just means it is ignored on the next load
+    m_generation = generation;
+    return startJournal();
+}
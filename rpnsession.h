@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnhistoryentry.h"
+
+// Binary session storage: a snapshot plus an append-only journal.
+//
+// session.bin      header, the stack as raw doubles (bottom-to-top) and the
+//                  history lines (oldest first); replaced atomically by save().
+//                  A decimal stack is stored as exact text instead.
+// session.journal  every change since that snapshot, one checksummed record
+//                  per change, written as it happens
+//
+// A crash loses at most the record being written: load() replays the
+// journal up to the last intact record. Both files carry a generation
+// number, so a journal that was already folded into a newer snapshot is
+// ignored.
+class RpnSession
+{
+public:
+    RpnSession();
+    ~RpnSession();
+
+    // Defaults to the application data location
+    void setDirectory(const QString &dir);
+    QString directory() const { return m_dir; }
+
+    // Reads the snapshot and replays the journal. False when there is no
+    // session on disk yet. The stack comes back in whichever of `stack` and
+    // `decimals` it was saved from; the other one stays empty.
+    bool load(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history);
+    // Starts journaling (after load(), so loading is not journaled)
+    bool open();
+    bool isOpen() const { return m_journal.isOpen(); }
+
+    // --- JOURNAL ---
+    void recordStack(const RpnCore::Changes &changes, const std::vector<double> &stack);
+    void recordStack(const RpnCore::Changes &changes, const std::vector<RpnDecimal> &stack);
+    // Operation entries are journaled as numbers, not text
+    void recordHistoryAdd(const RpnHistoryEntry &entry);
+    void recordHistoryDrop(qsizetype count);   // newest lines
+    void recordHistoryClear();
+    void recordHistoryPrepend(const QStringList &lines); // oldest first
+
+    // The journal has grown enough that a new snapshot is worth writing
+    bool needsCompaction() const { return m_journalBytes > kCompactBytes; }
+
+    // Writes a snapshot and starts an empty journal
+    bool save(const std::vector<double> &stack, const QStringList &history);
+    bool save(const std::vector<RpnDecimal> &stack, const QStringList &history);
+
+private:
+    enum RecordType : quint8 {
+        StackPatch = 1,
+        HistoryAdd = 2,
+        HistoryDrop = 3,
+        HistoryClear = 4,
+        HistoryPrepend = 5,
+        DecimalPatch = 6,   // StackPatch with the values as text
+        HistoryOp = 7       // HistoryAdd of an operation entry
+    };
+
+    static constexpr qint64 kCompactBytes = 8 << 20;
+
+    QString snapshotPath() const;
+    QString journalPath() const;
+    bool readSnapshot(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history);
+    qint64 replayJournal(std::vector<double> &stack, std::vector<RpnDecimal> &decimals, QList<RpnHistoryEntry> &history);
+    bool writeSnapshot(quint32 flags, quint64 stackCount, const QByteArray &stack, const QStringList &history);
+    bool startJournal();
+    void writeRecord(RecordType type);
+
+    QString m_dir;
+    QFile m_journal;
+    quint64 m_generation = 0;
+    qint64 m_journalBytes = 0;
+    qint64 m_validJournalSize = -1; // intact prefix found by load()
+    QByteArray m_record;            // reused record buffer
+};
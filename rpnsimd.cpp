@@ -0,0 +1,239 @@
+#include "rpnsimd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RPN_SIMD_X86 1
+#include <immintrin.h>
+#define RPN_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace {
+
+// --- SCALAR ---
+
+void negateScalar(double *d, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) d[i] = -d[i];
+}
+
+void scaleScalar(double *d, std::size_t n, double f)
+{
+    for (std::size_t i = 0; i < n; ++i) d[i] *= f;
+}
+
+double sumScalar(const double *d, std::size_t n)
+{
+    double s = 0.0;
+    for (std::size_t i = 0; i < n; ++i) s += d[i];
+    return s;
+}
+
+double productScalar(const double *d, std::size_t n)
+{
+    double p = 1.0;
+    for (std::size_t i = 0; i < n; ++i) p *= d[i];
+    return p;
+}
+
+double squaredDeviationScalar(const double *d, std::size_t n, double mean)
+{
+    double s = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double x = d[i] - mean;
+        s += x * x;
+    }
+    return s;
+}
+
+#ifdef RPN_SIMD_X86
+
+// --- SSE2 (baseline on x86-64) ---
+
+void negateSse2(double *d, std::size_t n)
+{
+    const __m128d sign = _mm_set1_pd(-0.0);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(d + i, _mm_xor_pd(_mm_loadu_pd(d + i), sign));
+    negateScalar(d + i, n - i);
+}
+
+void scaleSse2(double *d, std::size_t n, double f)
+{
+    const __m128d k = _mm_set1_pd(f);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(d + i), k));
+    scaleScalar(d + i, n - i, f);
+}
+
+double sumSse2(const double *d, std::size_t n)
+{
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(d + i));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(d + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(a0, a1));
+    return lanes[0] + lanes[1] + sumScalar(d + i, n - i);
+}
+
+double productSse2(const double *d, std::size_t n)
+{
+    __m128d a0 = _mm_set1_pd(1.0), a1 = _mm_set1_pd(1.0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 = _mm_mul_pd(a0, _mm_loadu_pd(d + i));
+        a1 = _mm_mul_pd(a1, _mm_loadu_pd(d + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_mul_pd(a0, a1));
+    return lanes[0] * lanes[1] * productScalar(d + i, n - i);
+}
+
+double squaredDeviationSse2(const double *d, std::size_t n, double mean)
+{
+    const __m128d m = _mm_set1_pd(mean);
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128d x0 = _mm_sub_pd(_mm_loadu_pd(d + i), m);
+        const __m128d x1 = _mm_sub_pd(_mm_loadu_pd(d + i + 2), m);
+        a0 = _mm_add_pd(a0, _mm_mul_pd(x0, x0));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(x1, x1));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(a0, a1));
+    return lanes[0] + lanes[1] + squaredDeviationScalar(d + i, n - i, mean);
+}
+
+// --- AVX ---
+
+RPN_TARGET_AVX double horizontalSum(__m256d v)
+{
+    double lanes[4];
+    _mm256_storeu_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+RPN_TARGET_AVX void negateAvx(double *d, std::size_t n)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(d + i, _mm256_xor_pd(_mm256_loadu_pd(d + i), sign));
+    negateScalar(d + i, n - i);
+}
+
+RPN_TARGET_AVX void scaleAvx(double *d, std::size_t n, double f)
+{
+    const __m256d k = _mm256_set1_pd(f);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(d + i, _mm256_mul_pd(_mm256_loadu_pd(d + i), k));
+    scaleScalar(d + i, n - i, f);
+}
+
+RPN_TARGET_AVX double sumAvx(const double *d, std::size_t n)
+{
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(d + i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(d + i + 4));
+    }
+    return horizontalSum(_mm256_add_pd(a0, a1)) + sumScalar(d + i, n - i);
+}
+
+RPN_TARGET_AVX double productAvx(const double *d, std::size_t n)
+{
+    __m256d a0 = _mm256_set1_pd(1.0), a1 = _mm256_set1_pd(1.0);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_mul_pd(a0, _mm256_loadu_pd(d + i));
+        a1 = _mm256_mul_pd(a1, _mm256_loadu_pd(d + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_mul_pd(a0, a1));
+    return (lanes[0] * lanes[1]) * (lanes[2] * lanes[3]) * productScalar(d + i, n - i);
+}
+
+RPN_TARGET_AVX double squaredDeviationAvx(const double *d, std::size_t n, double mean)
+{
+    const __m256d m = _mm256_set1_pd(mean);
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256d x0 = _mm256_sub_pd(_mm256_loadu_pd(d + i), m);
+        const __m256d x1 = _mm256_sub_pd(_mm256_loadu_pd(d + i + 4), m);
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(x0, x0));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(x1, x1));
+    }
+    return horizontalSum(_mm256_add_pd(a0, a1)) + squaredDeviationScalar(d + i, n - i, mean);
+}
+
+bool hasAvx()
+{
+    static const bool avx = __builtin_cpu_supports("avx");
+    return avx;
+}
+
+#endif // RPN_SIMD_X86
+
+} // namespace
+
+void rpnSimdNegate(double *data, std::size_t n)
+{
+#ifdef RPN_SIMD_X86
+    if (hasAvx()) return negateAvx(data, n);
+    return negateSse2(data, n);
+#else
+    negateScalar(data, n);
+#endif
+}
+
+void rpnSimdScale(double *data, std::size_t n, double factor)
+{
+#ifdef RPN_SIMD_X86
+    if (hasAvx()) return scaleAvx(data, n, factor);
+    return scaleSse2(data, n, factor);
+#else
+    scaleScalar(data, n, factor);
+#endif
+}
+
+double rpnSimdSum(const double *data, std::size_t n)
+{
+#ifdef RPN_SIMD_X86
+    if (hasAvx()) return sumAvx(data, n);
+    return sumSse2(data, n);
+#else
+    return sumScalar(data, n);
+#endif
+}
+
+double rpnSimdProduct(const double *data, std::size_t n)
+{
+#ifdef RPN_SIMD_X86
+    if (hasAvx()) return productAvx(data, n);
+    return productSse2(data, n);
+#else
+    return productScalar(data, n);
+#endif
+}
+
+double rpnSimdSquaredDeviation(const double *data, std::size_t n, double mean)
+{
+#ifdef RPN_SIMD_X86
+    if (hasAvx()) return squaredDeviationAvx(data, n, mean);
+    return squaredDeviationSse2(data, n, mean);
+#else
+    return squaredDeviationScalar(data, n, mean);
+#endif
+}
+
+const char *rpnSimdPath()
+{
+#ifdef RPN_SIMD_X86
+    return hasAvx() ? "avx" : "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+// Whole-array kernels for the bulk stack operations.
+// On x86 they use AVX when the CPU has it (checked once at run time) and
+// SSE2 otherwise; other targets get the scalar loops. Element-wise kernels
+// give bit-identical results on every path; reductions use several
+// accumulators, so their last bit may differ from a left-to-right sum.
+
+void rpnSimdNegate(double *data, std::size_t n);
+void rpnSimdScale(double *data, std::size_t n, double factor);
+
+double rpnSimdSum(const double *data, std::size_t n);
+double rpnSimdProduct(const double *data, std::size_t n);
+// Sum of (x - mean)^2, the second pass of the standard deviation
+double rpnSimdSquaredDeviation(const double *data, std::size_t n, double mean);
+
+// "avx", "sse2" or "scalar"
+const char *rpnSimdPath();
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Head and tail only ever grow; a slot is handed over by the
+// release store of the index that publishes it.
+template <typename T, std::size_t Capacity>
+class RpnSpscQueue
+{
+    static_assert(std::has_single_bit(Capacity), "capacity must be a power of two");
+
+public:
+    // Producer side; false (and `value` untouched) when the queue is full
+    bool push(T &value)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) return false;
+        m_slots[tail & (Capacity - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    std::optional<T> pop()
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return std::nullopt;
+        std::optional<T> out(std::move(m_slots[head & (Capacity - 1)]));
+        m_slots[head & (Capacity - 1)] = T();
+        m_head.store(head + 1, std::memory_order_release);
+        return out;
+    }
+
+private:
+    std::array<T, Capacity> m_slots{};
+    // Apart, so the two threads do not share a cache line
+    alignas(64) std::atomic<std::size_t> m_head{ 0 }; // next slot to pop
+    alignas(64) std::atomic<std::size_t> m_tail{ 0 }; // next slot to push
+};
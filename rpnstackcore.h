@@ -0,0 +1,553 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "rpndepgraph.h"
+#include "rpnjob.h"
+#include "rpnstackstats.h"
+#include "rpnundolog.h"
+#include "rpnvalue.h"
+
+// What changed since the last RpnStackCore::takeChanges(), in slot indices
+// counted from the bottom. Slots [lo, hi) below min(oldSize, newSize) may
+// have new values; everything above that was pushed or popped.
+struct RpnStackChanges {
+    // When the only change was one structural edit, `shape` says which,
+    // so views can move/insert/remove one row instead of refreshing
+    // [lo, hi). lo/hi stay valid either way.
+    enum class Shape : std::uint8_t {
+        Values,
+        Swap,    // slots `at` and `at + 1` traded places
+        Insert,  // a slot was inserted at `at`
+        Erase    // the slot at `at` was removed
+    };
+
+    std::size_t oldSize = 0;
+    std::size_t newSize = 0;
+    std::size_t lo = std::numeric_limits<std::size_t>::max();
+    std::size_t hi = 0;
+    Shape shape = Shape::Values;
+    std::size_t at = 0;
+
+    bool empty() const { return oldSize == newSize && lo >= hi; }
+};
+
+// Returned by RpnStackCore::undo()/redo() so adapters can fix up their own state
+struct RpnStepInfo {
+    bool marker = false;
+    std::uint64_t tag = 0;  // tag source value when the step was recorded
+    std::uint64_t aux = 0;  // recordMarker() argument
+};
+
+// Stack, undo log and change tracking shared by the numeric backends.
+// Knows nothing about arithmetic: RpnCore (double) and RpnDecimalCore add
+// the operations on top and pass the kernels to editValue(). `Value` needs rpnSameValue(const Value&, const Value&)
+// and rpnToDouble(const Value&) (for the statistics); rpnvalue.h has them for double.
+template <typename Value>
+class RpnStackCore
+{
+public:
+    using Changes = RpnStackChanges;
+    using StepInfo = RpnStepInfo;
+
+    // --- STACK (row 0 = TOP) ---
+    std::size_t size() const { return m_stack.size(); }
+    bool has(std::size_t n) const { return m_stack.size() >= n; }
+    const Value &at(std::size_t row) const { return m_stack[m_stack.size() - 1 - row]; }
+    // Bottom-to-top
+    const std::vector<Value> &values() const { return m_stack; }
+
+    // --- EDITS (each one undo step) ---
+    void push(Value v) { commitTop({}, { std::move(v) }); }
+
+    // Pushes `values` (bottom-to-top) as one undo step
+    void pushMany(std::span<const Value> values)
+    {
+        if (values.empty()) return;
+        commitTop({}, values);
+    }
+
+    // Only this slot: values derived from it keep theirs (edit() on the
+    // cores recomputes them)
+    bool setValue(std::size_t row, Value v)
+    {
+        if (row >= m_stack.size()) return false;
+        const std::size_t index = m_stack.size() - 1 - row;
+
+        typename UndoLog::Step step;
+        step.kind = UndoLog::Kind::SetValue;
+        step.index = index;
+        step.oldValue = m_stack[index];
+        step.newValue = v;
+
+        m_deps.pin(index, v);
+        assignSlot(index, std::move(v));
+        record(std::move(step));
+        return true;
+    }
+
+    bool removeAt(std::size_t row)
+    {
+        if (row >= m_stack.size()) return false;
+        const std::size_t index = m_stack.size() - 1 - row;
+
+        typename UndoLog::Step step;
+        step.kind = UndoLog::Kind::Remove;
+        step.index = index;
+        step.oldValue = m_stack[index];
+
+        eraseSlot(index);
+        record(std::move(step));
+        return true;
+    }
+
+    bool moveUp(std::size_t row)
+    {
+        if (row == 0 || row >= m_stack.size()) return false;
+        return moveDown(row - 1);
+    }
+
+    bool moveDown(std::size_t row)
+    {
+        if (row + 1 >= m_stack.size()) return false;
+
+        typename UndoLog::Step step;
+        step.kind = UndoLog::Kind::Swap;
+        // Rows `row` and `row + 1`; the lower slot counted from the bottom
+        step.index = m_stack.size() - 2 - row;
+
+        swapSlots(step.index);
+        record(std::move(step));
+        return true;
+    }
+
+    // Undo step without a stack change (e.g. the history was cleared)
+    void recordMarker(std::uint64_t aux)
+    {
+        typename UndoLog::Step step;
+        step.kind = UndoLog::Kind::Marker;
+        step.extra.aux = aux;
+        record(std::move(step));
+    }
+
+    // Replaces the whole stack; not undoable, drops the undo log
+    void restore(std::vector<Value> values)
+    {
+        // Only the slots that differ from the current stack count as changed
+        const std::size_t common = std::min(m_stack.size(), values.size());
+        std::size_t first = 0;
+        while (first < common && rpnSameValue(m_stack[first], values[first])) ++first;
+        std::size_t last = common;
+        while (last > first && rpnSameValue(m_stack[last - 1], values[last - 1])) --last;
+
+        m_stack = std::move(values);
+        if (first < last) touch(first, last);
+        statsRebuild();
+        // Recorded steps refer to the stack that was just replaced
+        m_undo.clear();
+        m_deps.reset(m_deps.enabled(), m_stack.size());
+    }
+
+    // Moves the whole stack out and leaves it empty; like restore({}), but
+    // the values are handed back instead of copied
+    std::vector<Value> take()
+    {
+        std::vector<Value> values;
+        values.swap(m_stack);
+        statsRebuild();
+        m_undo.clear();
+        m_deps.reset(m_deps.enabled(), 0);
+        return values;
+    }
+
+    // --- UNDO ---
+    bool canUndo() const { return m_undo.canUndo(); }
+    bool canRedo() const { return m_undo.canRedo(); }
+
+    // A group is undone and redone whole; the returned tag is that of its
+    // first step, and a marker inside it is reported with its aux value
+    std::optional<StepInfo> undo()
+    {
+        if (!canUndo()) return std::nullopt;
+        StepInfo info;
+        bool joined = false;
+        do {
+            const typename UndoLog::Step &step = m_undo.undo(m_stepRemoved, m_stepInserted);
+            m_deps.undo();
+            joined = step.joined;
+            join(info, applyStep(step, false));
+            info.tag = step.extra.tag;
+        } while (joined && canUndo());
+        m_deps.discard();
+        return info;
+    }
+
+    std::optional<StepInfo> redo()
+    {
+        if (!canRedo()) return std::nullopt;
+        const typename UndoLog::Step &first = m_undo.redo(m_stepRemoved, m_stepInserted);
+        m_deps.redo();
+        StepInfo info = applyStep(first, true);
+        while (m_undo.redoJoined()) {
+            const typename UndoLog::Step &step = m_undo.redo(m_stepRemoved, m_stepInserted);
+            m_deps.redo();
+            join(info, applyStep(step, true));
+        }
+        m_deps.discard();
+        return info;
+    }
+
+    // Steps recorded until the matching endGroup() undo and redo as one.
+    // Groups nest; only the outermost one counts.
+    void beginGroup()
+    {
+        if (m_groupDepth++ == 0) m_groupHasStep = false;
+    }
+
+    void endGroup()
+    {
+        if (m_groupDepth > 0) --m_groupDepth;
+    }
+
+    void setUndoEnabled(bool enabled)
+    {
+        m_undoEnabled = enabled;
+        if (!enabled) {
+            m_undo.clear();
+            m_deps.clearJournal();
+        }
+    }
+
+    void setUndoLimit(std::size_t limit)
+    {
+        m_undo.setLimit(limit);
+        m_deps.setLimit(limit);
+    }
+    // Value stored with every recorded step (the engine passes its history mark)
+    void setTagSource(std::function<std::uint64_t()> source) { m_tagSource = std::move(source); }
+
+    // --- STATISTICS ---
+    // Kept in step with every edit, undo and redo while enabled (off by
+    // default: each value entering or leaving costs an ordered-map update).
+    // Decimal values are counted as doubles.
+    void setStatsEnabled(bool enabled)
+    {
+        if (enabled == m_statsEnabled) return;
+        m_statsEnabled = enabled;
+        m_stats.clear();
+        statsRebuild();
+    }
+
+    bool statsEnabled() const { return m_statsEnabled; }
+    // Empty while disabled
+    const RpnStackStats &stats() const { return m_stats; }
+
+    // --- DEPENDENCIES ---
+    // While on, results of registry ops remember their op and inputs
+    // (RpnDepGraph), so editValue() can recompute what was derived from an
+    // edited value. Off by default. Switching drops the undo log, whose
+    // steps carry no links.
+    void setTrackingEnabled(bool enabled)
+    {
+        if (enabled == m_deps.enabled()) return;
+        m_undo.clear();
+        m_deps.reset(enabled, m_stack.size());
+    }
+
+    bool trackingEnabled() const { return m_deps.enabled(); }
+
+    // --- LONG OPERATIONS ---
+    // Ops that walk the whole stack report progress to `job` and stop when
+    // it is cancelled (nullptr: never). Not owned; copies share it.
+    void setJobControl(RpnJobControl *job) { m_job = job; }
+
+    Changes takeChanges()
+    {
+        Changes out = m_changes;
+        out.newSize = m_stack.size();
+        // Pops that left no touched slot behind still rule out a single edit
+        const std::ptrdiff_t delta = std::ptrdiff_t(out.newSize) - std::ptrdiff_t(out.oldSize);
+        const std::ptrdiff_t expected = out.shape == Changes::Shape::Insert ? 1
+                                        : out.shape == Changes::Shape::Erase ? -1 : 0;
+        if (delta != expected) out.shape = Changes::Shape::Values;
+
+        m_changes = Changes{};
+        m_changes.oldSize = m_changes.newSize = m_stack.size();
+        return out;
+    }
+
+protected:
+    struct Tag {
+        std::uint64_t tag = 0;
+        std::uint64_t aux = 0;
+    };
+    using UndoLog = RpnUndoLog<Tag, Value>;
+
+    RpnStackCore() = default;
+    ~RpnStackCore() = default;
+
+    using Deps = RpnDepGraph<Value>;
+
+    // Sets the value at `row` and recomputes every tracked value derived
+    // from it, as one undo step. `eval(op, in, out)` computes one op on
+    // operands bottom first. If an op fails on its new inputs, nothing
+    // changes and its error is returned. `updated`: values on the stack
+    // that were recomputed.
+    template <typename Eval>
+    RpnError editValue(std::size_t row, Value v, Eval &&eval, std::size_t &updated)
+    {
+        updated = 0;
+        const std::size_t index = m_stack.size() - 1 - row;
+        if (const RpnError e = m_deps.recompute(index, v, eval); e != RpnError::None) return e;
+        if (!m_deps.fresh().empty() && m_undo.canRedo()) {
+            // Only now that it succeeds may the edit drop what could be
+            // redone; the walk is repeated without the nodes only redo held
+            m_undo.clearRedo();
+            m_deps.clearRedo();
+            m_deps.recompute(index, v, eval);
+        }
+        if (m_deps.fresh().empty()) {
+            setValue(row, std::move(v));
+            return RpnError::None;
+        }
+
+        // Stack slots to rewrite, the edited one first
+        std::vector<std::pair<std::size_t, Value>> rewrite;
+        for (const auto &[id, value] : m_deps.fresh())
+            if (const std::ptrdiff_t slot = m_deps.slotOf(id); slot >= 0) rewrite.emplace_back(std::size_t(slot), value);
+        m_deps.commit();
+
+        beginGroup();
+        for (auto &[slot, value] : rewrite) {
+            typename UndoLog::Step step;
+            step.kind = UndoLog::Kind::SetValue;
+            step.index = slot;
+            step.oldValue = m_stack[slot];
+            step.newValue = value;
+            assignSlot(slot, std::move(value));
+            // The first step carries the node states of the whole edit
+            record(std::move(step));
+        }
+        endGroup();
+        updated = rewrite.size() - 1;
+        return RpnError::None;
+    }
+
+    // A registry op or dup: the top `inputs` values feed `result`, and the
+    // `removed` ones (bottom first) leave the stack
+    void commitDerived(RpnOp op, std::size_t inputs, std::span<const Value> removed, const Value &result)
+    {
+        const typename Deps::Entry node{ m_deps.derive(op, inputs, m_stack) };
+        replaceTop(removed.size(), std::span<const Value>(&result, 1), std::span<const typename Deps::Entry>(&node, 1));
+        record({}, removed, std::span<const Value>(&result, 1));
+    }
+
+    // --- PRIMITIVES (no undo) ---
+
+    // `ids`: nodes of the new slots (undo/redo, commitDerived)
+    void replaceTop(std::size_t removeCount, std::span<const Value> values,
+                    std::span<const typename Deps::Entry> ids = {})
+    {
+        removeCount = std::min(removeCount, m_stack.size());
+        const std::size_t base = m_stack.size() - removeCount;
+
+        // Slots that get their old value back (undo of dup, a no-op program)
+        // are left out, so only rows that really differ are refreshed
+        const std::size_t overlap = std::min(removeCount, values.size());
+        std::size_t first = 0;
+        while (first < overlap && rpnSameValue(m_stack[base + first], values[first])) ++first;
+        std::size_t last = overlap;
+        if (values.size() == overlap)
+            while (last > first && rpnSameValue(m_stack[base + last - 1], values[last - 1])) --last;
+        else
+            last = values.size();
+
+        statsDrop(base + first);
+        m_deps.drop(base);
+        m_stack.resize(base);
+        m_stack.insert(m_stack.end(), values.begin(), values.end());
+        statsTake(base + first);
+        m_deps.take(base, m_stack, ids);
+        if (first < last) touch(base + first, base + last);
+    }
+
+    void commitTop(std::span<const Value> removed, std::span<const Value> inserted)
+    {
+        replaceTop(removed.size(), inserted);
+        record({}, removed, inserted);
+    }
+
+    void commitTop(std::initializer_list<Value> removed, std::initializer_list<Value> inserted)
+    {
+        commitTop(std::span<const Value>(removed.begin(), removed.size()),
+                  std::span<const Value>(inserted.begin(), inserted.size()));
+    }
+
+    void record(typename UndoLog::Step step, std::span<const Value> removed = {},
+                std::span<const Value> inserted = {})
+    {
+        if (!m_undoEnabled) {
+            m_deps.discard();
+            return;
+        }
+        if (m_tagSource) step.extra.tag = m_tagSource();
+        if (m_groupDepth > 0) {
+            step.joined = m_groupHasStep;
+            m_groupHasStep = true;
+        }
+        const bool joined = step.joined;
+        m_undo.record(std::move(step), removed, inserted);
+        m_deps.record(joined);
+    }
+
+    void assignSlot(std::size_t index, Value v)
+    {
+        if (m_statsEnabled) m_stats.remove(rpnToDouble(m_stack[index]));
+        m_stack[index] = std::move(v);
+        if (m_statsEnabled) m_stats.add(rpnToDouble(m_stack[index]));
+        m_deps.sync(index, m_stack[index]);
+        touch(index, index + 1);
+    }
+
+    // For ops that rewrite m_stack themselves: slots [from, size()) leave
+    // (call before the step's record(), the ids go with it), and the slots
+    // from `from` up are plain numbers (after the rewrite)
+    void depsDrop(std::size_t from) { m_deps.drop(from); }
+    void depsTake(std::size_t from) { m_deps.take(from, m_stack); }
+
+    // Slots [from, size()) are about to be replaced / were just written.
+    // Operations that rewrite the whole stack call statsRebuild() instead.
+    void statsDrop(std::size_t from)
+    {
+        if (!m_statsEnabled) return;
+        for (std::size_t i = from; i < m_stack.size(); ++i) m_stats.remove(rpnToDouble(m_stack[i]));
+    }
+
+    void statsTake(std::size_t from)
+    {
+        if (!m_statsEnabled) return;
+        for (std::size_t i = from; i < m_stack.size(); ++i) m_stats.add(rpnToDouble(m_stack[i]));
+    }
+
+    void statsRebuild()
+    {
+        if (!m_statsEnabled) return;
+        m_stats.clear();
+        statsTake(0);
+    }
+
+    // Every 64 values: reports progress, false once the job was cancelled
+    bool jobStep(std::size_t done, std::size_t total) const { return jobStep(m_job, done, total); }
+    static bool jobStep(RpnJobControl *job, std::size_t done, std::size_t total)
+    {
+        return !job || (done & 63) != 0 || job->step(done, total);
+    }
+
+    // --- CHANGE TRACKING ---
+
+    void touch(std::size_t lo, std::size_t hi)
+    {
+        m_changes.lo = std::min(m_changes.lo, lo);
+        m_changes.hi = std::max(m_changes.hi, hi);
+        m_changes.shape = Changes::Shape::Values;
+    }
+
+    bool pristine() const
+    {
+        return m_changes.lo >= m_changes.hi && m_changes.oldSize == m_stack.size();
+    }
+
+    // After the touch() of a structural edit; `alone` means nothing else
+    // had changed before it
+    void reshape(Changes::Shape shape, std::size_t at, bool alone)
+    {
+        if (!alone) return;
+        m_changes.shape = shape;
+        m_changes.at = at;
+    }
+
+    void swapSlots(std::size_t index)
+    {
+        const bool alone = pristine();
+        std::swap(m_stack[index], m_stack[index + 1]);
+        m_deps.swap(index);
+        touch(index, index + 2);
+        reshape(Changes::Shape::Swap, index, alone);
+    }
+
+    void insertSlot(std::size_t index, Value v, typename Deps::Id id = 0)
+    {
+        const bool alone = pristine();
+        m_stack.insert(m_stack.begin() + std::ptrdiff_t(index), std::move(v));
+        m_deps.insert(index, m_stack[index], id);
+        if (m_statsEnabled) m_stats.add(rpnToDouble(m_stack[index]));
+        // Everything above the new slot moved up by one
+        touch(index, m_stack.size());
+        reshape(Changes::Shape::Insert, index, alone);
+    }
+
+    void eraseSlot(std::size_t index)
+    {
+        const bool alone = pristine();
+        if (m_statsEnabled) m_stats.remove(rpnToDouble(m_stack[index]));
+        m_deps.erase(index);
+        m_stack.erase(m_stack.begin() + std::ptrdiff_t(index));
+        touch(index, m_stack.size());
+        reshape(Changes::Shape::Erase, index, alone);
+    }
+
+    StepInfo applyStep(const typename UndoLog::Step &step, bool forward)
+    {
+        switch (step.kind) {
+            case UndoLog::Kind::ReplaceTop:
+                if (forward) replaceTop(m_stepRemoved.size(), m_stepInserted, m_deps.after());
+                else replaceTop(m_stepInserted.size(), m_stepRemoved, m_deps.before());
+                break;
+            case UndoLog::Kind::SetValue:
+                assignSlot(step.index, forward ? step.newValue : step.oldValue);
+                m_deps.restore(forward ? m_deps.after() : m_deps.before());
+                break;
+            case UndoLog::Kind::Remove:
+                if (forward) eraseSlot(step.index);
+                else insertSlot(step.index, step.oldValue, Deps::idIn(m_deps.before(), 0));
+                break;
+            case UndoLog::Kind::Swap:
+                // Its own inverse
+                swapSlots(step.index);
+                break;
+            case UndoLog::Kind::Marker:
+                break;
+        }
+        return StepInfo{ step.kind == UndoLog::Kind::Marker, step.extra.tag, step.extra.aux };
+    }
+
+    static void join(StepInfo &into, const StepInfo &step)
+    {
+        if (!step.marker) return;
+        into.marker = true;
+        into.aux = step.aux;
+    }
+
+    std::vector<Value> m_stack;
+    UndoLog m_undo;
+    bool m_undoEnabled = true;
+    std::function<std::uint64_t()> m_tagSource;
+    std::vector<Value> m_stepRemoved;  // scratch buffers for undo/redo
+    std::vector<Value> m_stepInserted;
+    Changes m_changes;
+    int m_groupDepth = 0;
+    bool m_groupHasStep = false; // the open group recorded a step already
+    bool m_statsEnabled = false;
+    RpnStackStats m_stats;
+    Deps m_deps;
+    RpnJobControl *m_job = nullptr;
+};
@@ -1,18 +1,38 @@
 #include "rpnstackmodel.h"
+#include "rpnformatworker.h"
+#include "rpnparse.h"
+#include "rpnperf.h"
 
-#include <QLocale>
+#include <QTimer>
 #include <QtGlobal>
+#include <algorithm>
+#include <bit>
 #include <cmath>
 
-RpnStackModel::RpnStackModel(QObject *parent)
+RpnStackModel::RpnStackModel(const RpnCore *core, QObject *parent)
     : QAbstractListModel(parent)
+    , m_core(core)
+    , m_rows(int(core->size()))
+    , m_worker(new RpnFormatWorker(this))
 {
+    connect(m_worker, &RpnFormatWorker::formatted, this, &RpnStackModel::applyFormatted);
+}
+
+void RpnStackModel::setDecimalSource(const RpnDecimalCore *decimal)
+{
+    beginResetModel();
+    m_decimal = decimal;
+    m_rows = int(coreSize());
+    m_textCache.clear();
+    ++m_generation;
+    m_pending.clear();
+    endResetModel();
 }
 
 int RpnStackModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid()) return 0;
-    return m_stack.size();
+    return m_rows;
 }
 
 QHash<int, QByteArray> RpnStackModel::roleNames() const
@@ -23,260 +43,278 @@ QHash<int, QByteArray> RpnStackModel::roleNames() const
 // --- PARSING ---
 double RpnStackModel::parseInput(const QString &text, bool *ok)
 {
-    QString t = text.trimmed();
-    if (t.isEmpty()) {
-        if (ok) *ok = false;
-        return 0.0;
-    }
-
-    // 1. CRITICAL CLEANUP:
-    // QLocale::c() accepts ONLY dots. If commas remain, E-notation parsing will fail.
-    t.replace(',', '.');
-    
-    // Remove ALL spaces (regular and non-breaking), 
-    // because "1.23 E 5" is invalid for toDouble().
-    t.remove(' ');
-    t.remove(QChar(0xA0)); // U+00A0 (Non-breaking space)
-
+    // Shared with bulk import and headless mode (rpnparse.h): one UTF-8
+    // conversion instead of a QString copy per cleanup step
+    const QByteArray utf8 = text.toUtf8();
     double v = 0.0;
-    bool status = false;
-
-    // 2. Handle scientific notation "a*10^b"
-    if (const int splitIdx = t.indexOf("*10^"); splitIdx > 0) {
-        const QString aStr = t.left(splitIdx);
-        const QString bStr = t.mid(splitIdx + 4); // length of "*10^" is 4
-
-        // Compose format "mantissaEb", e.g. "1.23E5"
-        // Because t.replace() and t.remove() worked earlier, 
-        // aStr already has dots and no spaces.
-        QString scientificStr = aStr + "E" + bStr;
-        
-        v = QLocale::c().toDouble(scientificStr, &status);
-        
-        // FALLBACK:
-        // If E-notation method fails (e.g. weird format), try old method,
-        // so user doesn't get stuck.
-        if (!status) {
-            bool okA = false, okB = false;
-            const double a = QLocale::c().toDouble(aStr, &okA);
-            const int b = bStr.toInt(&okB);
-            if (okA && okB) {
-                v = a * std::pow(10.0, b);
-                status = std::isfinite(v);
-            }
-        }
-    } else {
-        // 3. Standard parsing (e.g. 123.45)
-        v = QLocale::c().toDouble(t, &status);
-    }
-    
-    if (status) {
-        status = std::isfinite(v);
-    }
-
+    const bool status = rpnParseNumber(std::string_view(utf8.constData(), std::size_t(utf8.size())), v);
     if (ok) *ok = status;
     return status ? v : 0.0;
 }
 
 // --- FORMATTING ---
-QString RpnStackModel::formatValue(double v) const
+const QString &RpnStackModel::formatAt(int storageIdx) const
 {
-    if (!std::isfinite(v)) return QStringLiteral("NaN");
-    if (v == 0.0) return QStringLiteral("0");
-
-    const double absV = std::abs(v);
-    const QLocale loc = QLocale::system();
-    const QString decimalPoint = loc.decimalPoint();
+    const qsizetype size = qsizetype(coreSize());
+    if (m_textCache.size() < size) m_textCache.resize(size);
+
+    CachedText &entry = m_textCache[storageIdx];
+
+    // Only the format is stale (stamp 0 marks a changed value): leave it to
+    // the worker on huge stacks
+    if (m_rows >= kAsyncRows && entry.stamp != 0 && entry.stamp != m_formatStamp
+        && (m_decimal || entry.bits == std::bit_cast<quint64>(m_core->values()[std::size_t(storageIdx)]))) {
+        static const QString placeholder = QStringLiteral("\u2026");
+        if (entry.queued != quint32(m_generation)) requestFormat(storageIdx);
+        return placeholder;
+    }
 
-    // Function to remove trailing zeros (e.g. "1.500" -> "1.5")
-    auto cleanZerosLocale = [&](QString s) -> QString {
-        if (s.contains(decimalPoint)) {
-            while (s.endsWith('0')) s.chop(1);
-            if (s.endsWith(decimalPoint)) s.chop(decimalPoint.length());
+    if (m_decimal) {
+        if (entry.stamp != m_formatStamp) {
+            RPN_PERF_COUNT("model.format");
+            entry.text = m_formatter.format(m_decimal->values()[std::size_t(storageIdx)],
+                                            m_decimal->context().digits);
+            entry.stamp = m_formatStamp;
         }
-        return s;
-    };
-
-    switch (m_mode) {
-        case Scientific: {
-            int exp = static_cast<int>(std::floor(std::log10(absV)));
-            double mant = v / std::pow(10.0, exp);
-
-            // [FIX] Scientific always has 1 digit before decimal point.
-            // Safe max after decimal is 15 - 1 = 14.
-            int safePrec = qBound(0, m_precision, 14);
+        return entry.text;
+    }
 
-            QString mantStr = cleanZerosLocale(loc.toString(mant, 'f', safePrec));
-            return QString("%1 * 10^%2").arg(mantStr).arg(exp);
-        }
-        case Engineering: {
-            int exp = static_cast<int>(std::floor(std::log10(absV)));
-            exp = (exp / 3) * 3; // Round exponent to multiple of 3
-            double mant = v / std::pow(10.0, exp);
+    const double v = m_core->values()[std::size_t(storageIdx)];
+    const quint64 bits = std::bit_cast<quint64>(v);
+    if (entry.stamp != m_formatStamp || entry.bits != bits) {
+        RPN_PERF_COUNT("model.format");
+        entry.text = m_formatter.format(v);
+        entry.bits = bits;
+        entry.stamp = m_formatStamp;
+    }
+    return entry.text;
+}
 
-            // [FIX] Calculate "budget" of digits for mantissa
-            // Mantissa in engineering mode can be e.g. 1.2, 12.3 or 123.4
-            double absMant = std::abs(mant);
-            int intDigits = 1;
-            if (absMant >= 100.0) intDigits = 3;
-            else if (absMant >= 10.0) intDigits = 2;
+void RpnStackModel::requestFormat(int storageIdx) const
+{
+    const bool idle = m_wantHi < m_wantLo;
+    m_wantLo = idle ? storageIdx : qMin(m_wantLo, storageIdx);
+    m_wantHi = idle ? storageIdx : qMax(m_wantHi, storageIdx);
+    // The view asks row by row; one job covers everything it asked for in this pass
+    if (idle)
+        QTimer::singleShot(0, const_cast<RpnStackModel *>(this), &RpnStackModel::dispatchFormatJob);
+}
 
-            // How many decimal places can we show without exceeding 15 significant digits?
-            // Max 15 - (integer digits). E.g. for "123.xxx" we have 12 places left.
-            int maxDecimals = 15 - intDigits;
-            int safePrec = qBound(0, m_precision, maxDecimals);
+void RpnStackModel::dispatchFormatJob()
+{
+    const int size = int(qMin(coreSize(), std::size_t(m_textCache.size())));
+    const int lo = qMax(0, m_wantLo - kLookAhead);
+    const int hi = qMin(size - 1, m_wantHi + kLookAhead);
+    m_wantLo = 0;
+    m_wantHi = -1;
+    if (lo > hi) return;
+
+    RpnFormatJob job;
+    job.generation = m_generation;
+    job.id = m_nextJob++;
+    job.formatter = m_formatter;
+    job.decimal = m_decimal != nullptr;
+    if (m_decimal) {
+        const auto &values = m_decimal->values();
+        job.decimals.assign(values.begin() + lo, values.begin() + hi + 1);
+        job.digits = m_decimal->context().digits;
+    } else {
+        const auto &values = m_core->values();
+        job.values.assign(values.begin() + lo, values.begin() + hi + 1);
+    }
+    PendingFormat pending;
+    pending.id = job.id;
+    pending.targets.reserve(std::size_t(hi - lo + 1));
+    for (int i = lo; i <= hi; ++i) {
+        m_textCache[i].queued = quint32(m_generation);
+        pending.targets.push_back(i);
+    }
+    m_pending.push_back(std::move(pending));
+    m_worker->post(std::move(job));
+}
 
-            QString mantStr = cleanZerosLocale(loc.toString(mant, 'f', safePrec));
-            return QString("%1 * 10^%2").arg(mantStr).arg(exp);
-        }
-        case Simple:
-        default: {
-            // [FIX] If number is very large or very small, force scientific notation
-            if (absV >= 1.0e15 || (absV > 0 && absV < 1.0e-15)) {
-                // Call Scientific logic manually (to avoid code duplication, could extract to function,
-                // but here for readability we paste Scientific logic)
-                int exp = static_cast<int>(std::floor(std::log10(absV)));
-                double mant = v / std::pow(10.0, exp);
-                int safePrec = 14; 
-                QString mantStr = cleanZerosLocale(loc.toString(mant, 'f', safePrec));
-                return QString("%1 * 10^%2").arg(mantStr).arg(exp);
+void RpnStackModel::remapPending(const RpnCore::Changes &changes)
+{
+    using Shape = RpnCore::Changes::Shape;
+    const int at = int(changes.at);
+    // Pushes and pops only touch the top slots; the rest keep their index
+    const int kept = int(qMin(changes.oldSize, changes.newSize));
+    for (PendingFormat &pending : m_pending) {
+        for (int &slot : pending.targets) {
+            if (slot < 0) continue;
+            switch (changes.shape) {
+                case Shape::Swap:
+                    if (slot == at) slot = at + 1;
+                    else if (slot == at + 1) slot = at;
+                    break;
+                case Shape::Insert:
+                    if (slot >= at) ++slot;
+                    break;
+                case Shape::Erase:
+                    slot = slot == at ? -1 : slot > at ? slot - 1 : slot;
+                    break;
+                case Shape::Values:
+                    if (slot >= kept || (std::size_t(slot) >= changes.lo && std::size_t(slot) < changes.hi))
+                        slot = -1;
+                    break;
             }
-
-            // Normal mode - max 15 digits
-            int safePrec = qBound(0, m_precision, 15);
-            QString s = loc.toString(v, 'f', safePrec);
-            s = cleanZerosLocale(s);
-            if (s == QStringLiteral("-0")) s = QStringLiteral("0");
-            return s;
         }
     }
 }
 
+void RpnStackModel::applyFormatted(quint64 generation, quint64 id, const QStringList &texts)
+{
+    if (generation != m_generation) return; // formatted for an older format or source
+
+    const auto it = std::find_if(m_pending.begin(), m_pending.end(),
+                                 [id](const PendingFormat &p) { return p.id == id; });
+    if (it == m_pending.end()) return;
+    const std::vector<int> targets = std::move(it->targets);
+    m_pending.erase(it);
+
+    // One dataChanged over the rows the texts landed in
+    int lo = int(m_textCache.size());
+    int hi = -1;
+    for (qsizetype i = 0; i < texts.size() && std::size_t(i) < targets.size(); ++i) {
+        const int slot = targets[std::size_t(i)];
+        if (slot < 0 || slot >= m_textCache.size()) continue;
+        CachedText &entry = m_textCache[slot];
+        if (entry.stamp == 0) continue; // changed since; formatted on demand
+        entry.text = texts[i];
+        entry.stamp = m_formatStamp;
+        if (!m_decimal) entry.bits = std::bit_cast<quint64>(m_core->values()[std::size_t(slot)]);
+        lo = qMin(lo, slot);
+        hi = qMax(hi, slot);
+    }
+    // Inside a transaction the cache follows the core ahead of the rows;
+    // slots past m_rows are announced when sync() inserts them
+    hi = qMin(hi, m_rows - 1);
+    if (lo <= hi) {
+        RPN_PERF_COUNT("model.notify");
+        emit dataChanged(index(m_rows - 1 - hi), index(m_rows - 1 - lo), { ValueRole });
+    }
+}
 
 QVariant RpnStackModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid()) return {};
     const int row = index.row();
-    if (row < 0 || row >= m_stack.size()) return {};
+    if (row < 0 || row >= m_rows) return {};
+
+    // Between a core change and sync() the view may still ask for old rows
+    const int idx = storageIndex(row);
+    if (idx < 0 || std::size_t(idx) >= coreSize()) return {};
 
     if (role == ValueRole)
-        return formatValue(m_stack[row]);
+        return formatAt(idx);
 
     return {};
 }
 
+QString RpnStackModel::textAt(int row) const
+{
+    const std::size_t size = coreSize();
+    if (row < 0 || std::size_t(row) >= size) return {};
+    const std::size_t idx = size - 1 - std::size_t(row);
+    return m_decimal ? m_formatter.format(m_decimal->values()[idx], m_decimal->context().digits)
+                     : m_formatter.format(m_core->values()[idx]);
+}
+
 void RpnStackModel::setNumberFormat(int mode, int precision)
 {
     if (mode < 0 || mode > 2) mode = 0;
     if (precision < 0) precision = 0;
-    if (precision > 17) precision = 17;
+    // RpnFormatter limits doubles to what they hold; decimals may use more
+    if (precision > RpnDecimalContext::kMaxDigits) precision = RpnDecimalContext::kMaxDigits;
 
     const auto newMode = static_cast<NumberFormat>(mode);
     const bool changed = (newMode != m_mode) || (precision != m_precision);
 
     m_mode = newMode;
     m_precision = precision;
+    m_formatter.setFormat(m_mode, m_precision);
+    // Invalidates every cached string at once
+    if (changed) {
+        ++m_formatStamp;
+        ++m_generation;
+        m_pending.clear();
+    }
 
-    if (changed && !m_stack.isEmpty())
-        emit dataChanged(index(0), index(m_stack.size() - 1), { ValueRole });
-}
-
-// --- STACK OPS ---
-bool RpnStackModel::has(int n) const { return m_stack.size() >= n; }
-
-void RpnStackModel::push(double v)
-{
-    beginInsertRows(QModelIndex(), 0, 0);
-    m_stack.prepend(v);
-    endInsertRows();
-}
-
-bool RpnStackModel::pop(double &v)
-{
-    if (m_stack.isEmpty()) return false;
-    beginRemoveRows(QModelIndex(), 0, 0);
-    v = m_stack.takeFirst();
-    endRemoveRows();
-    return true;
-}
-
-bool RpnStackModel::dupTop()
-{
-    if (m_stack.isEmpty()) return false;
-    beginInsertRows(QModelIndex(), 0, 0);
-    m_stack.prepend(m_stack.first());
-    endInsertRows();
-    return true;
-}
-
-bool RpnStackModel::swapTop()
-{
-    if (m_stack.size() < 2) return false;
-    beginResetModel();
-    std::swap(m_stack[0], m_stack[1]);
-    endResetModel();
-    return true;
-}
-
-bool RpnStackModel::dropTop()
-{
-    if (m_stack.isEmpty()) return false;
-    beginRemoveRows(QModelIndex(), 0, 0);
-    m_stack.removeFirst();
-    endRemoveRows();
-    return true;
-}
-
-void RpnStackModel::clearAll()
-{
-    beginResetModel();
-    m_stack.clear();
-    endResetModel();
-}
-
-void RpnStackModel::restore(const QVector<double> &s)
-{
-    beginResetModel();
-    m_stack = s;
-    endResetModel();
-}
-
-// --- QML HELPER OPS ---
-void RpnStackModel::removeAt(int row)
-{
-    if (row < 0 || row >= m_stack.size()) return;
-    beginRemoveRows(QModelIndex(), row, row);
-    m_stack.removeAt(row);
-    endRemoveRows();
-}
-
-bool RpnStackModel::moveUp(int row)
-{
-    if (row <= 0 || row >= m_stack.size()) return false;
-    beginResetModel();
-    std::swap(m_stack[row], m_stack[row - 1]);
-    endResetModel();
-    return true;
-}
-
-bool RpnStackModel::moveDown(int row)
-{
-    if (row < 0 || row >= m_stack.size() - 1) return false;
-    beginResetModel();
-    std::swap(m_stack[row], m_stack[row + 1]);
-    endResetModel();
-    return true;
+    if (changed && m_rows > 0) {
+        RPN_PERF_COUNT("model.notify");
+        emit dataChanged(index(0), index(m_rows - 1), { ValueRole });
+    }
 }
 
-bool RpnStackModel::setValueAt(int row, const QString &text)
+// --- CHANGE NOTIFICATION ---
+void RpnStackModel::sync(const RpnCore::Changes &changes)
 {
-    if (row < 0 || row >= m_stack.size()) return false;
+    if (changes.empty()) return;
+    RPN_PERF_SCOPE("model.sync");
+    // Texts still on the worker follow their slots
+    if (!m_pending.empty()) remapPending(changes);
+
+    using Shape = RpnCore::Changes::Shape;
+    const int slot = int(changes.at);
+    switch (changes.shape) {
+        case Shape::Swap: {
+            // Slot `at + 1` is the upper row; moving the lower row above it
+            // keeps both delegates alive
+            const int upper = int(changes.newSize) - 2 - slot;
+            RPN_PERF_COUNT("model.notify");
+            beginMoveRows(QModelIndex(), upper + 1, upper + 1, QModelIndex(), upper);
+            if (m_textCache.size() > slot + 1) m_textCache.swapItemsAt(slot, slot + 1);
+            endMoveRows();
+            return;
+        }
+        case Shape::Insert: {
+            const int row = int(changes.newSize) - 1 - slot;
+            RPN_PERF_COUNT("model.notify");
+            beginInsertRows(QModelIndex(), row, row);
+            m_rows = int(changes.newSize);
+            if (m_textCache.size() > slot) m_textCache.insert(slot, CachedText{});
+            endInsertRows();
+            return;
+        }
+        case Shape::Erase: {
+            const int row = int(changes.oldSize) - 1 - slot;
+            RPN_PERF_COUNT("model.notify");
+            beginRemoveRows(QModelIndex(), row, row);
+            m_rows = int(changes.newSize);
+            if (m_textCache.size() > slot) m_textCache.remove(slot);
+            endRemoveRows();
+            return;
+        }
+        case Shape::Values:
+            break;
+    }
 
-    bool ok = false;
-    double v = parseInput(text, &ok);
-    if (!ok) return false;
+    // Slots are counted from the bottom, rows from the top: pushed or popped
+    // slots are the top rows, so one insert/remove at row 0 covers them
+    const int oldSize = int(changes.oldSize);
+    const int newSize = int(changes.newSize);
+    if (newSize < oldSize) {
+        RPN_PERF_COUNT("model.notify");
+        beginRemoveRows(QModelIndex(), 0, oldSize - newSize - 1);
+        m_rows = newSize;
+        endRemoveRows();
+        // Shrinking the cache drops strings of slots that are gone
+        if (m_textCache.size() > newSize) m_textCache.resize(newSize);
+    } else if (newSize > oldSize) {
+        RPN_PERF_COUNT("model.notify");
+        beginInsertRows(QModelIndex(), 0, newSize - oldSize - 1);
+        m_rows = newSize;
+        endInsertRows();
+    }
 
-    m_stack[row] = v;
-    emit dataChanged(index(row), index(row), { ValueRole });
-    return true;
+    // Surviving slots that may hold new values
+    const std::size_t hi = qMin(changes.hi, std::size_t(qMin(oldSize, newSize)));
+    if (changes.lo < hi) {
+        for (std::size_t i = changes.lo; i < qMin(hi, std::size_t(m_textCache.size())); ++i)
+            m_textCache[qsizetype(i)].stamp = 0;
+        const int first = newSize - int(hi);
+        const int last = newSize - 1 - int(changes.lo);
+        RPN_PERF_COUNT("model.notify");
+        emit dataChanged(index(first), index(last), { ValueRole });
+    }
 }
@@ -3,6 +3,13 @@
 #include <QAbstractListModel>
 #include <QVector>
 
+#include <vector>
+
+#include "rpncore.h"
+#include "rpnformatter.h"
+
+class RpnFormatWorker;
+
 class RpnStackModel final : public QAbstractListModel
 {
     Q_OBJECT
@@ -20,41 +27,86 @@ public:
     };
     Q_ENUM(NumberFormat)
 
-    explicit RpnStackModel(QObject *parent = nullptr);
+    // Read-only view of `core`; the owner calls sync() after changing it
+    explicit RpnStackModel(const RpnCore *core, QObject *parent = nullptr);
+
+    // Shows `decimal` instead of the double core (nullptr switches back).
+    // Resets the model; also call it when the decimal context changes.
+    void setDecimalSource(const RpnDecimalCore *decimal);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role) const override;
     QHash<int, QByteArray> roleNames() const override;
 
-    // --- ENGINE API ---
-    bool has(int n) const;
-    void push(double v);
-    bool pop(double &v);
-    bool dupTop();
-    bool swapTop();
-    bool dropTop();
-    void clearAll();
-    
-    QVector<double> snapshot() const { return m_stack; }
-    void restore(const QVector<double>& s);
-
-    // --- QML API ---
-    Q_INVOKABLE void removeAt(int row);
-    Q_INVOKABLE bool moveUp(int row);
-    Q_INVOKABLE bool moveDown(int row);
-    Q_INVOKABLE bool setValueAt(int row, const QString &text);
+    // Publishes everything the core changed since its last takeChanges():
+    // a single swap, insert or removal as one row move/insert/remove,
+    // anything else as one remove/insert at the top plus one dataChanged range
+    void sync(const RpnCore::Changes &changes);
 
     // --- STATIC PARSER ---
     static double parseInput(const QString &text, bool *ok = nullptr);
 
     // --- FORMATTING ---
     void setNumberFormat(int mode, int precision);
+    // Text of `row` in the current format, straight from the core: never a
+    // placeholder, and already right before the pending sync()
+    QString textAt(int row) const;
+    // A value derived from the stack (e.g. a statistic) in the current format
+    QString formatValue(double v) const { return m_formatter.format(v); }
 
 private:
-    QVector<double> m_stack; // TOP = index 0
+    // Core storage is bottom-to-top; model row 0 is the top of the stack
+    int storageIndex(int row) const { return m_rows - 1 - row; }
+
+    std::size_t coreSize() const { return m_decimal ? m_decimal->size() : m_core->size(); }
+
+    const RpnCore *m_core;
+    const RpnDecimalCore *m_decimal = nullptr;
+    int m_rows = 0; // rows the view has been told about
 
     NumberFormat m_mode = Scientific;
     int m_precision = 6;
 
-    QString formatValue(double v) const;
+    // Formatted text per storage slot, reused while value and format match.
+    // sync() invalidates the slots a change touched; doubles also compare bits.
+    struct CachedText {
+        quint64 bits = 0;
+        quint32 stamp = 0;
+        quint32 queued = 0; // low bits of the generation the slot was sent to the worker in
+        QString text;
+    };
+    RpnFormatter m_formatter;
+    quint32 m_formatStamp = 1;
+    mutable QVector<CachedText> m_textCache;
+
+    // --- BACKGROUND FORMATTING ---
+    // On stacks this tall a format change would stall the first repaint for
+    // every visible row, so rows whose only stale part is the format show a
+    // placeholder and are formatted on the worker, with a margin around what
+    // the view asked for so scrolling finds them ready.
+    static constexpr int kAsyncRows = 5000;
+    static constexpr int kLookAhead = 200;
+
+    RpnFormatWorker *m_worker;
+    // Bumped when the text of every slot changes (format, source); results
+    // of an older generation are dropped
+    quint64 m_generation = 1;
+    mutable int m_wantLo = 0;  // slots requested since the last dispatch
+    mutable int m_wantHi = -1;
+
+    // A job on the worker: where each of its texts belongs now. sync()
+    // moves the slots along with rows inserted, removed or swapped in the
+    // meantime; -1 marks a value that is gone or changed.
+    struct PendingFormat {
+        quint64 id = 0;
+        std::vector<int> targets;
+    };
+    std::vector<PendingFormat> m_pending;
+    quint64 m_nextJob = 1;
+
+    const QString &formatAt(int storageIdx) const;
+    void requestFormat(int storageIdx) const;
+    void dispatchFormatJob();
+    void remapPending(const RpnCore::Changes &changes);
+    void applyFormatted(quint64 generation, quint64 id, const QStringList &texts);
 };
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "rpnstackstats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+// The variance sums are rebuilt around the mean once more than this many
+// leading bits of x² cancel against mean² (error stays below 2^4 ulp)
+constexpr double kCancellation = 1.0 / 16.0;
+
+} // namespace
+
+// --- EXACT SUM ---
+
+void RpnStackStats::Sum::add(double v)
+{
+    // Two-sum of v with each partial; the rounding errors become the new
+    // partials, the running total the last one
+    std::size_t kept = 0;
+    for (double p : m_partials) {
+        if (std::fabs(v) < std::fabs(p)) std::swap(v, p);
+        const double hi = v + p;
+        const double lo = p - (hi - v);
+        if (lo != 0.0) m_partials[kept++] = lo;
+        v = hi;
+    }
+    m_partials.resize(kept);
+    m_partials.push_back(v);
+    if (!std::isfinite(v)) m_overflow = true;
+}
+
+void RpnStackStats::Sum::addMultiple(double v, std::size_t count)
+{
+    // count * v = product + error exactly (two-product via fma)
+    const double c = double(count);
+    const double product = c * v;
+    add(product);
+    add(std::fma(c, v, -product));
+}
+
+double RpnStackStats::Sum::value() const
+{
+    if (m_partials.empty()) return 0.0;
+    if (m_overflow) return m_partials.back();
+
+    // Add from the top until the result no longer changes, then round
+    // half-way cases by the sign of what is left (math.fsum)
+    std::size_t i = m_partials.size() - 1;
+    double hi = m_partials[i];
+    double lo = 0.0;
+    while (i > 0) {
+        const double x = hi;
+        const double y = m_partials[--i];
+        hi = x + y;
+        lo = y - (hi - x);
+        if (lo != 0.0) break;
+    }
+    if (i > 0 && ((lo < 0.0 && m_partials[i - 1] < 0.0) || (lo > 0.0 && m_partials[i - 1] > 0.0))) {
+        const double y = lo * 2.0;
+        const double x = hi + y;
+        if (y == x - hi) hi = x;
+    }
+    return hi;
+}
+
+void RpnStackStats::Sum::clear()
+{
+    m_partials.clear();
+    m_overflow = false;
+}
+
+// --- UPDATES ---
+
+void RpnStackStats::add(double v)
+{
+    if (std::isnan(v)) {
+        ++m_nan;
+        return;
+    }
+    ++m_values[v];
+    if (std::isinf(v)) ++(v > 0 ? m_posInf : m_negInf);
+    else addFinite(v);
+}
+
+void RpnStackStats::remove(double v)
+{
+    if (std::isnan(v)) {
+        if (m_nan > 0) --m_nan;
+        return;
+    }
+    const auto it = m_values.find(v);
+    if (it == m_values.end()) return;
+    if (--it->second == 0) m_values.erase(it);
+    if (std::isinf(v)) --(v > 0 ? m_posInf : m_negInf);
+    else removeFinite(v);
+}
+
+void RpnStackStats::clear()
+{
+    *this = RpnStackStats();
+}
+
+void RpnStackStats::addFinite(double v)
+{
+    if (m_finite++ == 0) m_shift = v;
+    const double d = v - m_shift;
+    m_sum.add(v);
+    m_shifted.add(d);
+    m_squares.add(d * d);
+    if (driftedFromShift()) recenter(m_sum.value() / double(m_finite));
+}
+
+void RpnStackStats::removeFinite(double v)
+{
+    if (--m_finite == 0) {
+        // Start the next run from exact zeros
+        m_sum.clear();
+        m_shifted.clear();
+        m_squares.clear();
+        return;
+    }
+    const double d = v - m_shift;
+    m_sum.add(-v);
+    m_shifted.add(-d);
+    m_squares.add(-(d * d));
+
+    // Sums that overflowed only come back exact by recounting
+    if (m_sum.overflowed()) {
+        m_sum.clear();
+        for (const auto &[value, count] : m_values)
+            if (std::isfinite(value)) m_sum.addMultiple(value, count);
+    }
+    if (m_shifted.overflowed() || m_squares.overflowed() || driftedFromShift())
+        recenter(m_sum.value() / double(m_finite));
+}
+
+bool RpnStackStats::driftedFromShift() const
+{
+    if (m_squares.overflowed()) return false;
+    const double s = m_shifted.value();
+    const double q = m_squares.value();
+    return q - s * s / double(m_finite) < q * kCancellation;
+}
+
+void RpnStackStats::recenter(double shift)
+{
+    if (!std::isfinite(shift)) return;
+    m_shift = shift;
+    m_shifted.clear();
+    m_squares.clear();
+    for (const auto &[value, count] : m_values) {
+        if (!std::isfinite(value)) continue;
+        const double d = value - m_shift;
+        m_shifted.addMultiple(d, count);
+        // Each (d*d) exactly as removeFinite() will take it back
+        m_squares.addMultiple(d * d, count);
+    }
+}
+
+// --- RESULTS ---
+
+double RpnStackStats::nonFinite() const
+{
+    if (m_nan > 0 || (m_posInf > 0 && m_negInf > 0)) return kNaN;
+    if (m_posInf > 0) return kInf;
+    if (m_negInf > 0) return -kInf;
+    return 0.0;
+}
+
+double RpnStackStats::sum() const
+{
+    const double special = nonFinite();
+    return special != 0.0 ? special : m_sum.value();
+}
+
+double RpnStackStats::mean() const
+{
+    if (count() == 0) return kNaN;
+    const double special = nonFinite();
+    if (special != 0.0) return special;
+    if (!m_sum.overflowed()) return m_sum.value() / double(m_finite);
+    return m_shift + m_shifted.value() / double(m_finite);
+}
+
+double RpnStackStats::variance() const
+{
+    if (count() < 2 || nonFinite() != 0.0) return kNaN;
+    if (m_squares.overflowed()) return kInf;
+    const double n = double(m_finite);
+    const double s = m_shifted.value();
+    // Rounding can leave a hair below zero for (nearly) equal values
+    return std::max(0.0, (m_squares.value() - s * s / n) / (n - 1.0));
+}
+
+double RpnStackStats::min() const
+{
+    if (m_nan > 0 || m_values.empty()) return kNaN;
+    return m_values.begin()->first;
+}
+
+double RpnStackStats::max() const
+{
+    if (m_nan > 0 || m_values.empty()) return kNaN;
+    return m_values.rbegin()->first;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Count, sum, mean, variance, min and max of a multiset of doubles, kept
+// up to date as values are added and removed. RpnStackCore feeds it every
+// value that enters or leaves the stack (setStatsEnabled()).
+//
+// Sums are exact (a list of non-overlapping partials, as in Python's
+// math.fsum), so removing a value takes back exactly what adding it
+// contributed, however long the stack lives. Variance comes from exact
+// sums of the values minus a shift near the mean; when the mean drifts so
+// far from the shift that x² - mean² would cancel, the shift is moved and
+// those sums rebuilt from the ordered value counts, which also give
+// min/max in O(log n). NaN and infinities are counted apart and give the
+// IEEE result without poisoning the sums once they are gone.
+class RpnStackStats
+{
+public:
+    void add(double v);
+    void remove(double v);
+    void clear();
+
+    std::size_t count() const { return m_finite + m_nan + m_posInf + m_negInf; }
+    double sum() const;
+    double mean() const;
+    // Sample variance; NaN below 2 values
+    double variance() const;
+    // NaN when empty
+    double min() const;
+    double max() const;
+
+private:
+    class Sum
+    {
+    public:
+        void add(double v);
+        // v * count, exactly
+        void addMultiple(double v, std::size_t count);
+        // Correctly rounded; ±inf once a partial sum left the double range
+        double value() const;
+        bool overflowed() const { return m_overflow; }
+        void clear();
+
+    private:
+        std::vector<double> m_partials; // increasing magnitude, non-overlapping
+        bool m_overflow = false;
+    };
+
+    // Result of the non-finite values alone, or 0 when there are none
+    double nonFinite() const;
+    void addFinite(double v);
+    void removeFinite(double v);
+    // Whether x² - mean² has started to cancel in the variance sums
+    bool driftedFromShift() const;
+    void recenter(double shift);
+
+    Sum m_sum;      // of v
+    Sum m_shifted;  // of v - m_shift
+    Sum m_squares;  // of (v - m_shift)²
+    double m_shift = 0.0;
+    std::size_t m_finite = 0;
+    std::size_t m_nan = 0;
+    std::size_t m_posInf = 0;
+    std::size_t m_negInf = 0;
+    std::map<double, std::size_t> m_values; // ordered, with multiplicity (no NaN)
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Op-level undo/redo log.
+// Every step stores only what one operation changed (the values it took off
+// the top of the stack and the values it put back, or a single edited slot),
+// so recording, undoing and redoing cost O(values touched) instead of
+// O(stack). Values live in one pool per side, so steady-state recording
+// does not allocate per step.
+//
+// `Extra` is carried along with every step for state that is not part of
+// the stack (the engine uses it for history bookkeeping). `Value` is the
+// stack's number type.
+template <typename Extra, typename Value = double>
+class RpnUndoLog
+{
+public:
+    static constexpr std::size_t kDefaultLimit = 100000;
+
+    enum class Kind : std::uint8_t {
+        ReplaceTop, // `removed` values replaced by `inserted` values on top
+        SetValue,   // slot `index` changed from oldValue to newValue
+        Remove,     // oldValue removed from slot `index`
+        Swap,       // slots `index` and `index + 1` swapped
+        Marker      // no stack change, only `extra`
+    };
+
+    struct Step {
+        Kind kind = Kind::ReplaceTop;
+        std::uint32_t removed = 0;
+        std::uint32_t inserted = 0;
+        std::size_t index = 0; // counted from the bottom of the stack
+        Value oldValue{};
+        Value newValue{};
+        Extra extra{};
+        bool joined = false; // undone and redone together with the step before it
+    };
+
+    explicit RpnUndoLog(std::size_t limit = kDefaultLimit) : m_limit(limit ? limit : 1) {}
+
+    bool canUndo() const { return !m_undo.steps.empty(); }
+    bool canRedo() const { return !m_redo.steps.empty(); }
+    std::size_t undoCount() const { return m_undo.steps.size(); }
+    std::size_t redoCount() const { return m_redo.steps.size(); }
+    std::size_t limit() const { return m_limit; }
+
+    void setLimit(std::size_t limit)
+    {
+        m_limit = limit ? limit : 1;
+        trim();
+    }
+
+    void clear()
+    {
+        m_undo.clear();
+        m_redo.clear();
+    }
+
+    void clearRedo() { m_redo.clear(); }
+
+    // Records a new step. Anything that could be redone is dropped.
+    // `removed` and `inserted` are ordered bottom-to-top.
+    void record(Step step, std::span<const Value> removed = {}, std::span<const Value> inserted = {})
+    {
+        m_redo.clear();
+        step.removed = static_cast<std::uint32_t>(removed.size());
+        step.inserted = static_cast<std::uint32_t>(inserted.size());
+        m_undo.values.insert(m_undo.values.end(), removed.begin(), removed.end());
+        m_undo.values.insert(m_undo.values.end(), inserted.begin(), inserted.end());
+        if (!step.joined) ++m_undo.groups;
+        m_undo.steps.push_back(std::move(step));
+        trim();
+    }
+
+    void record(Step step, std::initializer_list<Value> removed, std::initializer_list<Value> inserted)
+    {
+        record(std::move(step),
+               std::span<const Value>(removed.begin(), removed.size()),
+               std::span<const Value>(inserted.begin(), inserted.size()));
+    }
+
+    // Moves the newest step to the redo side and returns it there.
+    // `removed` / `inserted` receive the step's values (buffers are reused).
+    Step &undo(std::vector<Value> &removed, std::vector<Value> &inserted)
+    {
+        return transfer(m_undo, m_redo, removed, inserted);
+    }
+
+    // Moves the newest undone step back to the undo side and returns it there.
+    Step &redo(std::vector<Value> &removed, std::vector<Value> &inserted)
+    {
+        return transfer(m_redo, m_undo, removed, inserted);
+    }
+
+    // The next redo() belongs to the same group as the one just redone
+    bool redoJoined() const { return !m_redo.steps.empty() && m_redo.steps.back().joined; }
+
+    // Every value held for undo or redo
+    template <typename F>
+    void forEachValue(F &&f) const
+    {
+        for (const Value &v : m_undo.values) f(v);
+        for (const Value &v : m_redo.values) f(v);
+    }
+
+private:
+    struct Side {
+        std::deque<Step> steps;
+        std::deque<Value> values;
+        std::size_t groups = 0; // steps that are not joined to the one before
+        void clear() { steps.clear(); values.clear(); groups = 0; }
+    };
+
+    static Step &transfer(Side &from, Side &to, std::vector<Value> &removed, std::vector<Value> &inserted)
+    {
+        Step &src = from.steps.back();
+        const std::size_t n = std::size_t(src.removed) + src.inserted;
+        const auto first = from.values.end() - static_cast<std::ptrdiff_t>(n);
+
+        removed.assign(first, first + src.removed);
+        inserted.assign(first + src.removed, from.values.end());
+        to.values.insert(to.values.end(), first, from.values.end());
+        from.values.erase(first, from.values.end());
+        if (!src.joined) {
+            --from.groups;
+            ++to.groups;
+        }
+
+        to.steps.push_back(std::move(src));
+        from.steps.pop_back();
+        return to.steps.back();
+    }
+
+    // Drops the oldest groups whole: undoing the rest of a cut group would
+    // leave half of it on the stack. The newest group stays even when it
+    // alone is over the limit.
+    void trim()
+    {
+        while (m_undo.steps.size() > m_limit && m_undo.groups > 1) {
+            do {
+                const Step &oldest = m_undo.steps.front();
+                const std::size_t n = std::size_t(oldest.removed) + oldest.inserted;
+                m_undo.values.erase(m_undo.values.begin(), m_undo.values.begin() + static_cast<std::ptrdiff_t>(n));
+                if (!oldest.joined) --m_undo.groups;
+                m_undo.steps.pop_front();
+            } while (!m_undo.steps.empty() && m_undo.steps.front().joined);
+        }
+    }
+
+    Side m_undo;
+    Side m_redo;
+    std::size_t m_limit;
+};
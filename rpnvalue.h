@@ -0,0 +1,16 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+// The double side of the stack value interface. RpnStackCore and
+// RpnDepGraph compare values with rpnSameValue() and feed the statistics
+// through rpnToDouble(); RpnDecimal brings its own overloads (rpndecimal.h).
+
+// Bitwise, so NaN payloads and -0.0 count as changes too
+inline bool rpnSameValue(double a, double b)
+{
+    return std::bit_cast<std::uint64_t>(a) == std::bit_cast<std::uint64_t>(b);
+}
+
+inline double rpnToDouble(double v) { return v; }
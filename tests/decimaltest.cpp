@@ -0,0 +1,158 @@
+// Known-answer tests for RpnDecimal: rounding, canonical form around the
+// 64-bit coefficient limit, exponent range, and the transcendental
+// functions. Results are compared as toString() text, so a value that is
+// right but not canonical fails too. Run by ctest, or ./rpn_decimal_test.
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "rpndecimal.h"
+
+namespace {
+
+int g_failures = 0;
+int g_checks = 0;
+
+const RpnDecimalContext kDec128 = RpnDecimalContext::decimal128();
+
+const RpnDecimalContext kExact = RpnDecimalContext::arbitrary(RpnDecimalContext::kMaxDigits);
+
+RpnDecimal num(std::string_view text, const RpnDecimalContext &ctx = kExact)
+{
+    RpnDecimal v;
+    if (!RpnDecimal::fromChars(text, v, ctx)) {
+        std::fprintf(stderr, "cannot parse %.*s\n", int(text.size()), text.data());
+        ++g_failures;
+    }
+    return v;
+}
+
+void checkTrue(const char *what, bool ok)
+{
+    ++g_checks;
+    if (ok) return;
+    ++g_failures;
+    std::fprintf(stderr, "FAIL %s\n", what);
+}
+
+void check(const char *what, const RpnDecimal &got, std::string_view expected)
+{
+    ++g_checks;
+    const std::string text = got.toString();
+    if (text == expected) return;
+    ++g_failures;
+    std::fprintf(stderr, "FAIL %s\n  expected %.*s\n  got      %s\n", what, int(expected.size()), expected.data(),
+                 text.c_str());
+}
+
+// --- ROUNDING ---
+
+void testRounding()
+{
+    // 35 significant digits into 34, half to even
+    check("half to even, down", num("1.0000000000000000000000000000000005", kDec128), "1");
+    check("half to even, up", num("1.0000000000000000000000000000000015", kDec128),
+          "1000000000000000000000000000000002E-33");
+    check("above half", num("1.00000000000000000000000000000000051", kDec128),
+          "1000000000000000000000000000000001E-33");
+    check("below half", num("1.00000000000000000000000000000000049", kDec128), "1");
+    check("carry into a new digit", num("9.9999999999999999999999999999999999", kDec128), "1E1");
+    check("negative", num("-2.5", RpnDecimalContext::arbitrary(1)), "-2");
+    check("0.1 + 0.2", RpnDecimal::add(num("0.1"), num("0.2"), kDec128), "3E-1");
+    check("1 / 3", RpnDecimal::div(num("1"), num("3"), kDec128), "3333333333333333333333333333333333E-34");
+    check("2 / 3", RpnDecimal::div(num("2"), num("3"), kDec128), "6666666666666666666666666666666667E-34");
+    check("1 / 8 is exact", RpnDecimal::div(num("1"), num("8"), kDec128), "125E-3");
+    check("a tiny addend only rounds", RpnDecimal::add(num("1"), num("1E-100"), kDec128), "1");
+    check("1 - tiny rounds back up", RpnDecimal::sub(num("1"), num("1E-100"), kDec128), "1");
+    check("1 - 1E-34", RpnDecimal::sub(num("1"), num("1E-34"), kDec128), "9999999999999999999999999999999999E-34");
+}
+
+// --- CANONICAL FORM ---
+
+void testCanonical()
+{
+    check("trailing zeros", num("1.50"), "15E-1");
+    check("integer zeros", num("1200"), "12E2");
+    check("zero", num("-0.000"), "0");
+    check("x - x", RpnDecimal::sub(num("123.456"), num("123.456"), kDec128), "0");
+    check("fromDouble shortest", RpnDecimal::fromDouble(0.1), "1E-1");
+
+    // 2^64 - 1 is the largest inline coefficient
+    const RpnDecimal maxSmall = num("18446744073709551615");
+    check("2^64 - 1", maxSmall, "18446744073709551615");
+    check("2^64 - 1 + 1", RpnDecimal::add(maxSmall, num("1"), kDec128), "18446744073709551616");
+    check("2^64 - 1 + 1 - 1", RpnDecimal::sub(RpnDecimal::add(maxSmall, num("1"), kDec128), num("1"), kDec128),
+          "18446744073709551615");
+    check("2^32 * 2^32", RpnDecimal::mul(num("4294967296"), num("4294967296"), kDec128), "18446744073709551616");
+    check("2^64 / 2", RpnDecimal::div(num("18446744073709551616"), num("2"), kDec128), "9223372036854775808");
+    check("2^64 ^ 2", RpnDecimal::pow(num("18446744073709551616"), num("2"), RpnDecimalContext::arbitrary(50)),
+          "340282366920938463463374607431768211456");
+    check("2^64 ^ 2, 34 digits", RpnDecimal::pow(num("18446744073709551616"), num("2"), kDec128),
+          "3402823669209384634633746074317682E5");
+    check("2^64 * 10 drops the zero", RpnDecimal::mul(num("18446744073709551616"), num("10"), kDec128),
+          "18446744073709551616E1");
+    check("limbs back to inline", RpnDecimal::div(num("36893488147419103232"), num("2"), kDec128),
+          "18446744073709551616");
+    check("1.8446744073709551616E19 read back", num("1.8446744073709551616E19"), "18446744073709551616");
+
+    // Equal values have equal representations however they were reached
+    const RpnDecimal viaLimbs = RpnDecimal::sub(RpnDecimal::add(maxSmall, num("5"), kDec128), num("5"), kDec128);
+    checkTrue("2^64 - 1 through limbs equals the inline value", rpnSameValue(viaLimbs, maxSmall));
+}
+
+// --- EXPONENT RANGE ---
+
+void testRange()
+{
+    check("largest decimal128", num("9.999999999999999999999999999999999E6144", kDec128),
+          "9999999999999999999999999999999999E6111");
+    check("overflow", RpnDecimal::mul(num("9E6144", kDec128), num("10"), kDec128), "Infinity");
+    check("negative overflow", RpnDecimal::mul(num("-9E6144", kDec128), num("10"), kDec128), "-Infinity");
+    check("rounding overflows", num("9.9999999999999999999999999999999999E6144", kDec128), "Infinity");
+    check("smallest decimal128", num("1E-6143", kDec128), "1E-6143");
+    check("underflow", RpnDecimal::div(num("1E-6143", kDec128), num("10"), kDec128), "0");
+    check("parse overflow", num("1E7000", kDec128), "Infinity");
+    check("parse underflow", num("1E-7000", kDec128), "0");
+    check("1 / 0", RpnDecimal::div(num("1"), num("0"), kDec128), "Infinity");
+    check("0 / 0", RpnDecimal::div(num("0"), num("0"), kDec128), "NaN");
+    checkTrue("170! fits decimal128", RpnDecimal::factorial(170, kDec128).isFinite());
+    check("3000! overflows decimal128", RpnDecimal::factorial(3000, kDec128), "Infinity");
+    check("1E-100 ^ 100", RpnDecimal::pow(num("1E-100"), num("100"), kDec128), "0");
+}
+
+// --- FUNCTIONS ---
+
+void testFunctions()
+{
+    const RpnDecimalContext d50 = RpnDecimalContext::arbitrary(50);
+    check("pi, 34 digits", RpnDecimal::pi(kDec128), "3141592653589793238462643383279503E-33");
+    check("pi, 50 digits", RpnDecimal::pi(d50), "31415926535897932384626433832795028841971693993751E-49");
+    check("e, 34 digits", RpnDecimal::e(kDec128), "2718281828459045235360287471352662E-33");
+    check("exp(1)", RpnDecimal::exp(num("1"), kDec128), "2718281828459045235360287471352662E-33");
+    check("exp(0)", RpnDecimal::exp(num("0"), kDec128), "1");
+    check("ln(2)", RpnDecimal::ln(num("2"), kDec128), "6931471805599453094172321214581766E-34");
+    check("ln(1)", RpnDecimal::ln(num("1"), kDec128), "0");
+    check("ln(0)", RpnDecimal::ln(num("0"), kDec128), "NaN");
+    check("sqrt(2)", RpnDecimal::sqrt(num("2"), kDec128), "1414213562373095048801688724209698E-33");
+    check("sqrt(1E-100)", RpnDecimal::sqrt(num("1E-100"), kDec128), "1E-50");
+    check("cube root of 27", RpnDecimal::root(num("27"), num("3"), kDec128), "3");
+    check("sin(1)", RpnDecimal::sin(num("1"), kDec128), "841470984807896506652502321630299E-33");
+    check("cos(0)", RpnDecimal::cos(num("0"), kDec128), "1");
+    check("cos(1)", RpnDecimal::cos(num("1"), kDec128), "5403023058681397174009366074429766E-34");
+    check("sin(0)", RpnDecimal::sin(num("0"), kDec128), "0");
+    check("25!", RpnDecimal::factorial(25, kDec128), "15511210043330985984E6");
+    check("30!", RpnDecimal::factorial(30, kDec128), "26525285981219105863630848E7");
+}
+
+} // namespace
+
+int main()
+{
+    testRounding();
+    testCanonical();
+    testRange();
+    testFunctions();
+    std::printf("%d checks, %d failed\n", g_checks, g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+// Client for `appRpnCalcQuick --serve`. Plain POSIX, no Qt, so it starts
+// in a fraction of a millisecond and shell scripts can call it per
+// expression:
+//   rpnc "3 4 +"           prints the stack, top first, one value per line
+//   rpnc -s NAME "..."     another socket name (or path) than the default
+//   rpnc < requests        sends every line of stdin without waiting and
+//                          prints the raw replies ("OK\t..." / "ERR ...")
+// The stack lives in the server per connection, so it starts empty on
+// every run. Exit status: 0, 1 if the server answered ERR, 2 on I/O errors.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Where QLocalServer puts a name that is not a path: QDir::tempPath()
+std::string socketPath(const char *name)
+{
+    std::string n = name ? name : "";
+    if (n.empty()) {
+        const char *user = std::getenv("USER");
+        n = user && *user ? std::string("rpncalc-") + user : std::string("rpncalc");
+    }
+    if (n.front() == '/') return n;
+    const char *tmp = std::getenv("TMPDIR");
+    std::string dir = tmp && *tmp ? tmp : "/tmp";
+    while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+    return dir + '/' + n;
+}
+
+int connectTo(const std::string &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::fprintf(stderr, "rpnc: socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::fprintf(stderr, "rpnc: cannot connect to %s: %s\n", path.c_str(), std::strerror(errno));
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const char *p, std::size_t n)
+{
+    while (n > 0) {
+        // A server that went away is an error, not SIGPIPE
+        const ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= std::size_t(w);
+    }
+    return true;
+}
+
+// One request from the arguments, the reply as one value per line
+int request(int fd, const std::string &line)
+{
+    if (!sendAll(fd, line.data(), line.size())) return 2;
+    std::string reply;
+    char buf[4096];
+    while (reply.empty() || reply.back() != '\n') {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            std::fprintf(stderr, "rpnc: no reply\n");
+            return 2;
+        }
+        reply.append(buf, std::size_t(n));
+    }
+    reply.pop_back();
+
+    std::string_view rest = reply;
+    if (!rest.starts_with("OK")) {
+        std::fprintf(stderr, "%s\n", reply.c_str());
+        return 1;
+    }
+    rest.remove_prefix(2);
+    while (!rest.empty()) {
+        rest.remove_prefix(1);  // the tab before each value
+        const std::size_t tab = rest.find('\t');
+        const std::string_view value = rest.substr(0, tab);
+        std::fwrite(value.data(), 1, value.size(), stdout);
+        std::fputc('\n', stdout);
+        rest = tab == std::string_view::npos ? std::string_view() : rest.substr(tab);
+    }
+    return 0;
+}
+
+// Streams stdin to the server while replies stream back, until every line
+// sent has its reply
+int pipeline(int fd)
+{
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    bool eof = false;
+    bool lineEnded = true;  // last byte sent was '\n'
+    bool replyStart = true;
+    bool failed = false;
+    char buf[1 << 16];
+    pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { fd, POLLIN, 0 } };
+
+    while (!eof || received < sent) {
+        fds[0].fd = eof ? -1 : STDIN_FILENO;
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return 2;
+        }
+        if (fds[0].revents) {
+            const ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                eof = true;
+                if (!lineEnded) {
+                    if (!sendAll(fd, "\n", 1)) return 2;
+                    ++sent;
+                }
+                continue;
+            }
+            for (ssize_t i = 0; i < n; ++i) sent += buf[i] == '\n';
+            lineEnded = buf[n - 1] == '\n';
+            if (!sendAll(fd, buf, std::size_t(n))) return 2;
+        }
+        if (fds[1].revents) {
+            const ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                std::fprintf(stderr, "rpnc: server closed the connection\n");
+                return 2;
+            }
+            for (ssize_t i = 0; i < n; ++i) {
+                if (replyStart && buf[i] == 'E') failed = true;
+                replyStart = buf[i] == '\n';
+                received += replyStart;
+            }
+            std::fwrite(buf, 1, std::size_t(n), stdout);
+        }
+    }
+    std::fflush(stdout);
+    return failed ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const char *name = nullptr;
+    int first = 1;
+    if (argc > 2 && (std::strcmp(argv[1], "-s") == 0 || std::strcmp(argv[1], "--socket") == 0)) {
+        name = argv[2];
+        first = 3;
+    } else if (argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)) {
+        std::printf("usage: rpnc [-s NAME] [TOKENS...]\n"
+                    "Evaluates TOKENS on an `appRpnCalcQuick --serve` server and prints the stack,\n"
+                    "top first. Without TOKENS every line of stdin is a request.\n");
+        return 0;
+    }
+
+    const int fd = connectTo(socketPath(name));
+    if (fd < 0) return 2;
+
+    int status = 0;
+    if (first < argc) {
+        std::string line;
+        for (int i = first; i < argc; ++i) {
+            if (i > first) line += ' ';
+            line += argv[i];
+        }
+        // One request, however the arguments were split
+        for (char &c : line) if (c == '\n' || c == '\r') c = ' ';
+        line += '\n';
+        status = request(fd, line);
+    } else {
+        status = pipeline(fd);
+    }
+    ::close(fd);
+    return status;
+}